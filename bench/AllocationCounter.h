@@ -0,0 +1,54 @@
+#pragma once
+
+// Replaces the global allocation functions to count heap allocations and live heap bytes.
+// Include this header in exactly one source file of a benchmark program.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace MusicPlayer::Bench
+{
+   struct AllocationCounter
+   {
+      static inline std::atomic<size_t> allocations{ 0 };
+      static inline std::atomic<size_t> live_bytes{ 0 };
+   };
+}
+
+namespace MusicPlayer::Bench::Detail
+{
+   // keeps the size of each block in front of it, with the alignment expected from operator new
+   constexpr size_t kHeaderSize = alignof(std::max_align_t);
+
+   inline void* countedAllocate(size_t size)
+   {
+      void* block = std::malloc(size + kHeaderSize);
+      if (!block)
+         throw std::bad_alloc();
+
+      *static_cast<size_t*>(block) = size;
+      AllocationCounter::allocations.fetch_add(1, std::memory_order_relaxed);
+      AllocationCounter::live_bytes.fetch_add(size, std::memory_order_relaxed);
+
+      return static_cast<char*>(block) + kHeaderSize;
+   }
+
+   inline void countedFree(void* pointer) noexcept
+   {
+      if (!pointer)
+         return;
+
+      void* block = static_cast<char*>(pointer) - kHeaderSize;
+      AllocationCounter::live_bytes.fetch_sub(*static_cast<size_t*>(block), std::memory_order_relaxed);
+      std::free(block);
+   }
+}
+
+void* operator new(size_t size) { return MusicPlayer::Bench::Detail::countedAllocate(size); }
+void* operator new[](size_t size) { return MusicPlayer::Bench::Detail::countedAllocate(size); }
+void operator delete(void* pointer) noexcept { MusicPlayer::Bench::Detail::countedFree(pointer); }
+void operator delete[](void* pointer) noexcept { MusicPlayer::Bench::Detail::countedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { MusicPlayer::Bench::Detail::countedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { MusicPlayer::Bench::Detail::countedFree(pointer); }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace MusicPlayer::Bench
+{
+
+   /**
+    * \brief Runs a callable once and prints how long it took.
+    *
+    * \param name The label printed in front of the timing.
+    * \param operations Number of operations performed by the callable, used to print a rate.
+    * \param function The code to measure.
+    * \return The elapsed time in seconds.
+    */
+   template <typename Function>
+   double measure(const std::string& name, size_t operations, Function&& function)
+   {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      std::cout << std::left << std::setw(40) << name << std::right
+         << std::setw(12) << std::fixed << std::setprecision(3) << elapsed.count() * 1000.0 << " ms";
+
+      if (operations > 0 && elapsed.count() > 0.0)
+         std::cout << std::setw(16) << std::setprecision(0) << operations / elapsed.count() << " ops/s";
+
+      std::cout << std::endl;
+
+      return elapsed.count();
+   }
+
+   /**
+    * \brief Prevents the compiler from optimizing away a computed value.
+    */
+   template <typename T>
+   void doNotOptimize(const T& value)
+   {
+#if defined(__GNUC__)
+      asm volatile("" : : "r,m"(value) : "memory");
+#else
+      static volatile const void* sink;
+      sink = &value;
+#endif
+   }
+
+   /**
+    * \brief Writes a playlist of distinct tracks in the temporary directory, replacing any previous one.
+    *
+    * \param file_name The name of the playlist file.
+    * \param track_count Number of tracks of the playlist.
+    * \return The path of the playlist file.
+    */
+   inline std::string generatePlaylist(const std::string& file_name, size_t track_count = 100)
+   {
+      std::string path = (std::filesystem::temp_directory_path() / file_name).string();
+      std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+
+      for (size_t idx = 0; idx < track_count; idx++)
+         file << "track_" << idx << ".music||Track " << idx << ";3:07;MP3\n";
+
+      return path;
+   }
+
+}
@@ -0,0 +1,211 @@
+// Checks that the SIMD kernels match the scalar ones bit for bit, then measures their throughput in samples/s.
+
+#include "Benchmark.h"
+#include "Dsp.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using MusicPlayer::Dsp::InstructionSet;
+using MusicPlayer::Dsp::Kernels;
+using MusicPlayer::Bench::doNotOptimize;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   // not a multiple of the vector sizes, so that the tails are exercised too
+   constexpr size_t kSamples = (1 << 20) + 13;
+   constexpr size_t kRepetitions = 50;
+
+   struct Inputs
+   {
+      std::vector<unsigned char> bytes;
+      std::vector<float> samples;
+   };
+
+   struct Outputs
+   {
+      std::vector<float> int16;
+      std::vector<float> int24;
+      std::vector<float> int32;
+      std::vector<float> gain_mono;
+      std::vector<float> gain_stereo;
+      std::vector<float> gain_surround;
+      std::vector<float> mix_mono;
+      std::vector<float> mix_stereo;
+      std::vector<float> downmix;
+   };
+
+   Outputs run(const Kernels& kernels, const Inputs& inputs)
+   {
+      Outputs outputs;
+
+      outputs.int16.resize(kSamples);
+      kernels.int16ToFloat(inputs.bytes.data(), outputs.int16.data(), kSamples);
+
+      outputs.int24.resize(kSamples);
+      kernels.int24ToFloat(inputs.bytes.data(), outputs.int24.data(), kSamples);
+
+      outputs.int32.resize(kSamples);
+      kernels.int32ToFloat(inputs.bytes.data(), outputs.int32.data(), kSamples);
+
+      // the gain ramps down over the block, like a volume change
+      outputs.gain_mono = inputs.samples;
+      kernels.applyGain(outputs.gain_mono.data(), kSamples, 1, 1.0f, -0.5f / kSamples);
+
+      outputs.gain_stereo = inputs.samples;
+      kernels.applyGain(outputs.gain_stereo.data(), kSamples / 2, 2, 1.0f, -0.5f / kSamples);
+
+      outputs.gain_surround = inputs.samples;
+      kernels.applyGain(outputs.gain_surround.data(), kSamples / 6, 6, 0.25f, 0.75f / kSamples);
+
+      // a crossfade mixes a fading stream into another one
+      outputs.mix_mono = outputs.int16;
+      kernels.mixGain(inputs.samples.data(), outputs.mix_mono.data(), kSamples, 1, 0.0f, 1.0f / kSamples);
+
+      outputs.mix_stereo = outputs.int16;
+      kernels.mixGain(inputs.samples.data(), outputs.mix_stereo.data(), kSamples / 2, 2, 1.0f, -1.0f / kSamples);
+
+      outputs.downmix.resize(kSamples / 2);
+      kernels.downmixStereo(inputs.samples.data(), outputs.downmix.data(), kSamples / 2);
+
+      return outputs;
+   }
+
+   bool sameBits(const std::vector<float>& expected, const std::vector<float>& actual)
+   {
+      return expected.size() == actual.size() && std::memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)) == 0;
+   }
+
+   bool validate(const Kernels& kernels, const Outputs& reference, const Inputs& inputs)
+   {
+      Outputs outputs = run(kernels, inputs);
+
+      const std::pair<const char*, bool> checks[] = {
+         { "int16 to float", sameBits(reference.int16, outputs.int16) },
+         { "int24 to float", sameBits(reference.int24, outputs.int24) },
+         { "int32 to float", sameBits(reference.int32, outputs.int32) },
+         { "mono gain ramp", sameBits(reference.gain_mono, outputs.gain_mono) },
+         { "stereo gain ramp", sameBits(reference.gain_stereo, outputs.gain_stereo) },
+         { "5.1 gain ramp", sameBits(reference.gain_surround, outputs.gain_surround) },
+         { "mono mix ramp", sameBits(reference.mix_mono, outputs.mix_mono) },
+         { "stereo mix ramp", sameBits(reference.mix_stereo, outputs.mix_stereo) },
+         { "stereo downmix", sameBits(reference.downmix, outputs.downmix) },
+      };
+
+      bool valid(true);
+      for (const auto& check : checks)
+      {
+         if (!check.second)
+         {
+            std::cout << kernels.name << ": " << check.first << " differs from the scalar kernel" << std::endl;
+            valid = false;
+         }
+      }
+
+      return valid;
+   }
+
+   void benchmark(const Kernels& kernels, const Inputs& inputs)
+   {
+      std::vector<float> output(kSamples);
+      std::vector<float> samples = inputs.samples;
+      std::string prefix = std::string(kernels.name) + ": ";
+
+      measure(prefix + "int16 to float", kSamples * kRepetitions, [&]() {
+         for (size_t idx = 0; idx < kRepetitions; idx++)
+         {
+            kernels.int16ToFloat(inputs.bytes.data(), output.data(), kSamples);
+            doNotOptimize(output.front());
+         }
+      });
+
+      measure(prefix + "int24 to float", kSamples * kRepetitions, [&]() {
+         for (size_t idx = 0; idx < kRepetitions; idx++)
+         {
+            kernels.int24ToFloat(inputs.bytes.data(), output.data(), kSamples);
+            doNotOptimize(output.front());
+         }
+      });
+
+      measure(prefix + "int32 to float", kSamples * kRepetitions, [&]() {
+         for (size_t idx = 0; idx < kRepetitions; idx++)
+         {
+            kernels.int32ToFloat(inputs.bytes.data(), output.data(), kSamples);
+            doNotOptimize(output.front());
+         }
+      });
+
+      // alternating ramps keep the samples in range over the repetitions
+      measure(prefix + "stereo gain ramp", kSamples * kRepetitions, [&]() {
+         for (size_t idx = 0; idx < kRepetitions; idx++)
+         {
+            float start = idx % 2 ? 0.5f : 2.0f;
+            kernels.applyGain(samples.data(), kSamples / 2, 2, start, (1.0f - start) / kSamples);
+            doNotOptimize(samples.front());
+         }
+      });
+
+      // the mixed samples only grow by the magnitude of the source at each repetition
+      output.assign(inputs.samples.begin(), inputs.samples.end());
+      measure(prefix + "stereo mix ramp", kSamples * kRepetitions, [&]() {
+         for (size_t idx = 0; idx < kRepetitions; idx++)
+         {
+            float start = idx % 2 ? 0.0f : 1.0f;
+            kernels.mixGain(inputs.samples.data(), output.data(), kSamples / 2, 2, start, (1.0f - 2.0f * start) / kSamples);
+            doNotOptimize(output.front());
+         }
+      });
+
+      measure(prefix + "stereo downmix", kSamples * kRepetitions, [&]() {
+         for (size_t idx = 0; idx < kRepetitions; idx++)
+         {
+            kernels.downmixStereo(inputs.samples.data(), output.data(), kSamples / 2);
+            doNotOptimize(output.front());
+         }
+      });
+   }
+}
+
+int main()
+{
+   std::mt19937 rng(42);
+
+   // enough bytes for the widest samples
+   Inputs inputs;
+   inputs.bytes.resize(kSamples * 4);
+   for (unsigned char& byte : inputs.bytes)
+      byte = static_cast<unsigned char>(rng());
+
+   std::uniform_real_distribution<float> sample_distribution(-1.0f, 1.0f);
+   inputs.samples.resize(kSamples);
+   for (float& sample : inputs.samples)
+      sample = sample_distribution(rng);
+
+   const Kernels& scalar = *MusicPlayer::Dsp::kernelsFor(InstructionSet::Scalar);
+   Outputs reference = run(scalar, inputs);
+
+   std::cout << "DSP kernels on " << kSamples << " samples, selected at runtime: " << MusicPlayer::Dsp::kernels().name
+      << std::endl << std::endl;
+
+   bool valid(true);
+
+   for (InstructionSet instruction_set : { InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2 })
+   {
+      const Kernels* kernels = MusicPlayer::Dsp::kernelsFor(instruction_set);
+      if (!kernels)
+         continue;
+
+      if (!validate(*kernels, reference, inputs))
+      {
+         valid = false;
+         continue;
+      }
+
+      benchmark(*kernels, inputs);
+      std::cout << std::endl;
+   }
+
+   return valid ? 0 : 1;
+}
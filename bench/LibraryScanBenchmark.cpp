@@ -0,0 +1,168 @@
+// Compares adding a library of track files with add_track, one file after the other, and with add_dir, with the
+// metadata cache closed, cold and warm.
+//
+// Usage: library_scan_benchmark [number of files]
+
+#include "Benchmark.h"
+#include "LibraryScanner.h"
+#include "MetadataCache.h"
+#include "Shell.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using MusicPlayer::LibraryScanner;
+using MusicPlayer::MetadataCache;
+using MusicPlayer::Playlist;
+using MusicPlayer::Shell;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   const char* kCodecs[] = { "MP3", "FLAC", "Opus", "AAC", "Vorbis" };
+
+   constexpr size_t kAlbumsPerArtist = 10;
+   constexpr size_t kTracksPerAlbum = 12;
+
+   // the argument lines given to add_track
+   constexpr size_t kFilesPerInstruction = 1000;
+
+   /**
+    * \brief Writes a library of <artist>/<album>/<track>.music files, with a few invalid ones.
+    *
+    * \return The paths of the track files.
+    */
+   std::vector<std::string> generateLibrary(const std::filesystem::path& root, size_t files)
+   {
+      std::vector<std::string> file_names;
+      file_names.reserve(files);
+
+      for (size_t idx = 0; idx < files; idx++)
+      {
+         size_t album = idx / kTracksPerAlbum;
+         std::filesystem::path directory = root / ("artist_" + std::to_string(album / kAlbumsPerArtist)) / ("album_" + std::to_string(album));
+
+         if (idx % kTracksPerAlbum == 0)
+            std::filesystem::create_directories(directory);
+
+         std::string file_name = (directory / ("track_" + std::to_string(idx) + ".music")).string();
+         std::ofstream file(file_name, std::ofstream::out | std::ofstream::trunc);
+
+         if (idx % 1000 == 999)
+            file << "not a track";
+         else
+            file << "Track number " << idx << ";" << idx % 10 << ":" << idx % 60 << ";" << kCodecs[idx % 5];
+
+         file_names.push_back(std::move(file_name));
+      }
+
+      return file_names;
+   }
+}
+
+int main(int argc, char** argv)
+{
+   size_t files = argc > 1 ? std::stoul(argv[1]) : 50000;
+   std::filesystem::path root = std::filesystem::temp_directory_path() / "iplayer_library_scan_benchmark";
+
+   std::filesystem::remove_all(root);
+
+   std::cout << "Generating a library of " << files << " track files..." << std::endl;
+   std::vector<std::string> file_names = generateLibrary(root, files);
+
+   std::ostringstream output;
+
+   {
+      Shell shell;
+      shell.setOutputStream(output);
+      shell.setInteractive(false);
+
+      size_t added(0);
+
+      measure("add_track, one file after the other", files, [&]() {
+         for (size_t first = 0; first < file_names.size(); first += kFilesPerInstruction)
+         {
+            std::string instruction = "add_track";
+            for (size_t idx = first; idx < std::min(first + kFilesPerInstruction, file_names.size()); idx++)
+               instruction += " " + file_names[idx];
+
+            shell.execute(instruction);
+
+            std::string printed = output.str();
+            for (size_t found = printed.find("successfully added"); found != std::string::npos; found = printed.find("successfully added", found + 1))
+               added++;
+
+            output.str(std::string());
+         }
+      });
+
+      std::cout << "  " << added << " tracks added" << std::endl;
+   }
+
+   {
+      Shell shell;
+      shell.setOutputStream(output);
+      shell.setInteractive(false);
+
+      measure("add_dir --recursive", files, [&]() {
+         shell.execute("add_dir " + root.string() + " --recursive");
+      });
+
+      std::cout << "  " << output.str();
+   }
+
+   {
+      std::string cache_file = (std::filesystem::temp_directory_path() / "iplayer_library_scan_benchmark.cache").string();
+      std::filesystem::remove(cache_file);
+
+      Shell shell;
+      shell.setOutputStream(output);
+      shell.setInteractive(false);
+
+      shell.execute("cache on " + cache_file);
+      output.str(std::string());
+
+      for (const char* run : { "add_dir --recursive, cold metadata cache", "add_dir --recursive, warm metadata cache" })
+      {
+         measure(run, files, [&]() {
+            shell.execute("add_dir " + root.string() + " --recursive");
+         });
+
+         std::cout << "  " << output.str();
+         output.str(std::string());
+      }
+
+      shell.execute("cache off");
+      std::cout << "  cache file: " << std::filesystem::file_size(cache_file) << " bytes" << std::endl;
+      std::filesystem::remove(cache_file);
+   }
+
+   // scaling of the scanner with the number of threads
+   size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+   for (size_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+   {
+      MusicPlayer::ThreadPool pool(threads);
+      Playlist playlist;
+      LibraryScanner::Report report;
+      std::string error;
+
+      measure("scanner, " + std::to_string(threads) + " thread(s)", files, [&]() {
+         LibraryScanner::scan(root.string(), true, playlist, report, error, pool);
+      });
+
+      std::cout << "  " << report.added_count << " tracks added, " << report.malformed_files.count << " invalid files" << std::endl;
+
+      if (threads == max_threads)
+         break;
+   }
+
+   std::filesystem::remove_all(root);
+
+   return 0;
+}
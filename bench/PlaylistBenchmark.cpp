@@ -0,0 +1,168 @@
+// Compares the Playlist container against the std::list based playlist it replaced.
+
+#include "Benchmark.h"
+#include "Playlist.h"
+
+#include <iterator>
+#include <list>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using MusicPlayer::Playlist;
+using MusicPlayer::Track;
+using MusicPlayer::Bench::doNotOptimize;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   using ListPlaylist = std::list<std::pair<std::string, Track>>;
+
+   constexpr size_t kEntries = 1000000;
+   constexpr size_t kJumps = 1000;
+   constexpr size_t kLookups = 100;
+   constexpr size_t kRemovals = 1000;
+   constexpr size_t kRangeStart = 100;
+   constexpr size_t kRangeLength = 100000;
+
+   std::string pathFor(size_t idx)
+   {
+      return "library/track_" + std::to_string(idx % 5000) + ".music";
+   }
+}
+
+int main()
+{
+   std::mt19937 rng(42);
+   std::uniform_int_distribution<size_t> position_distribution(0, kEntries - 1);
+
+   std::vector<size_t> jump_targets(kJumps);
+   for (size_t& target : jump_targets)
+      target = position_distribution(rng);
+
+   std::set<size_t> removed_positions;
+   while (removed_positions.size() < kRemovals)
+      removed_positions.insert(position_distribution(rng));
+
+   Track track("Running Up That Hill", 295, "FLAC");
+
+   std::cout << "Playlist of " << kEntries << " entries" << std::endl << std::endl;
+
+   // std::list
+   {
+      ListPlaylist list;
+      ListPlaylist::iterator current;
+
+      measure("std::list: append", kEntries, [&]() {
+         for (size_t idx = 0; idx < kEntries; idx++)
+            list.push_back({ pathFor(idx), track });
+      });
+
+      measure("std::list: random jumps", kJumps, [&]() {
+         for (size_t target : jump_targets)
+         {
+            current = std::next(list.begin(), target);
+            doNotOptimize(current);
+         }
+      });
+
+      std::vector<ListPlaylist::iterator> selections;
+      for (size_t idx = 0; idx < kLookups; idx++)
+         selections.push_back(std::next(list.begin(), jump_targets[idx]));
+
+      measure("std::list: position of selection", kLookups, [&]() {
+         for (ListPlaylist::iterator selection : selections)
+            doNotOptimize(std::distance(list.begin(), selection));
+      });
+
+      std::string looked_up_path = pathFor(kEntries / 2);
+
+      measure("std::list: positions of a file name", 1, [&]() {
+         std::vector<size_t> found_positions;
+         size_t idx(0);
+         for (auto it = list.begin(); it != list.end(); it++, idx++)
+         {
+            if (it->first == looked_up_path)
+               found_positions.push_back(idx);
+         }
+         doNotOptimize(found_positions);
+      });
+
+      measure("std::list: remove by positions", kRemovals, [&]() {
+         size_t idx(0);
+         for (auto it = list.begin(); it != list.end(); idx++)
+         {
+            if (removed_positions.count(idx))
+               it = list.erase(it);
+            else
+               it++;
+         }
+      });
+   }
+
+   std::cout << std::endl;
+
+   // Playlist
+   {
+      Playlist playlist;
+
+      measure("Playlist: append", kEntries, [&]() {
+         for (size_t idx = 0; idx < kEntries; idx++)
+            playlist.append(pathFor(idx), track);
+      });
+
+      measure("Playlist: random jumps", kJumps, [&]() {
+         for (size_t target : jump_targets)
+         {
+            playlist.setCurrentPosition(target);
+            doNotOptimize(playlist.current());
+         }
+      });
+
+      std::vector<Playlist::Handle> selections;
+      for (size_t idx = 0; idx < kLookups; idx++)
+         selections.push_back(playlist[jump_targets[idx]].handle);
+
+      measure("Playlist: position of selection", kLookups, [&]() {
+         for (Playlist::Handle selection : selections)
+            doNotOptimize(playlist.positionOf(selection));
+      });
+
+      MusicPlayer::InternedString looked_up_path = MusicPlayer::StringPool::shared().intern(pathFor(kEntries / 2));
+
+      measure("Playlist: positions of a file name", 1, [&]() {
+         doNotOptimize(playlist.positionsOf(looked_up_path));
+      });
+
+      measure("Playlist: remove by positions", kRemovals, [&]() {
+         playlist.removeIf([&](size_t position, const Playlist::Entry&) {
+            return removed_positions.count(position) > 0;
+         });
+      });
+
+      measure("Playlist: single erase", 1, [&]() {
+         playlist.erase(playlist.size() / 2);
+      });
+
+      // the same 100k consecutive positions, collected in a set as remove_track did, then as a single range
+      measure("Playlist: remove range by positions", kRangeLength, [&]() {
+         std::set<size_t> range_positions;
+         for (size_t idx = 0; idx < kRangeLength; idx++)
+            range_positions.insert(kRangeStart + idx);
+
+         playlist.removeIf([&](size_t position, const Playlist::Entry&) {
+            return range_positions.count(position) > 0;
+         });
+      });
+
+      measure("Playlist: remove range", kRangeLength, [&]() {
+         playlist.removeRanges({ { kRangeStart, kRangeLength } });
+      });
+
+      measure("Playlist: keep range", playlist.size() - kRangeLength, [&]() {
+         playlist.keepRanges({ { kRangeStart, kRangeLength } });
+      });
+   }
+
+   return 0;
+}
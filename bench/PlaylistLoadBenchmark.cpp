@@ -0,0 +1,117 @@
+// Measures how fast large *.playlist files are loaded.
+//
+// Usage: playlist_load_benchmark [number of lines]
+
+#include "Benchmark.h"
+#include "MappedFile.h"
+#include "PlaylistLoader.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using MusicPlayer::Playlist;
+using MusicPlayer::PlaylistLoader;
+using MusicPlayer::Track;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   const char* kCodecs[] = { "MP3", "FLAC", "Opus", "AAC", "Vorbis" };
+
+   std::string generatePlaylist(size_t lines)
+   {
+      std::string file_name = (std::filesystem::temp_directory_path() / "iplayer_load_benchmark.playlist").string();
+      std::ofstream file(file_name, std::ofstream::out | std::ofstream::trunc);
+
+      // real playlists reference the same files many times
+      for (size_t idx = 0; idx < lines; idx++)
+      {
+         size_t track = idx % 5003;
+
+         file << "library/artist_" << track % 997 << "/track_" << track << ".music||"
+            << "Track number " << track << ";" << track % 10 << ":" << track % 60 << ";" << kCodecs[track % 5] << '\n';
+      }
+
+      return file_name;
+   }
+
+   // The line-by-line loading done before the memory-mapped loader.
+   size_t loadWithGetline(const std::string& file_name)
+   {
+      std::ifstream file(file_name, std::ifstream::in);
+      Playlist playlist;
+
+      std::string track_record;
+      while (std::getline(file, track_record))
+      {
+         auto splitted = MusicPlayer::split(track_record, "||");
+         auto infos = MusicPlayer::split(splitted[1], ";");
+         auto duration = MusicPlayer::split(infos[1], ":");
+
+         Track new_track(infos[0], std::stoll(duration[0]) * 60 + std::stoll(duration[1]), infos[2]);
+         playlist.append(splitted[0], std::move(new_track));
+      }
+
+      return playlist.size();
+   }
+}
+
+int main(int argc, char** argv)
+{
+   size_t lines = argc > 1 ? std::stoul(argv[1]) : 2000000;
+
+   std::cout << "Generating a playlist of " << lines << " lines..." << std::endl;
+   std::string file_name = generatePlaylist(lines);
+
+   {
+      Playlist playlist;
+      PlaylistLoader::Report report;
+
+      measure("mmap loader", lines, [&]() {
+         PlaylistLoader::load(file_name, playlist, report);
+      });
+
+      std::cout << "  loaded " << report.loaded_count << " tracks, peak memory "
+         << MusicPlayer::getPeakResidentMemory() / (1024 * 1024) << " MB" << std::endl;
+   }
+
+   // scaling of the parallel parser with the number of threads
+   {
+      MusicPlayer::MappedFile file(file_name);
+      size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+      for (size_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+      {
+         MusicPlayer::ThreadPool pool(threads);
+         Playlist playlist;
+         PlaylistLoader::Report report;
+
+         measure("parallel parser, " + std::to_string(threads) + " thread(s)", lines, [&]() {
+            PlaylistLoader::parseParallel(file.view(), playlist, report, pool);
+         });
+
+         if (threads == max_threads)
+            break;
+      }
+   }
+
+   {
+      size_t loaded(0);
+
+      measure("getline + split", lines, [&]() {
+         loaded = loadWithGetline(file_name);
+      });
+
+      std::cout << "  loaded " << loaded << " tracks, peak memory "
+         << MusicPlayer::getPeakResidentMemory() / (1024 * 1024) << " MB" << std::endl;
+   }
+
+   std::remove(file_name.c_str());
+
+   return 0;
+}
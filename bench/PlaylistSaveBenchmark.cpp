@@ -0,0 +1,88 @@
+// Compares saving a large playlist after a small change as a binary playlist, rewritten entirely, and as a
+// journaled playlist, where only the change is appended.
+//
+// Usage: playlist_save_benchmark [number of entries] [number of saves]
+
+#include "Benchmark.h"
+#include "BinaryPlaylist.h"
+#include "PlaylistJournal.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using MusicPlayer::BinaryPlaylist;
+using MusicPlayer::Playlist;
+using MusicPlayer::PlaylistJournal;
+using MusicPlayer::Track;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   const char* kCodecs[] = { "MP3", "FLAC", "Opus", "AAC", "Vorbis" };
+
+   void appendTrack(Playlist& playlist, size_t idx)
+   {
+      size_t track = idx % 5003;
+      playlist.append("library/artist_" + std::to_string(track % 997) + "/track_" + std::to_string(track) + ".music",
+         Track("Track number " + std::to_string(track), static_cast<time_t>(track % 600), kCodecs[track % 5]));
+   }
+}
+
+int main(int argc, char** argv)
+{
+   size_t entries = argc > 1 ? std::stoul(argv[1]) : 1000000;
+   size_t saves = argc > 2 ? std::stoul(argv[2]) : 100;
+
+   std::filesystem::path directory = std::filesystem::temp_directory_path();
+   std::string binary_file = (directory / "iplayer_save_benchmark.iplb").string();
+   std::string journaled_file = (directory / "iplayer_save_benchmark.iplj").string();
+
+   Playlist playlist;
+   PlaylistJournal journal;
+   playlist.setJournal(&journal);
+
+   for (size_t idx = 0; idx < entries; idx++)
+      appendTrack(playlist, idx);
+
+   std::string error;
+   PlaylistJournal::SaveReport report;
+
+   measure("journaled playlist, first save", 1, [&]() {
+      journal.save(journaled_file, playlist, report, error);
+   });
+
+   std::cout << "  " << report.written_bytes << " bytes written" << std::endl;
+
+   // each save follows the addition of one track
+   size_t written(0);
+   size_t compactions(0);
+
+   measure("journaled playlist, save after an add", saves, [&]() {
+      for (size_t idx = 0; idx < saves; idx++)
+      {
+         appendTrack(playlist, idx);
+
+         report = PlaylistJournal::SaveReport();
+         journal.save(journaled_file, playlist, report, error);
+         written += report.written_bytes;
+         compactions += report.compacted ? 1 : 0;
+      }
+   });
+
+   std::cout << "  " << written / saves << " bytes written per save, " << compactions << " compaction(s)" << std::endl;
+
+   measure("binary playlist, save after an add", saves, [&]() {
+      for (size_t idx = 0; idx < saves; idx++)
+      {
+         appendTrack(playlist, idx);
+         BinaryPlaylist::save(binary_file, playlist, error);
+      }
+   });
+
+   std::cout << "  " << std::filesystem::file_size(binary_file) << " bytes written per save" << std::endl;
+
+   std::filesystem::remove(binary_file);
+   std::filesystem::remove(journaled_file);
+
+   return 0;
+}
@@ -0,0 +1,85 @@
+// Measures the cost of each resampler preset in CPU percent of one real-time stereo stream.
+
+#include "Benchmark.h"
+#include "Resampler.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using MusicPlayer::Resampler;
+using MusicPlayer::Bench::doNotOptimize;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   constexpr unsigned kChannels = 2;
+   constexpr size_t kBlockFrames = 1024;
+   constexpr double kStreamSeconds = 60.0;
+
+   struct Conversion
+   {
+      unsigned input_rate;
+      unsigned output_rate;
+   };
+
+   constexpr Conversion kConversions[] = {
+      { 44100, 48000 },
+      { 48000, 44100 },
+      { 8000, 48000 },
+      { 96000, 44100 },
+   };
+}
+
+int main()
+{
+   std::mt19937 rng(42);
+   std::uniform_real_distribution<float> sample_distribution(-1.0f, 1.0f);
+
+   std::cout << "Resampling " << kStreamSeconds << " s of stereo audio in blocks of " << kBlockFrames << " frames" << std::endl << std::endl;
+
+   for (Conversion conversion : kConversions)
+   {
+      std::vector<float> input(static_cast<size_t>(kStreamSeconds * conversion.input_rate) * kChannels);
+      for (float& sample : input)
+         sample = sample_distribution(rng);
+
+      for (Resampler::Quality quality : { Resampler::Quality::Fast, Resampler::Quality::Medium, Resampler::Quality::High })
+      {
+         std::string name = std::to_string(conversion.input_rate) + " -> " + std::to_string(conversion.output_rate) + " Hz, "
+            + std::string(Resampler::getQualityName(quality));
+
+         Resampler resampler;
+
+         // the first configuration computes the filter tables, the next ones find them in the cache
+         measure(name + ": tables", 0, [&]() {
+            resampler.configure(conversion.input_rate, conversion.output_rate, kChannels, quality);
+         });
+
+         measure(name + ": cached tables", 0, [&]() {
+            resampler.configure(conversion.input_rate, conversion.output_rate, kChannels, quality);
+         });
+
+         std::vector<float> output(resampler.getMaxOutputFrames(kBlockFrames) * kChannels);
+         size_t input_frames = input.size() / kChannels;
+         size_t output_frames(0);
+
+         double seconds = measure(name + ": stream", 0, [&]() {
+            for (size_t frame = 0; frame < input_frames; frame += kBlockFrames)
+            {
+               size_t block_frames = std::min(kBlockFrames, input_frames - frame);
+               output_frames += resampler.process(input.data() + frame * kChannels, block_frames, output.data());
+               doNotOptimize(output.front());
+            }
+
+            output_frames += resampler.flush(output.data());
+         });
+
+         std::cout << "  " << output_frames << " frames, " << std::setprecision(3)
+            << seconds / kStreamSeconds * 100.0 << "% CPU per stream" << std::endl;
+      }
+
+      std::cout << std::endl;
+   }
+
+   return 0;
+}
@@ -0,0 +1,237 @@
+// Stress test of the work-stealing thread pool, and the latency of its jobs per priority under load.
+//
+// Usage: scheduler_benchmark [<threads>]
+
+#include "Benchmark.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using MusicPlayer::ThreadPool;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   using Clock = std::chrono::steady_clock;
+   using Priority = ThreadPool::Priority;
+
+   constexpr size_t kEmptyJobs = 200000;
+   constexpr unsigned kTreeDepth = 16;
+   constexpr size_t kBackgroundJobs = 4000;
+   constexpr std::chrono::microseconds kBackgroundJobDuration(100);
+   constexpr std::chrono::microseconds kRealtimePeriod(1000);
+   constexpr size_t kCancelledJobs = 10000;
+
+   void spin(std::chrono::microseconds duration)
+   {
+      Clock::time_point end = Clock::now() + duration;
+      while (Clock::now() < end)
+         continue;
+   }
+
+   // counts the leaves of a binary tree of jobs, each node waiting for its children
+   std::uint64_t countLeaves(ThreadPool& pool, unsigned depth)
+   {
+      if (depth == 0)
+         return 1;
+
+      std::future<std::uint64_t> left = pool.submit(Priority::Background, [&pool, depth]() { return countLeaves(pool, depth - 1); });
+      std::uint64_t right = countLeaves(pool, depth - 1);
+
+      pool.wait(left, Priority::Background);
+      return left.get() + right;
+   }
+
+   double percentile(const std::vector<double>& sorted, double fraction)
+   {
+      if (sorted.empty())
+         return 0.0;
+
+      size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+      return sorted[std::min(rank, sorted.size() - 1)];
+   }
+
+   void printPercentiles(const std::string& name, std::vector<double> latencies)
+   {
+      std::sort(latencies.begin(), latencies.end());
+
+      std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+         << "p50 " << std::setw(8) << percentile(latencies, 0.50)
+         << "  p99 " << std::setw(8) << percentile(latencies, 0.99)
+         << "  max " << std::setw(8) << (latencies.empty() ? 0.0 : latencies.back()) << " us" << std::endl;
+   }
+
+   void printStatistics(const ThreadPool& pool)
+   {
+      ThreadPool::Statistics statistics = pool.getStatistics();
+
+      for (size_t level = 0; level < ThreadPool::kPriorityCount; level++)
+      {
+         const ThreadPool::Statistics::Level& counters = statistics.levels[level];
+
+         std::cout << "  " << std::left << std::setw(12) << ThreadPool::getPriorityName(static_cast<Priority>(level)) << std::right
+            << std::setw(10) << counters.executed << " executed" << std::setw(8) << counters.cancelled << " cancelled"
+            << std::fixed << std::setprecision(1) << "  latency " << counters.average_latency_us << " us average, "
+            << counters.max_latency_us << " us max" << std::endl;
+      }
+
+      std::cout << "  " << statistics.steals << " jobs stolen" << std::endl;
+   }
+}
+
+int main(int argc, char** argv)
+{
+   long long thread_count(0);
+
+   if ((argc > 1 && (!MusicPlayer::parseInteger(argv[1], thread_count) || thread_count < 1)) || argc > 2)
+   {
+      std::cerr << "Usage: scheduler_benchmark [<threads>]" << std::endl;
+      return 2;
+   }
+
+   ThreadPool pool(static_cast<size_t>(thread_count));
+   bool failed(false);
+
+   std::cout << pool.size() << " worker(s)" << std::endl << std::endl;
+
+   // submission and execution overhead, from a thread outside the pool
+   std::atomic<size_t> executed(0);
+   measure("empty jobs", kEmptyJobs, [&]() {
+      std::vector<std::future<void>> results;
+      results.reserve(kEmptyJobs);
+
+      for (size_t idx = 0; idx < kEmptyJobs; idx++)
+         results.push_back(pool.submit([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }));
+
+      for (std::future<void>& result : results)
+         pool.wait(result, Priority::Background);
+   });
+
+   // jobs spawning jobs from the workers, stolen by the idle ones
+   std::uint64_t leaves(0);
+   measure("job tree (depth " + std::to_string(kTreeDepth) + ")", (size_t(2) << kTreeDepth) - 1, [&]() {
+      std::future<std::uint64_t> root = pool.submit(Priority::Background, [&pool]() { return countLeaves(pool, kTreeDepth); });
+      pool.wait(root, Priority::Background);
+      leaves = root.get();
+   });
+
+   if (executed != kEmptyJobs || leaves != (std::uint64_t(1) << kTreeDepth))
+   {
+      std::cerr << "Lost jobs: " << executed << " of " << kEmptyJobs << " empty jobs, " << leaves << " leaves." << std::endl;
+      failed = true;
+   }
+
+   // jobs cancelled while the workers are busy are skipped
+   {
+      std::promise<void> release;
+      std::shared_future<void> released = release.get_future().share();
+      std::vector<std::future<void>> blockers;
+      for (size_t idx = 0; idx < pool.size(); idx++)
+         blockers.push_back(pool.submit(Priority::Realtime, [released]() { released.wait(); }));
+
+      std::atomic<size_t> ran(0);
+      std::atomic<size_t> ran_cancelled(0);
+      std::vector<ThreadPool::CancellationToken> tokens(kCancelledJobs);
+      std::vector<std::future<void>> results;
+
+      for (size_t idx = 0; idx < kCancelledJobs; idx++)
+      {
+         results.push_back(pool.submit(Priority::Prefetch, tokens[idx], [&ran, &ran_cancelled, token = tokens[idx]]() {
+            ran.fetch_add(1, std::memory_order_relaxed);
+            if (token.isCancelled())
+               ran_cancelled.fetch_add(1, std::memory_order_relaxed);
+         }));
+      }
+
+      for (size_t idx = 0; idx < kCancelledJobs; idx += 2)
+         tokens[idx].cancel();
+
+      release.set_value();
+
+      size_t broken(0);
+      for (std::future<void>& result : results)
+      {
+         try
+         {
+            result.get();
+         }
+         catch (const std::future_error&)
+         {
+            broken++;
+         }
+      }
+
+      for (std::future<void>& blocker : blockers)
+         blocker.get();
+
+      std::cout << std::left << std::setw(40) << "cancellation" << std::right << ran << " ran, " << broken << " skipped" << std::endl;
+
+      if (ran != kCancelledJobs / 2 || broken != kCancelledJobs / 2 || ran_cancelled != 0)
+      {
+         std::cerr << "Cancelled jobs were executed." << std::endl;
+         failed = true;
+      }
+   }
+
+   std::cout << std::endl;
+   printStatistics(pool);
+
+   // realtime and prefetch jobs submitted periodically while the workers are saturated by background jobs
+   std::cout << std::endl << kBackgroundJobs << " background jobs of " << kBackgroundJobDuration.count() << " us, a realtime and a prefetch job every "
+      << kRealtimePeriod.count() << " us" << std::endl << std::endl;
+
+   std::mutex latencies_mutex;
+   std::vector<double> latencies[ThreadPool::kPriorityCount];
+
+   auto timedJob = [&](Priority priority) {
+      Clock::time_point submitted = Clock::now();
+      return pool.submit(priority, [&, priority, submitted]() {
+         double latency = std::chrono::duration<double, std::micro>(Clock::now() - submitted).count();
+         std::lock_guard<std::mutex> lock(latencies_mutex);
+         latencies[static_cast<size_t>(priority)].push_back(latency);
+      });
+   };
+
+   measure("load", kBackgroundJobs, [&]() {
+      std::vector<std::future<void>> background;
+      background.reserve(kBackgroundJobs);
+
+      for (size_t idx = 0; idx < kBackgroundJobs; idx++)
+      {
+         Clock::time_point submitted = Clock::now();
+         background.push_back(pool.submit(Priority::Background, [&, submitted]() {
+            double latency = std::chrono::duration<double, std::micro>(Clock::now() - submitted).count();
+            {
+               std::lock_guard<std::mutex> lock(latencies_mutex);
+               latencies[static_cast<size_t>(Priority::Background)].push_back(latency);
+            }
+            spin(kBackgroundJobDuration);
+         }));
+      }
+
+      std::vector<std::future<void>> periodic;
+      while (background.back().wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      {
+         periodic.push_back(timedJob(Priority::Realtime));
+         periodic.push_back(timedJob(Priority::Prefetch));
+         std::this_thread::sleep_for(kRealtimePeriod);
+      }
+
+      for (std::future<void>& result : background)
+         result.get();
+      for (std::future<void>& result : periodic)
+         result.get();
+   });
+
+   std::cout << std::endl;
+   for (size_t level = 0; level < ThreadPool::kPriorityCount; level++)
+      printPercentiles(std::string(ThreadPool::getPriorityName(static_cast<Priority>(level))) + " latency", latencies[level]);
+
+   return failed ? 1 : 0;
+}
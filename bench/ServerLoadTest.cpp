@@ -0,0 +1,280 @@
+// Opens many sessions on a server and measures the latency of their instructions.
+//
+// Usage: server_load_test [<sessions> [<instructions per session> [<socket path>]]]
+// Without a socket path, a server is started in the process on a temporary socket.
+
+#include "Benchmark.h"
+#include "Server.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using MusicPlayer::Server;
+using MusicPlayer::Bench::generatePlaylist;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   using Clock = std::chrono::steady_clock;
+
+   constexpr size_t kDefaultSessions = 1000;
+   constexpr size_t kDefaultInstructions = 50;
+   constexpr size_t kMaxClientThreads = 16;
+
+   const std::vector<std::string> kScript = { "next", "show_track", "prev 2", "play", "pause", "volume 50", "random",
+      "next 3", "playback_stats", "help next" };
+
+   int connectTo(const std::string& socket_path)
+   {
+      sockaddr_un address{};
+      address.sun_family = AF_UNIX;
+      socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+      {
+         close(fd);
+         fd = -1;
+      }
+
+      return fd;
+   }
+
+   /**
+    * \brief A client session sending one instruction at a time, and waiting for its answer.
+    */
+   class Client
+   {
+   public:
+      explicit Client(int fd) : fd_(fd) {}
+      ~Client() { close(fd_); }
+
+      Client(const Client&) = delete;
+      Client& operator=(const Client&) = delete;
+
+      /**
+       * \return false if the connection failed.
+       */
+      bool execute(const std::string& instruction)
+      {
+         std::string line = instruction + '\n';
+         if (send(fd_, line.data(), line.size(), 0) != static_cast<ssize_t>(line.size()))
+            return false;
+
+         // header "ok <length>" or "error <length>", then the printed text
+         size_t header_end;
+         while ((header_end = buffer_.find('\n')) == std::string::npos)
+         {
+            if (!receive_())
+               return false;
+         }
+
+         long long length(0);
+         std::string_view header(buffer_.data(), header_end);
+         if (!MusicPlayer::parseInteger(header.substr(header.find(' ') + 1), length))
+            return false;
+
+         while (buffer_.size() < header_end + 1 + static_cast<size_t>(length))
+         {
+            if (!receive_())
+               return false;
+         }
+
+         buffer_.erase(0, header_end + 1 + static_cast<size_t>(length));
+         return true;
+      }
+
+   private:
+      bool receive_()
+      {
+         char chunk[4096];
+         ssize_t received = recv(fd_, chunk, sizeof(chunk), 0);
+         if (received <= 0)
+            return false;
+
+         buffer_.append(chunk, static_cast<size_t>(received));
+         return true;
+      }
+
+      int fd_;
+      std::string buffer_;
+   };
+
+   double percentile(const std::vector<double>& sorted, double fraction)
+   {
+      if (sorted.empty())
+         return 0.0;
+
+      size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+      return sorted[std::min(rank, sorted.size() - 1)];
+   }
+
+   void printPercentiles(const std::string& name, std::vector<double> latencies)
+   {
+      std::sort(latencies.begin(), latencies.end());
+
+      std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+         << "p50 " << std::setw(8) << percentile(latencies, 0.50)
+         << "  p90 " << std::setw(8) << percentile(latencies, 0.90)
+         << "  p99 " << std::setw(8) << percentile(latencies, 0.99)
+         << "  max " << std::setw(8) << (latencies.empty() ? 0.0 : latencies.back()) << " us" << std::endl;
+   }
+}
+
+int main(int argc, char** argv)
+{
+   long long session_count(kDefaultSessions);
+   long long instruction_count(kDefaultInstructions);
+
+   if ((argc > 1 && (!MusicPlayer::parseInteger(argv[1], session_count) || session_count < 1))
+      || (argc > 2 && (!MusicPlayer::parseInteger(argv[2], instruction_count) || instruction_count < 1)) || argc > 4)
+   {
+      std::cerr << "Usage: server_load_test [<sessions> [<instructions per session> [<socket path>]]]" << std::endl;
+      return 2;
+   }
+
+   // every session uses a socket on each side
+   rlimit files;
+   if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max)
+   {
+      files.rlim_cur = files.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &files);
+   }
+
+   std::string socket_path;
+   std::unique_ptr<Server> server;
+   std::thread server_thread;
+
+   if (argc > 3)
+   {
+      socket_path = argv[3];
+   }
+   else
+   {
+      socket_path = (std::filesystem::temp_directory_path() / ("iplayer_load_test_" + std::to_string(getpid()) + ".sock")).string();
+      server = std::make_unique<Server>(socket_path);
+
+      std::string error;
+      if (!server->listen(error))
+      {
+         std::cerr << error << std::endl;
+         return 1;
+      }
+
+      server_thread = std::thread(&Server::run, server.get());
+   }
+
+   std::string playlist_file = generatePlaylist("iplayer_server_load_test.playlist");
+
+   std::vector<std::unique_ptr<Client>> clients;
+   clients.reserve(static_cast<size_t>(session_count));
+
+   measure("open sessions", static_cast<size_t>(session_count), [&]() {
+      for (long long idx = 0; idx < session_count; idx++)
+      {
+         int fd = connectTo(socket_path);
+         if (fd < 0)
+            break;
+
+         clients.push_back(std::make_unique<Client>(fd));
+      }
+   });
+
+   auto stopServer = [&]() {
+      clients.clear();
+
+      if (server)
+      {
+         server->stop();
+         server_thread.join();
+      }
+
+      std::remove(playlist_file.c_str());
+   };
+
+   if (clients.size() != static_cast<size_t>(session_count))
+   {
+      std::cerr << "Only " << clients.size() << " session(s) could be opened." << std::endl;
+      stopServer();
+      return 1;
+   }
+
+   size_t thread_count = std::min(clients.size(), kMaxClientThreads);
+   std::vector<std::vector<double>> session_latencies(clients.size());
+   std::vector<double> load_latencies(clients.size());
+   std::atomic<size_t> failures(0);
+
+   std::cout << session_count << " sessions, " << instruction_count << " instructions each, from " << thread_count
+      << " client threads" << std::endl << std::endl;
+
+   double seconds = measure("instructions", clients.size() * static_cast<size_t>(instruction_count), [&]() {
+      std::vector<std::thread> threads;
+
+      for (size_t thread_idx = 0; thread_idx < thread_count; thread_idx++)
+      {
+         threads.emplace_back([&, thread_idx]() {
+            // each session loads its playlist, then the sessions of the thread take turns
+            for (size_t session = thread_idx; session < clients.size(); session += thread_count)
+            {
+               Clock::time_point start = Clock::now();
+               if (!clients[session]->execute("load " + playlist_file))
+                  failures++;
+               load_latencies[session] = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            }
+
+            for (long long round = 0; round < instruction_count; round++)
+            {
+               for (size_t session = thread_idx; session < clients.size(); session += thread_count)
+               {
+                  Clock::time_point start = Clock::now();
+                  if (!clients[session]->execute(kScript[(round + session) % kScript.size()]))
+                     failures++;
+                  session_latencies[session].push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+               }
+            }
+         });
+      }
+
+      for (std::thread& thread : threads)
+         thread.join();
+   });
+
+   std::cout << "  " << std::setprecision(0) << clients.size() * instruction_count / seconds << " instructions/s" << std::endl << std::endl;
+
+   std::vector<double> all_latencies;
+   std::vector<double> session_medians;
+   std::vector<double> session_tails;
+
+   for (std::vector<double>& latencies : session_latencies)
+   {
+      all_latencies.insert(all_latencies.end(), latencies.begin(), latencies.end());
+
+      std::sort(latencies.begin(), latencies.end());
+      session_medians.push_back(percentile(latencies, 0.50));
+      session_tails.push_back(percentile(latencies, 0.99));
+   }
+
+   printPercentiles("load (100 tracks)", load_latencies);
+   printPercentiles("all instructions", all_latencies);
+   printPercentiles("per-session p50", session_medians);
+   printPercentiles("per-session p99", session_tails);
+
+   if (failures > 0)
+      std::cout << std::endl << failures << " instruction(s) failed at the connection level." << std::endl;
+
+   stopServer();
+
+   return failures > 0 ? 1 : 0;
+}
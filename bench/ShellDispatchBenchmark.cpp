@@ -0,0 +1,81 @@
+// Measures how many instructions per second the shell can dispatch.
+
+#include "AllocationCounter.h"
+#include "Benchmark.h"
+#include "Shell.h"
+#include "Utils.h"
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using MusicPlayer::Shell;
+using MusicPlayer::Bench::AllocationCounter;
+using MusicPlayer::Bench::generatePlaylist;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   constexpr size_t kCommands = 2000000;
+
+   const std::vector<std::string> kScript = { "next", "prev", "play", "pause", "next 3", "prev 2", "repeat" };
+
+   // The dispatch used before the instruction table: split, then two lookups in a map of std::function.
+   size_t dispatchWithMap()
+   {
+      using ArgumentArray = std::vector<std::string>;
+      using Instruction = std::function<void(const ArgumentArray&)>;
+
+      bool state(false);
+      std::unordered_map<std::string, Instruction> instructions;
+      for (const char* name : { "next", "prev", "play", "pause", "repeat", "random", "help", "load", "save" })
+         instructions.emplace(name, [&state](const ArgumentArray&) { state = !state; });
+
+      for (size_t idx = 0; idx < kCommands; idx++)
+      {
+         std::vector<std::string> parsed = MusicPlayer::split(kScript[idx % kScript.size()], " ");
+
+         if (instructions.count(parsed[0]))
+            instructions.at(parsed[0])(ArgumentArray(parsed.begin() + 1, parsed.end()));
+      }
+
+      return state;
+   }
+}
+
+int main()
+{
+   std::string playlist_file = generatePlaylist("iplayer_dispatch_benchmark.playlist");
+
+   std::ostream null_output(nullptr);
+   Shell shell(std::cin, null_output);
+   shell.execute("load " + playlist_file);
+
+   // warm up the reused argument buffer
+   for (const std::string& command : kScript)
+      shell.execute(command);
+
+   size_t allocations_before = AllocationCounter::allocations;
+
+   measure("Shell::execute", kCommands, [&]() {
+      for (size_t idx = 0; idx < kCommands; idx++)
+         shell.execute(kScript[idx % kScript.size()]);
+   });
+
+   std::cout << "  allocations per command: " << std::setprecision(2)
+      << static_cast<double>(AllocationCounter::allocations - allocations_before) / kCommands << std::endl;
+
+   allocations_before = AllocationCounter::allocations;
+
+   measure("split + unordered_map<std::function>", kCommands, [&]() {
+      dispatchWithMap();
+   });
+
+   std::cout << "  allocations per command: " << std::setprecision(2)
+      << static_cast<double>(AllocationCounter::allocations - allocations_before) / kCommands << std::endl;
+
+   std::remove(playlist_file.c_str());
+
+   return 0;
+}
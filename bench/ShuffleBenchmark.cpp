@@ -0,0 +1,77 @@
+// Measures the steps of the shuffle through a large playlist: a full cycle forward, back through the history,
+// and forward again while tracks are added and removed.
+//
+// Usage: shuffle_benchmark [number of entries]
+
+#include "Benchmark.h"
+#include "Shuffle.h"
+
+#include <iostream>
+#include <string>
+
+using MusicPlayer::Playlist;
+using MusicPlayer::Shuffle;
+using MusicPlayer::Track;
+using MusicPlayer::Bench::doNotOptimize;
+using MusicPlayer::Bench::measure;
+
+int main(int argc, char** argv)
+{
+   size_t entries = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+   Playlist playlist;
+   playlist.reserve(entries);
+   for (size_t idx = 0; idx < entries; idx++)
+      playlist.append("library/track_" + std::to_string(idx % 5003) + ".music", Track("Track number " + std::to_string(idx), 180, "MP3"));
+   playlist.setCurrentPosition(0);
+
+   Shuffle shuffle;
+   shuffle.seed(42);
+
+   std::cout << "Shuffle of " << entries << " entries" << std::endl;
+
+   size_t steps(0);
+   measure("next, full cycle", entries - 1, [&]()
+      {
+         Playlist::Handle handle = playlist.current().handle;
+         while ((handle = shuffle.next(playlist, handle, false)) != Playlist::kInvalidHandle)
+         {
+            playlist.setCurrentPosition(playlist.positionOf(handle));
+            steps++;
+         }
+      });
+
+   if (steps != entries - 1)
+      std::cout << "  unexpected cycle length: " << steps << std::endl;
+
+   measure("previous, back through the history", entries - 1, [&]()
+      {
+         Playlist::Handle handle = playlist.current().handle;
+         while ((handle = shuffle.previous(playlist, handle)) != Playlist::kInvalidHandle)
+            playlist.setCurrentPosition(playlist.positionOf(handle));
+      });
+
+   // a new cycle, interleaved with edits at the end of the playlist
+   shuffle.reset();
+   size_t edits = entries / 16;
+
+   measure("next with edits, every 16 steps", entries - 1, [&]()
+      {
+         Playlist::Handle handle = playlist.current().handle;
+         for (size_t step = 0; step + 1 < entries; step++)
+         {
+            if (step % 32 == 0)
+               playlist.append("library/added.music", Track("Added", 60, "FLAC"));
+            else if (step % 32 == 16 && playlist.size() - 1 != playlist.currentPosition())
+               playlist.erase(playlist.size() - 1);
+
+            handle = shuffle.next(playlist, handle, true);
+            playlist.setCurrentPosition(playlist.positionOf(handle));
+         }
+         doNotOptimize(handle);
+      });
+
+   std::cout << "  " << edits << " edits" << std::endl;
+
+   return 0;
+}
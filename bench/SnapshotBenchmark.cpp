@@ -0,0 +1,186 @@
+// Compares readers of the playlist state going through published snapshots with readers locking the playlist,
+// while a writer keeps changing it.
+//
+// Usage: snapshot_benchmark [<max readers>] [<entries>]
+
+#include "PlaylistSnapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using MusicPlayer::Playlist;
+using MusicPlayer::PlaylistSnapshot;
+using MusicPlayer::PlaylistSnapshots;
+using MusicPlayer::Track;
+
+namespace {
+   constexpr std::chrono::milliseconds kDuration(500);
+
+   // one instruction out of this many adds or removes a track, the others move the selection
+   constexpr size_t kEditPeriod = 16;
+
+   struct Result
+   {
+      std::uint64_t reads = 0;
+      std::uint64_t writes = 0;
+   };
+
+   void fillPlaylist(Playlist& playlist, size_t entries)
+   {
+      playlist.reserve(entries + 1);
+      for (size_t idx = 0; idx < entries; idx++)
+         playlist.append("library/track_" + std::to_string(idx % 5003) + ".music", Track("Track number " + std::to_string(idx), 180, "MP3"));
+      playlist.setCurrentPosition(0);
+   }
+
+   // an instruction of the writer: moves the selection, or adds or removes the last track
+   void edit(Playlist& playlist, size_t step)
+   {
+      if (step % kEditPeriod == 0)
+         playlist.append("library/added.music", Track("Added", 60, "FLAC"));
+      else if (step % kEditPeriod == kEditPeriod / 2)
+         playlist.erase(playlist.size() - 1);
+      else
+         playlist.setCurrentPosition((playlist.currentPosition() + 1) % (playlist.size() - 1));
+   }
+
+   /**
+    * \brief Runs a writer and reader threads for kDuration.
+    *
+    * \param write Called by the writer with the step number.
+    * \param read Called by the readers, returns a value read from the state.
+    */
+   template <typename Write, typename Read>
+   Result run(size_t readers, Write write, Read read)
+   {
+      std::atomic<bool> stop(false);
+      std::atomic<std::uint64_t> reads(0);
+      std::uint64_t writes(0);
+
+      std::vector<std::thread> threads;
+      for (size_t idx = 0; idx < readers; idx++)
+      {
+         threads.emplace_back([&]()
+            {
+               std::uint64_t count(0);
+               size_t checksum(0);
+
+               while (!stop.load(std::memory_order_relaxed))
+               {
+                  checksum += read();
+                  count++;
+               }
+
+               reads += count + (checksum == SIZE_MAX ? 1 : 0);
+            });
+      }
+
+      auto end = std::chrono::steady_clock::now() + kDuration;
+      while (std::chrono::steady_clock::now() < end)
+         write(writes++);
+
+      stop = true;
+      for (std::thread& thread : threads)
+         thread.join();
+
+      return { reads.load(), writes };
+   }
+
+   void print(const std::string& name, size_t readers, const Result& result)
+   {
+      double seconds = std::chrono::duration<double>(kDuration).count();
+
+      std::cout << std::left << std::setw(28) << name << std::right << std::setw(3) << readers << " reader(s)"
+         << std::fixed << std::setprecision(0)
+         << std::setw(16) << result.reads / seconds << " reads/s"
+         << std::setw(14) << result.writes / seconds << " writes/s" << std::endl;
+   }
+}
+
+int main(int argc, char** argv)
+{
+   size_t max_readers = argc > 1 ? std::stoul(argv[1]) : std::max(4u, std::thread::hardware_concurrency());
+   size_t entries = argc > 2 ? std::stoul(argv[2]) : 100000;
+
+   std::cout << "Playlist of " << entries << " entries, one edit every " << kEditPeriod << " instructions" << std::endl;
+
+   for (size_t readers = 1; readers <= max_readers; readers *= 2)
+   {
+      {
+         Playlist playlist;
+         fillPlaylist(playlist, entries);
+         std::mutex mutex;
+
+         Result result = run(readers, [&](size_t step)
+            {
+               std::lock_guard<std::mutex> lock(mutex);
+               edit(playlist, step);
+            },
+            [&]()
+            {
+               std::lock_guard<std::mutex> lock(mutex);
+               return playlist.size() + playlist.current().track.getTitle().size();
+            });
+
+         print("mutex", readers, result);
+      }
+
+      {
+         Playlist playlist;
+         fillPlaylist(playlist, entries);
+         std::shared_mutex mutex;
+
+         Result result = run(readers, [&](size_t step)
+            {
+               std::unique_lock<std::shared_mutex> lock(mutex);
+               edit(playlist, step);
+            },
+            [&]()
+            {
+               std::shared_lock<std::shared_mutex> lock(mutex);
+               return playlist.size() + playlist.current().track.getTitle().size();
+            });
+
+         print("shared_mutex", readers, result);
+      }
+
+      {
+         Playlist playlist;
+         fillPlaylist(playlist, entries);
+         PlaylistSnapshots snapshots;
+         snapshots.publish(playlist, true, false, false);
+
+         Result result = run(readers, [&](size_t step)
+            {
+               edit(playlist, step);
+               snapshots.publish(playlist, true, false, false);
+            },
+            [&snapshots]()
+            {
+               // each reader thread registers once
+               thread_local PlaylistSnapshots::Reader reader(snapshots);
+
+               const PlaylistSnapshot& snapshot = reader.acquire();
+               size_t value = snapshot.size() + snapshot.current().track.getTitle().size();
+               reader.release();
+               return value;
+            });
+
+         print("snapshots", readers, result);
+
+         PlaylistSnapshots::Statistics statistics = snapshots.getStatistics();
+         std::cout << "  " << statistics.published << " snapshots published, " << statistics.copied_chunks << " chunks copied, "
+            << statistics.reused_chunks << " kept" << std::endl;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,85 @@
+// Measures the heap memory used per playlist entry, with and without interned file names and titles.
+
+#include "AllocationCounter.h"
+#include "Benchmark.h"
+#include "Playlist.h"
+
+#include <list>
+#include <string>
+#include <vector>
+
+using MusicPlayer::Playlist;
+using MusicPlayer::StringPool;
+using MusicPlayer::Track;
+using MusicPlayer::Bench::AllocationCounter;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   constexpr size_t kEntries = 1000000;
+   constexpr size_t kDistinctFiles = 5000;
+
+   // The playlist entry layout used before interning.
+   struct LegacyTrack
+   {
+      std::string title;
+      time_t duration;
+      MusicPlayer::Codec::Type codec;
+   };
+
+   using LegacyPlaylist = std::list<std::pair<std::string, LegacyTrack>>;
+
+   std::vector<std::string> paths;
+   std::vector<std::string> titles;
+
+   void generateStrings()
+   {
+      for (size_t idx = 0; idx < kDistinctFiles; idx++)
+      {
+         paths.push_back("library/some artist/some album/track_" + std::to_string(idx) + ".music");
+         titles.push_back("A reasonably long track title #" + std::to_string(idx));
+      }
+   }
+
+   void printMemory(const char* name, size_t bytes, size_t allocations)
+   {
+      std::cout << "  " << name << ": " << bytes / kEntries << " bytes/entry, "
+         << std::setprecision(4) << static_cast<double>(allocations) / kEntries << " allocations/entry" << std::endl;
+   }
+}
+
+int main()
+{
+   generateStrings();
+
+   std::cout << kEntries << " entries referencing " << kDistinctFiles << " distinct files" << std::endl << std::endl;
+
+   {
+      size_t bytes_before = AllocationCounter::live_bytes;
+      size_t allocations_before = AllocationCounter::allocations;
+      LegacyPlaylist playlist;
+
+      measure("std::string per entry", kEntries, [&]() {
+         for (size_t idx = 0; idx < kEntries; idx++)
+            playlist.push_back({ paths[idx % kDistinctFiles], { titles[idx % kDistinctFiles], 180, MusicPlayer::Codec::Type::MP3 } });
+      });
+
+      printMemory("std::string per entry", AllocationCounter::live_bytes - bytes_before, AllocationCounter::allocations - allocations_before);
+   }
+
+   {
+      size_t bytes_before = AllocationCounter::live_bytes;
+      size_t allocations_before = AllocationCounter::allocations;
+      Playlist playlist;
+
+      measure("interned strings", kEntries, [&]() {
+         for (size_t idx = 0; idx < kEntries; idx++)
+            playlist.append(std::string_view(paths[idx % kDistinctFiles]), Track(titles[idx % kDistinctFiles], 180, MusicPlayer::Codec::Type::MP3));
+      });
+
+      printMemory("interned strings", AllocationCounter::live_bytes - bytes_before, AllocationCounter::allocations - allocations_before);
+      std::cout << "  string pool: " << StringPool::shared().size() << " strings in "
+         << StringPool::shared().allocatedBytes() / 1024 << " KB" << std::endl;
+   }
+
+   return 0;
+}
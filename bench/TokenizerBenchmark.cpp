@@ -0,0 +1,93 @@
+// Compares the allocations and speed of parsing playlist lines with split() and with Tokenizer.
+
+#include "AllocationCounter.h"
+#include "Benchmark.h"
+#include "PlaylistLoader.h"
+#include "Utils.h"
+
+#include <string>
+
+using MusicPlayer::PlaylistLoader;
+using MusicPlayer::Tokenizer;
+using MusicPlayer::Track;
+using MusicPlayer::Bench::AllocationCounter;
+using MusicPlayer::Bench::doNotOptimize;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   constexpr size_t kLines = 500000;
+
+   std::string generatePlaylist()
+   {
+      std::string text;
+
+      for (size_t idx = 0; idx < kLines; idx++)
+      {
+         size_t track = idx % 5003;
+         text += "library/artist_" + std::to_string(track % 997) + "/track_" + std::to_string(track) + ".music||"
+            + "Track number " + std::to_string(track) + ";" + std::to_string(track % 10) + ":" + std::to_string(track % 60) + ";FLAC\n";
+      }
+
+      return text;
+   }
+
+   void printAllocations(size_t allocations_before)
+   {
+      std::cout << "  allocations per line: " << std::setprecision(3)
+         << static_cast<double>(AllocationCounter::allocations - allocations_before) / kLines << std::endl;
+   }
+}
+
+int main()
+{
+   std::string text = generatePlaylist();
+
+   // intern the file names and titles once, as they would be after the first occurrence in a real playlist
+   for (std::string_view line : Tokenizer(text, '\n'))
+   {
+      std::string_view track_file;
+      Track track;
+      std::string error;
+      PlaylistLoader::parseLine(line, track_file, track, error);
+   }
+
+   size_t allocations_before = AllocationCounter::allocations;
+
+   measure("split", kLines, [&]() {
+      size_t total_duration(0);
+
+      for (std::string_view line : Tokenizer(text, '\n'))
+      {
+         auto record = MusicPlayer::split(std::string(line), "||");
+         auto fields = MusicPlayer::split(record[1], ";");
+         auto duration = MusicPlayer::split(fields[1], ":");
+         total_duration += std::stoll(duration[0]) * 60 + std::stoll(duration[1]);
+      }
+
+      doNotOptimize(total_duration);
+   });
+
+   printAllocations(allocations_before);
+
+   allocations_before = AllocationCounter::allocations;
+
+   measure("Tokenizer (PlaylistLoader::parseLine)", kLines, [&]() {
+      size_t total_duration(0);
+
+      for (std::string_view line : Tokenizer(text, '\n'))
+      {
+         std::string_view track_file;
+         Track track;
+         std::string error;
+
+         if (PlaylistLoader::parseLine(line, track_file, track, error))
+            total_duration += track.getDuration();
+      }
+
+      doNotOptimize(total_duration);
+   });
+
+   printAllocations(allocations_before);
+
+   return 0;
+}
@@ -0,0 +1,79 @@
+// Measures building sorted and filtered views of a large playlist, and keeping them up to date as tracks are added
+// and removed.
+//
+// Usage: view_benchmark [number of entries]
+
+#include "Benchmark.h"
+#include "PlaylistView.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+
+using MusicPlayer::Playlist;
+using MusicPlayer::PlaylistView;
+using MusicPlayer::ThreadPool;
+using MusicPlayer::Track;
+using MusicPlayer::Bench::measure;
+
+namespace {
+   const char* kCodecs[] = { "MP3", "FLAC", "Opus", "AAC", "Vorbis" };
+   const char* kWords[] = { "Running", "Up", "That", "Hill", "Blue", "Monday", "Heroes", "Night", "Song", "Love", "Time", "Away" };
+
+   constexpr size_t kEdits = 1000;
+
+   void appendTrack(Playlist& playlist, std::mt19937& rng)
+   {
+      std::string title;
+      for (size_t word = 0; word < 3; word++)
+         title += std::string(word > 0 ? " " : "") + kWords[rng() % std::size(kWords)];
+
+      size_t number = rng() % 100000;
+      playlist.append("library/track_" + std::to_string(number) + ".music", Track(title + " " + std::to_string(number), rng() % 900, kCodecs[rng() % 5]));
+   }
+}
+
+int main(int argc, char** argv)
+{
+   size_t entries = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+   std::mt19937 rng(42);
+   Playlist playlist;
+   playlist.reserve(entries + kEdits);
+   for (size_t idx = 0; idx < entries; idx++)
+      appendTrack(playlist, rng);
+
+   std::cout << "Playlist of " << entries << " entries, sorted on " << ThreadPool::shared().size() << " worker(s)" << std::endl << std::endl;
+
+   PlaylistView view;
+   PlaylistView::Filter no_filter;
+
+   measure("define: by title", entries, [&]() { view.define(playlist, PlaylistView::Order::Title, no_filter); });
+   measure("define: by duration", entries, [&]() { view.define(playlist, PlaylistView::Order::Duration, no_filter); });
+   measure("define: by codec", entries, [&]() { view.define(playlist, PlaylistView::Order::Codec, no_filter); });
+
+   PlaylistView::Filter long_flac;
+   long_flac.codec = MusicPlayer::Codec::Type::FLAC;
+   long_flac.longer_than = 300;
+
+   measure("define: FLAC longer than 5:00", entries, [&]() { view.define(playlist, PlaylistView::Order::Playlist, long_flac); });
+
+   view.define(playlist, PlaylistView::Order::Title, no_filter);
+
+   measure("refresh by title after adds", kEdits, [&]() {
+      for (size_t idx = 0; idx < kEdits; idx++)
+         appendTrack(playlist, rng);
+      view.refresh(playlist);
+   });
+
+   measure("refresh by title after removals", kEdits, [&]() {
+      playlist.removeRanges({ { entries / 2, kEdits } });
+      view.refresh(playlist);
+   });
+
+   if (view.size() != playlist.size())
+      std::cout << "  unexpected view size: " << view.size() << std::endl;
+
+   return 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Decoder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Destination of the decoded audio.
+    *
+    * write() is called from the playback thread and must not allocate memory.
+    */
+   class AudioSink
+   {
+   public:
+      virtual ~AudioSink() = default;
+
+      /**
+       * \brief Prepares the sink for a new stream.
+       *
+       * \param format The format of the samples that will be written.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the sink cannot play this stream.
+       */
+      virtual bool open(const AudioFormat& format, std::string& error) = 0;
+
+      /**
+       * \brief Outputs interleaved samples, blocking for as long as the device needs to consume them.
+       */
+      virtual void write(const float* samples, size_t frames) = 0;
+
+      /**
+       * \brief Ends the current stream.
+       */
+      virtual void close() {}
+
+      /**
+       * \brief Tells whether the sink consumes samples at the stream rate, like an audio device.
+       *
+       * Missing samples are replaced by silence for realtime sinks, while other sinks wait for them.
+       */
+      virtual bool isRealtime() const = 0;
+   };
+
+   /**
+    * \brief Discards the audio, optionally at the pace of an audio device.
+    */
+   class NullSink : public AudioSink
+   {
+   public:
+      explicit NullSink(bool realtime = true);
+
+      bool open(const AudioFormat& format, std::string& error) override;
+      void write(const float* samples, size_t frames) override;
+      bool isRealtime() const override { return realtime_; }
+
+   private:
+      bool realtime_;
+      unsigned sample_rate_;
+      std::chrono::steady_clock::time_point played_until_;
+   };
+
+   /**
+    * \brief Writes the audio to a 32-bit float WAVE file, as fast as it is decoded.
+    *
+    * Streams are appended to the same file, which must keep the format of the first one.
+    */
+   class FileSink : public AudioSink
+   {
+   public:
+      explicit FileSink(std::string file_name);
+      ~FileSink() override;
+
+      bool open(const AudioFormat& format, std::string& error) override;
+      void write(const float* samples, size_t frames) override;
+      void close() override;
+      bool isRealtime() const override { return false; }
+
+      const std::string& getFileName() const { return file_name_; }
+
+   private:
+      std::string file_name_;
+      std::ofstream file_;
+      AudioFormat format_;
+      std::uint64_t frames_written_;
+   };
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Playlist.h"
+#include "PlaylistLoader.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Reads and writes playlists in the compact binary *.iplb format.
+    *
+    * Layout (all integers little-endian):
+    * - a 32-byte header: "IPLB" magic, format version, record size, entry count, then the offset and size of
+    *   the string table;
+    * - one fixed-size record per entry: duration in seconds, codec type, ReplayGain flag, then the offset and
+    *   length in the string table of the track file name and title, then the ReplayGain gain and peak as
+    *   32-bit floats;
+    * - the string table, where every distinct string is stored once.
+    *
+    * Loading maps the file and validates every record before adding it to the playlist. Files of version 1,
+    * whose records end before the ReplayGain fields, can still be loaded.
+    */
+   class BinaryPlaylist
+   {
+   public:
+      static constexpr char kExtension[] = ".iplb";
+      static constexpr std::uint16_t kVersion = 2;
+
+      static constexpr size_t kHeaderSize = 32;
+      static constexpr size_t kRecordSize = 32;
+
+      /**
+       * \brief Tells whether a file name designates a binary playlist, based on its extension.
+       */
+      static bool isBinaryPlaylist(std::string_view file_name);
+
+      /**
+       * \brief Writes a playlist to a binary playlist file.
+       *
+       * \param file_name The path of the file to write.
+       * \param playlist The playlist to save.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the file could not be written.
+       */
+      static bool save(const std::string& file_name, const Playlist& playlist, std::string& error);
+
+      /**
+       * \brief Appends all entries of a binary playlist file to a playlist.
+       *
+       * The file is validated entirely before any entry is added.
+       *
+       * \param file_name The path of the file to read.
+       * \param playlist The playlist to append the entries to.
+       * \param report Receives statistics about the loading.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the file could not be opened or is not a valid binary playlist.
+       */
+      static bool load(const std::string& file_name, Playlist& playlist, PlaylistLoader::Report& report, std::string& error);
+
+      /**
+       * \brief Builds the contents of a binary playlist file in memory.
+       *
+       * \param image Receives the contents of the file.
+       */
+      static bool encode(const Playlist& playlist, std::string& image, std::string& error);
+
+      /**
+       * \brief Same as load(), from the contents of a binary playlist file.
+       *
+       * \param file_name The name of the file the contents come from, used in the error messages.
+       */
+      static bool decode(std::string_view image, const std::string& file_name, Playlist& playlist, PlaylistLoader::Report& report, std::string& error);
+   };
+
+}
@@ -1,9 +1,9 @@
 #pragma once
 
-#include <algorithm>
+#include <cstddef>
+#include <optional>
 #include <string>
-#include <unordered_map>
-#include <stdexcept>
+#include <string_view>
 
 namespace MusicPlayer {
 
@@ -19,6 +19,7 @@ namespace MusicPlayer {
        * This list was created using this reference page:
        * https://developer.mozilla.org/en-US/docs/Web/Media/Formats/Audio_codecs
        *
+       * New codecs are added at the end, as the values are stored in binary playlists.
        */
       enum class Type {
          AAC,
@@ -29,17 +30,21 @@ namespace MusicPlayer {
          G_722,
          MP3,
          OPUS,
-         VORBIS
+         VORBIS,
+         PCM
       };
 
+      static constexpr size_t kTypeCount = static_cast<size_t>(Type::PCM) + 1;
+
       /**
-       * \brief Returns the name of a codec as a string.
+       * \brief Returns the name of a codec.
        *
        * \param codec The codec type to print.
-       * \return The name of the codec.
+       * \return The name of the codec, or "Unknown" for values outside of the enumeration.
        */
-      static inline std::string getCodecAsString(Codec::Type codec) {
-         return _string_representations.count(codec) ? _string_representations[codec] : "Unknown";
+      static constexpr std::string_view getCodecName(Codec::Type codec) {
+         size_t index = static_cast<size_t>(codec);
+         return index < kTypeCount ? kNames[index] : "Unknown";
       }
 
       /**
@@ -48,27 +53,68 @@ namespace MusicPlayer {
        * \param codec The codec type to print.
        * \return The name of the codec.
        */
-      static inline Codec::Type getCodecTypeFromString(const std::string& source) {
-         auto match = std::find_if(
-            _string_representations.begin(),
-            _string_representations.end(),
-            [&source](const auto& pair)
-            {
-               return pair.second == source;
-            }
-         );
+      static inline std::string getCodecAsString(Codec::Type codec) {
+         return std::string(getCodecName(codec));
+      }
 
-         if (match != _string_representations.end()) {
-            return match->first;
-         }
-         else {
-            throw std::invalid_argument("The codec type " + source + " is not supported");
+      /**
+       * \brief Finds the codec with the given name, ignoring case.
+       *
+       * \param name The name of the codec.
+       * \return The codec type, or nothing if no codec has this name.
+       */
+      static constexpr std::optional<Codec::Type> findCodecType(std::string_view name) {
+         for (size_t index = 0; index < kTypeCount; index++) {
+            if (equalsIgnoringCase(kNames[index], name)) {
+               return static_cast<Type>(index);
+            }
          }
+
+         return std::nullopt;
       }
 
+      /**
+       * \brief Returns the codec with the given name.
+       *
+       * \param source The name of the codec.
+       * \return The codec type.
+       * \throw std::invalid_argument If no codec has this name.
+       */
+      static Codec::Type getCodecTypeFromString(std::string_view source);
+
    private:
 
-      static std::unordered_map<Type, std::string> _string_representations;
+      // indexed by Type
+      static constexpr std::string_view kNames[kTypeCount] = {
+         "AAC",
+         "ALAC",
+         "AMR",
+         "FLAC",
+         "G.711",
+         "G.722",
+         "MP3",
+         "Opus",
+         "Vorbis",
+         "PCM",
+      };
+
+      static constexpr char toLower(char c) {
+         return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+      }
+
+      static constexpr bool equalsIgnoringCase(std::string_view lhs, std::string_view rhs) {
+         if (lhs.size() != rhs.size()) {
+            return false;
+         }
+
+         for (size_t idx = 0; idx < lhs.size(); idx++) {
+            if (toLower(lhs[idx]) != toLower(rhs[idx])) {
+               return false;
+            }
+         }
+
+         return true;
+      }
 
    };
 
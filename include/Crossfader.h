@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Applies the ReplayGain of each stream, and crossfades the end of a stream into the start of the next one.
+    *
+    * The frames are delayed by the length of the crossfade: the last frames of a stream are held in a tail buffer
+    * until the next stream starts, or until the end of the playback. The first frames of the next stream are then
+    * mixed into the tail with equal-power gain curves, approximated by linear segments so that the DSP kernels
+    * apply them. Frames are processed in place: the tail buffer, allocated by configure(), is the only memory of
+    * the stage, and crossfading does not allocate.
+    *
+    * Without crossfade, the stage only applies the gain of each stream.
+    */
+   class Crossfader
+   {
+   public:
+      Crossfader();
+
+      /**
+       * \brief Prepares the stage for a playback, and discards the frames held from the previous one.
+       *
+       * \param fade_frames The length of the crossfades, or 0 to disable them.
+       * \param channels The number of interleaved channels of the frames.
+       */
+      void configure(size_t fade_frames, unsigned channels);
+
+      /**
+       * \brief Starts the next stream. The frames held from the previous stream are crossfaded with its first frames.
+       *
+       * \param gain The linear gain applied to the frames of the stream.
+       */
+      void startStream(float gain);
+
+      /**
+       * \brief Processes a block of frames of the current stream.
+       *
+       * \param samples The interleaved frames, replaced by the output frames.
+       * \param frames The number of frames.
+       * \return The number of output frames at the start of samples. Fewer frames are output than received while the
+       *         tail buffer fills or a crossfade is in progress.
+       */
+      size_t process(float* samples, size_t frames);
+
+      /**
+       * \brief Outputs the frames still held at the end of the playback.
+       *
+       * \param samples Receives a pointer to the interleaved frames, valid until the next call to the stage.
+       * \return The number of frames.
+       */
+      size_t flush(const float*& samples);
+
+      size_t getFadeFrames() const { return fade_frames_; }
+
+   private:
+      // number of frames of each linear segment of the gain curves
+      static constexpr size_t kCurveSegmentFrames = 64;
+
+      void mix_(const float* samples, size_t frames);
+      void fadeOutRemainingTail_();
+
+      size_t fade_frames_;
+      unsigned channels_;
+      float gain_;
+
+      // circular buffer of the last frames received, oldest at tail_start_
+      std::vector<float> tail_;
+      size_t tail_start_;
+      size_t tail_frames_;
+
+      // frames of the tail mixed with the current stream so far, out of crossfade_frames_
+      size_t crossfade_position_;
+      size_t crossfade_frames_;
+   };
+
+}
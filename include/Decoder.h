@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Codec.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Layout of decoded audio: interleaved 32-bit float samples in [-1, 1].
+    */
+   struct AudioFormat
+   {
+      unsigned sample_rate = 0;
+      unsigned channels = 0;
+
+      // bit depth of the source, before conversion to float
+      unsigned bits_per_sample = 0;
+   };
+
+   /**
+    * \brief Decodes an audio file into interleaved float samples.
+    */
+   class Decoder
+   {
+   public:
+      virtual ~Decoder() = default;
+
+      /**
+       * \brief Opens an audio file and reads its format.
+       *
+       * \param file_name The path of the audio file.
+       * \return false if the file could not be opened or is not supported; the reason is available from getErrorMessage().
+       */
+      virtual bool open(const std::string& file_name) = 0;
+
+      /**
+       * \brief Decodes the next frames of the file.
+       *
+       * \param samples Receives frames * channels interleaved samples.
+       * \param frames The maximum number of frames to decode.
+       * \return The number of decoded frames, 0 at the end of the file or on error.
+       */
+      virtual size_t read(float* samples, size_t frames) = 0;
+
+      const AudioFormat& getFormat() const { return format_; }
+
+      // total number of frames in the file, or 0 if unknown
+      std::uint64_t getTotalFrames() const { return total_frames_; }
+
+      bool hasFailed() const { return !error_.empty(); }
+      const std::string& getErrorMessage() const { return error_; }
+
+   protected:
+      AudioFormat format_;
+      std::uint64_t total_frames_ = 0;
+      std::string error_;
+
+      bool fail_(std::string message)
+      {
+         error_ = std::move(message);
+         return false;
+      }
+   };
+
+   /**
+    * \brief Creates the decoders of the codecs that can be played.
+    *
+    * Each codec type is associated to a decoder factory and to the extension of its audio files. The audio of a
+    * track is looked up next to its *.music file, with the same name and the extension of its codec.
+    */
+   class DecoderRegistry
+   {
+   public:
+      using Factory = std::unique_ptr<Decoder> (*)();
+
+      /**
+       * \brief Associates a decoder to a codec, replacing the previous one. Must be called before playback starts.
+       *
+       * \param codec The codec decoded.
+       * \param extension The extension of the audio files of this codec, including the dot. Must be a string literal.
+       * \param factory Creates a decoder for this codec.
+       */
+      static void registerDecoder(Codec::Type codec, std::string_view extension, Factory factory);
+
+      /**
+       * \brief Creates a decoder for a codec.
+       *
+       * \return The decoder, or nullptr if the codec cannot be decoded.
+       */
+      static std::unique_ptr<Decoder> create(Codec::Type codec);
+
+      /**
+       * \brief Returns the path of the audio file of a track.
+       *
+       * \param track_file The path of the *.music file of the track.
+       * \param codec The codec of the track.
+       * \return The audio file path, or an empty string if the codec cannot be decoded.
+       */
+      static std::string audioFileFor(std::string_view track_file, Codec::Type codec);
+
+   private:
+      struct Entry
+      {
+         std::string_view extension;
+         Factory factory = nullptr;
+      };
+
+      static std::array<Entry, Codec::kTypeCount>& entries_();
+   };
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MusicPlayer::Dsp
+{
+
+   /**
+    * \brief The sample processing routines of one instruction set.
+    *
+    * Every implementation produces results bit-identical to the scalar one.
+    */
+   struct Kernels
+   {
+      const char* name;
+
+      /**
+       * \brief Converts little-endian signed integer samples to floats in [-1, 1].
+       *
+       * \param source Packed samples of 2, 3 or 4 bytes, without alignment requirement.
+       * \param destination Receives count samples.
+       * \param count The number of samples.
+       */
+      void (*int16ToFloat)(const void* source, float* destination, size_t count);
+      void (*int24ToFloat)(const void* source, float* destination, size_t count);
+      void (*int32ToFloat)(const void* source, float* destination, size_t count);
+
+      /**
+       * \brief Multiplies interleaved samples by a gain changing linearly from frame to frame.
+       *
+       * The gain of frame n is start_gain + n * gain_step, so that volume changes are ramped over a block
+       * instead of producing a click.
+       */
+      void (*applyGain)(float* samples, size_t frames, unsigned channels, float start_gain, float gain_step);
+
+      /**
+       * \brief Adds interleaved samples, multiplied by a gain changing linearly from frame to frame, to other samples.
+       *
+       * The gain of frame n is start_gain + n * gain_step, as for applyGain(). Used to mix the two streams of a crossfade.
+       */
+      void (*mixGain)(const float* source, float* destination, size_t frames, unsigned channels, float start_gain, float gain_step);
+
+      /**
+       * \brief Mixes interleaved stereo samples down to mono, averaging both channels.
+       */
+      void (*downmixStereo)(const float* source, float* destination, size_t frames);
+   };
+
+   enum class InstructionSet
+   {
+      Scalar,
+      SSE2,
+      AVX2
+   };
+
+   /**
+    * \brief Tells whether the kernels of an instruction set were built and can run on this processor.
+    */
+   bool isSupported(InstructionSet instruction_set);
+
+   /**
+    * \brief Returns the kernels of an instruction set, or nullptr if it is not supported.
+    */
+   const Kernels* kernelsFor(InstructionSet instruction_set);
+
+   /**
+    * \brief Returns the fastest kernels supported by this processor, detected on first use.
+    */
+   const Kernels& kernels();
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Decoder.h"
+#include "MappedFile.h"
+
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Decodes native FLAC files, one frame at a time.
+    *
+    * Supports every subframe type and channel decorrelation mode of the format, for sample sizes up to 24 bits.
+    * Seeking and the MD5 check of the decoded audio are not supported.
+    */
+   class FlacDecoder : public Decoder
+   {
+   public:
+      bool open(const std::string& file_name) override;
+      size_t read(float* samples, size_t frames) override;
+
+   private:
+      bool decodeFrame_();
+
+      MappedFile file_;
+
+      // offset of the next frame in the file
+      size_t next_frame_offset_ = 0;
+      std::uint64_t decoded_frames_ = 0;
+
+      // samples of the current frame, one block of block_capacity_ samples per channel
+      std::vector<std::int32_t> block_;
+      size_t block_capacity_ = 0;
+      size_t block_frames_ = 0;
+      size_t block_position_ = 0;
+
+      float scale_ = 0.0f;
+   };
+
+}
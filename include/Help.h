@@ -1,10 +1,11 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace MusicPlayer {
     class HelpMessages {
     public:
-        static std::string forInstruction(const std::string& instruction);
+        static std::string forInstruction(std::string_view instruction);
     };
 }
\ No newline at end of file
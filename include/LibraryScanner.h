@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Playlist.h"
+
+#include <string>
+#include <string_view>
+
+namespace MusicPlayer
+{
+   class ThreadPool;
+
+   /**
+    * \brief Appends the track files of a directory tree to a playlist.
+    *
+    * The tree is listed one depth level at a time, the directories of a level being listed concurrently on a thread
+    * pool. The track files found are then read and parsed in batches on the pool, and appended on the calling thread
+    * in a deterministic order: the files of a directory sorted by name, then the files of each of its subdirectories,
+    * in name order. Symbolic links to directories are not followed.
+    *
+    * When the shared metadata cache is open, the files it knows unchanged are not read, and the others are stored
+    * in it.
+    */
+   class LibraryScanner
+   {
+   public:
+      static constexpr std::string_view kTrackExtension = ".music";
+
+      struct ErrorCategory
+      {
+         size_t count = 0;
+         std::string first_error;
+      };
+
+      struct Report
+      {
+         size_t directory_count = 0;
+         size_t file_count = 0;
+         size_t added_count = 0;
+
+         // tracks found in the metadata cache
+         size_t cached_count = 0;
+
+         ErrorCategory unlisted_directories;
+         ErrorCategory unreadable_files;
+         ErrorCategory malformed_files;
+         ErrorCategory cache_writes;
+
+         double seconds = 0.0;
+      };
+
+      /**
+       * \brief Appends the tracks of the *.music files of a directory to a playlist, using the shared thread pool.
+       *
+       * Files and directories that cannot be read are skipped and counted in the report.
+       *
+       * \param directory The path of the directory.
+       * \param recursive Whether the subdirectories are scanned too.
+       * \param playlist The playlist to append the tracks to.
+       * \param report Receives statistics about the scan.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the path is not a directory.
+       */
+      static bool scan(const std::string& directory, bool recursive, Playlist& playlist, Report& report, std::string& error);
+
+      /**
+       * \brief Same as scan(), listing and reading the files on the given pool.
+       */
+      static bool scan(const std::string& directory, bool recursive, Playlist& playlist, Report& report, std::string& error, ThreadPool& pool);
+   };
+
+}
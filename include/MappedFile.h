@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Read-only memory mapping of a whole file.
+    *
+    * The contents stay mapped for the lifetime of the object and can be parsed in place through view().
+    */
+   class MappedFile
+   {
+   public:
+      MappedFile();
+      explicit MappedFile(const std::string& file_name);
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      MappedFile(MappedFile&& other) noexcept;
+      MappedFile& operator=(MappedFile&& other) noexcept;
+
+      /**
+       * \brief Maps a file, releasing the previously mapped one if any.
+       *
+       * \param file_name The path of the file to map.
+       * \return false if the file could not be opened or mapped.
+       */
+      bool open(const std::string& file_name);
+      void close();
+
+      bool isOpen() const { return is_open_; }
+      const char* data() const { return data_; }
+      size_t size() const { return size_; }
+      std::string_view view() const { return std::string_view(data_, size_); }
+
+   private:
+      const char* data_;
+      size_t size_;
+      bool is_open_;
+
+#ifdef _WIN32
+      void* file_handle_;
+      void* mapping_handle_;
+#endif
+   };
+
+}
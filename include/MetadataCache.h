@@ -0,0 +1,176 @@
+#pragma once
+
+#include "StringPool.h"
+#include "Track.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Persistent cache of the parsed track files, keyed by their path, size and modification time.
+    *
+    * A track file whose size and modification time did not change since it was cached is not opened nor parsed
+    * again. The cache is an append-only log file, indexed in memory by a hash table loaded when the file is opened:
+    * the last record of a path wins.
+    *
+    * Layout (all integers little-endian): an 8-byte header, "IPMC" magic then the format version; then one record
+    * per stored track: payload size, FNV-1a checksum of the payload, then the payload: file size, modification
+    * time in nanoseconds, duration, codec type, ReplayGain flag, path and title lengths, ReplayGain gain and peak
+    * as 32-bit floats, then the path and the title.
+    *
+    * Writes are crash-safe: a record cut by a crash fails its checksum, and the log is truncated after the last
+    * valid record when it is opened. Appended records are not synced to the disk, losing them only costs a parse.
+    * When the log holds more than twice as many records as live entries, it is compacted into a new file that
+    * replaces it atomically.
+    *
+    * All methods are thread-safe.
+    */
+   class MetadataCache
+   {
+   public:
+      static constexpr std::uint16_t kVersion = 2;
+      static constexpr size_t kHeaderSize = 8;
+
+      // logs shorter than this are never compacted automatically
+      static constexpr size_t kCompactionMinRecords = 1024;
+
+      struct FileStamp
+      {
+         std::uint64_t size = 0;
+         std::int64_t modified_ns = 0;
+
+         bool operator==(const FileStamp& other) const { return size == other.size && modified_ns == other.modified_ns; }
+         bool operator!=(const FileStamp& other) const { return !(*this == other); }
+      };
+
+      struct Statistics
+      {
+         size_t entry_count = 0;
+         size_t record_count = 0;
+
+         std::uint64_t hits = 0;
+         std::uint64_t misses = 0;
+
+         // misses on a path cached with another size or modification time
+         std::uint64_t stale = 0;
+
+         size_t compactions = 0;
+
+         // bytes of an interrupted write discarded when the log was opened
+         size_t recovered_bytes = 0;
+      };
+
+      MetadataCache();
+
+      /**
+       * \brief Writes the pending records and closes the log.
+       */
+      ~MetadataCache();
+
+      MetadataCache(const MetadataCache&) = delete;
+      MetadataCache& operator=(const MetadataCache&) = delete;
+
+      /**
+       * \brief Opens a cache log, creating it if needed, and loads its index. Closes the previous log.
+       *
+       * \param file_name The path of the log.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the file could not be opened or is not a metadata cache.
+       */
+      bool open(const std::string& file_name, std::string& error);
+
+      /**
+       * \brief Writes the pending records and closes the log. Lookups miss until another log is opened.
+       */
+      void close();
+
+      bool isOpen() const;
+      std::string getFileName() const;
+
+      /**
+       * \brief Reads the size and the modification time of a file.
+       *
+       * \return false if the file does not exist or cannot be accessed.
+       */
+      static bool getFileStamp(const std::string& file_name, FileStamp& stamp);
+
+      /**
+       * \brief Finds the track cached for a file, and counts a hit or a miss.
+       *
+       * \param track_file The path of the track file, relative to the current directory or absolute.
+       * \param stamp The current stamp of the file.
+       * \param track Receives the cached track.
+       * \return false if the file is not cached with this stamp, or if no log is open.
+       */
+      bool lookup(std::string_view track_file, const FileStamp& stamp, Track& track);
+
+      /**
+       * \brief Caches the track parsed from a file. The record is written by the next flush().
+       */
+      void store(std::string_view track_file, const FileStamp& stamp, const Track& track);
+
+      /**
+       * \brief Appends the pending records to the log, then compacts it if it holds too many replaced records.
+       *
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the log could not be written.
+       */
+      bool flush(std::string& error);
+
+      /**
+       * \brief Rewrites the log with one record per live entry, replacing the file atomically.
+       */
+      bool compact(std::string& error);
+
+      Statistics getStatistics() const;
+
+      /**
+       * \brief Returns the location of the cache in the user cache directory.
+       */
+      static std::string getDefaultFileName();
+
+      /**
+       * \brief Returns the cache shared by all shells of the process, closed until opened.
+       */
+      static MetadataCache& shared();
+
+   private:
+      struct Entry
+      {
+         FileStamp stamp;
+         Track track;
+      };
+
+      static InternedString keyFor_(std::string_view track_file);
+
+      void closeLocked_();
+      bool flushLocked_(std::string& error);
+      bool compactLocked_(std::string& error);
+
+      mutable std::shared_mutex mutex_;
+
+      std::string file_name_;
+      std::FILE* log_;
+
+      std::unordered_map<InternedString, Entry> entries_;
+
+      // records stored since the last flush, encoded
+      std::string pending_;
+      size_t record_count_;
+
+      std::atomic<std::uint64_t> hits_;
+      std::atomic<std::uint64_t> misses_;
+      std::atomic<std::uint64_t> stale_;
+      size_t compactions_;
+      size_t recovered_bytes_;
+   };
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Playlist.h"
+
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief The tracks queued to play next, ahead of the playlist order.
+    *
+    * A ring buffer of entry handles: queuing at either end and taking the next track cost constant time, and the
+    * playlist itself is left untouched. Removed entries stay queued until they are met, then are discarded.
+    */
+   class PlayQueue
+   {
+   public:
+      PlayQueue();
+
+      bool empty() const { return size_ == 0; }
+      size_t size() const { return size_; }
+
+      Playlist::Handle operator[](size_t index) const { return slots_[(head_ + index) & (slots_.size() - 1)]; }
+
+      /**
+       * \brief Queues an entry after the queued ones.
+       */
+      void pushBack(Playlist::Handle handle);
+
+      /**
+       * \brief Queues an entry before the queued ones.
+       */
+      void pushFront(Playlist::Handle handle);
+
+      /**
+       * \brief Returns the next queued entry still in the playlist, after discarding the removed ones before it.
+       *
+       * \return The handle of the entry, or kInvalidHandle if the queue is empty.
+       */
+      Playlist::Handle front(const Playlist& playlist);
+
+      void popFront();
+
+      /**
+       * \brief Removes the entry at an index of the queue. Linear in the size of the queue.
+       */
+      void erase(size_t index);
+
+      /**
+       * \brief Discards the entries removed from the playlist. Linear in the size of the queue.
+       */
+      void prune(const Playlist& playlist);
+
+      void clear();
+
+   private:
+      void grow_();
+      size_t slot_(size_t index) const { return (head_ + index) & (slots_.size() - 1); }
+
+      // the capacity is a power of two, so that indices wrap with a mask
+      std::vector<Playlist::Handle> slots_;
+      size_t head_;
+      size_t size_;
+   };
+
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "AudioSink.h"
+#include "Crossfader.h"
+#include "Decoder.h"
+#include "Resampler.h"
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Plays a decoded stream to an audio sink.
+    *
+    * A producer decodes the stream into a lock-free ring buffer, which a consumer thread drains to the sink in
+    * blocks of a fixed number of frames. All buffers are allocated when the playback starts: the consumer never
+    * allocates memory.
+    *
+    * The consumer thread stands for the callback thread of an audio device. The producer is not a thread: it runs
+    * as a realtime job of the shared thread pool, which decodes until the ring buffer is full. The consumer
+    * schedules it again whenever half of the ring buffer is free, so that the decoding of all playbacks shares the
+    * workers of the pool.
+    *
+    * Streams can be resampled to a fixed output rate by the producer, before the ring buffer. The producer then
+    * applies the ReplayGain of each stream, and crossfades consecutive streams when a crossfade length is set.
+    *
+    * The volume and the optional stereo downmix are applied to each block by the DSP kernels, just before
+    * the sink. When the ring buffer does not hold a full block in time, a realtime sink receives silence instead and an
+    * underrun is counted. The latency reported is the time between the decoding of a frame and its output.
+    *
+    * When the stream ends, the producer asks the next stream provider for a stream of the same format and
+    * continues with it without interrupting the output, for gapless transitions between tracks.
+    */
+   class PlaybackEngine
+   {
+   public:
+      struct Statistics
+      {
+         std::uint64_t frames_played = 0;
+         std::uint64_t underruns = 0;
+         double average_latency_ms = 0.0;
+         double max_latency_ms = 0.0;
+
+         // time spent resampling the current stream, in percent of its duration
+         double resampler_cpu_percent = 0.0;
+      };
+
+      /**
+       * \brief A stream to play, with the gain normalizing its loudness.
+       */
+      struct Stream
+      {
+         std::unique_ptr<Decoder> decoder;
+         float gain = 1.0f;
+      };
+
+      /**
+       * \brief Returns the stream to play after the current one, in the given format, or no decoder to end the playback.
+       *
+       * A sample rate of 0 in the format accepts any rate.
+       *
+       * Called from the producer, on a worker of the shared thread pool.
+       */
+      using StreamProvider = std::function<Stream(const AudioFormat&)>;
+
+      static constexpr size_t kDefaultBlockFrames = 1024;
+      static constexpr size_t kDefaultBufferFrames = 16384;
+
+      /**
+       * \param block_frames The number of frames written to the sink at once.
+       * \param buffer_frames The number of frames the ring buffer holds.
+       */
+      explicit PlaybackEngine(size_t block_frames = kDefaultBlockFrames, size_t buffer_frames = kDefaultBufferFrames);
+      ~PlaybackEngine();
+
+      PlaybackEngine(const PlaybackEngine&) = delete;
+      PlaybackEngine& operator=(const PlaybackEngine&) = delete;
+
+      /**
+       * \brief Replaces the output. Stops the playback in progress.
+       */
+      void setSink(std::unique_ptr<AudioSink> sink);
+      AudioSink& getSink() const { return *sink_; }
+
+      /**
+       * \brief Sets the provider of the streams following the current one. Stops the playback in progress.
+       */
+      void setNextStreamProvider(StreamProvider provider);
+
+      /**
+       * \brief Stops the playback in progress, then starts playing a stream.
+       *
+       * \param stream The opened decoder of the stream, positioned at its start, and its gain.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the sink could not be opened for this stream.
+       */
+      bool start(Stream stream, std::string& error);
+
+      /**
+       * \brief Sets whether stereo streams are mixed down to mono. Stops the playback in progress.
+       */
+      void setDownmix(bool downmix);
+      bool getDownmix() const { return downmix_; }
+
+      /**
+       * \brief Sets the sample rate of the output. Stops the playback in progress.
+       *
+       * \param output_rate The rate streams are resampled to, or 0 to output them at their own rate.
+       * \param quality The resampling quality.
+       */
+      void setOutputRate(unsigned output_rate, Resampler::Quality quality);
+      unsigned getOutputRate() const { return output_rate_; }
+      Resampler::Quality getResamplerQuality() const { return resampler_quality_; }
+
+      /**
+       * \brief Sets the length of the crossfades between consecutive streams, 0 to disable them. Stops the playback in progress.
+       *
+       * The first stream started by start() begins without fading in.
+       */
+      void setCrossfade(std::chrono::milliseconds duration);
+      std::chrono::milliseconds getCrossfade() const { return crossfade_; }
+
+      /**
+       * \brief Sets the gain applied to the samples, ramped over one block. Can be called during the playback.
+       */
+      void setVolume(float volume);
+      float getVolume() const { return target_gain_.load(std::memory_order_relaxed); }
+
+      void pause();
+      void resume();
+
+      /**
+       * \brief Stops the playback and waits for the consumer thread and the producer job to end.
+       */
+      void stop();
+
+      // true from start() until the stream was entirely played or stopped, including while paused
+      bool isActive() const { return consumer_.joinable() && !finished_.load(std::memory_order_acquire); }
+      bool isPaused() const { return paused_.load(std::memory_order_relaxed); }
+
+      /**
+       * \brief Waits until the stream was entirely played.
+       */
+      void waitUntilFinished();
+
+      /**
+       * \brief Returns the number of gapless transitions to a following stream whose first frame was output.
+       */
+      size_t getTransitionCount() const { return transitions_.load(std::memory_order_acquire); }
+
+      /**
+       * \brief Returns the statistics of the current stream, or of the last one.
+       */
+      Statistics getStatistics() const;
+
+      /**
+       * \brief Returns the decoding error that ended the last stream, if any. Valid once the stream is finished.
+       */
+      const std::string& getErrorMessage() const { return decode_error_; }
+
+   private:
+      using Clock = std::chrono::steady_clock;
+
+      // decoding time of the frames before end_frame
+      struct LatencyMarker
+      {
+         std::uint64_t end_frame;
+         Clock::time_point decoded_at;
+      };
+
+      void scheduleProducer_();
+      void waitForProducer_();
+      void produce_();
+      bool startNextStream_();
+      void consume_();
+      void output_(size_t frames);
+      void mix_(float* samples, size_t frames);
+      void stage_(const float* samples, size_t frames);
+      bool push_();
+      size_t resample_(const float* samples, size_t frames);
+      void configureResampler_();
+
+      const size_t block_frames_;
+      const size_t buffer_frames_;
+
+      std::unique_ptr<AudioSink> sink_;
+      std::unique_ptr<Decoder> decoder_;
+      StreamProvider next_stream_provider_;
+      unsigned channels_;
+
+      std::unique_ptr<RingBuffer<float>> samples_;
+      RingBuffer<LatencyMarker> markers_;
+
+      // first frame of each following stream
+      RingBuffer<std::uint64_t> stream_starts_;
+      std::atomic<size_t> transitions_;
+
+      std::vector<float> decode_block_;
+      std::vector<float> output_block_;
+      std::vector<float> downmix_block_;
+
+      bool downmix_;
+      bool downmix_active_;
+
+      unsigned output_rate_;
+      Resampler::Quality resampler_quality_;
+
+      // used by the producer only
+      Resampler resampler_;
+      bool resampling_;
+      bool resampler_flushed_;
+      std::vector<float> resample_block_;
+
+      std::atomic<std::int64_t> resample_ns_;
+      std::atomic<std::uint64_t> resampled_frames_;
+
+      std::chrono::milliseconds crossfade_;
+
+      // used by the producer only
+      Crossfader crossfader_;
+
+      // state of the producer, kept from one run of its job to the next
+      std::uint64_t frames_decoded_;
+      const float* staged_samples_;
+      size_t staged_sample_count_;
+      size_t staged_frames_;
+      bool stream_start_pending_;
+      bool draining_;
+
+      std::atomic<float> target_gain_;
+      // gain reached at the end of the last block, used by the consumer only
+      float gain_;
+
+      std::thread consumer_;
+
+      // true from the scheduling of a producer job to its end
+      std::atomic<bool> producer_scheduled_;
+
+      std::atomic<bool> stop_requested_;
+      std::atomic<bool> paused_;
+      std::atomic<bool> producer_done_;
+      std::atomic<bool> finished_;
+      std::string decode_error_;
+
+      // written by the consumer only
+      std::atomic<std::uint64_t> frames_played_;
+      std::atomic<std::uint64_t> underruns_;
+      std::atomic<std::uint64_t> latency_count_;
+      std::atomic<std::int64_t> latency_total_us_;
+      std::atomic<std::int64_t> latency_max_us_;
+   };
+
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "StringPool.h"
+#include "Track.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace MusicPlayer
+{
+   class PlaylistJournal;
+
+   /**
+    * \brief An ordered list of tracks with constant-time positional access.
+    *
+    * Entries are stored contiguously in playlist order. Every entry also receives a handle when it is added:
+    * the handle keeps referring to the same entry while other entries are added or removed around it, and
+    * can be turned back into a position in constant time.
+    *
+    * The playlist also keeps track of the currently selected entry, so that removals can move the selection
+    * to the next remaining entry.
+    *
+    * Track file names are interned in the shared string pool: entries imported from the same file share the
+    * same name, and comparing file names is a pointer comparison. An index from file name to entries is
+    * maintained, so that looking up the entries of a file costs time proportional to the number of matches.
+    *
+    * Changes to the entries can be recorded in a PlaylistJournal, so that saving them only writes what changed.
+    */
+   class Playlist
+   {
+   public:
+      using Handle = std::uint32_t;
+
+      static constexpr Handle kInvalidHandle = std::numeric_limits<Handle>::max();
+      static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+      struct Entry
+      {
+         Handle handle;
+         InternedString path;
+         Track track;
+      };
+
+      // consecutive positions
+      struct Range
+      {
+         size_t first;
+         size_t count;
+      };
+
+      using const_iterator = std::vector<Entry>::const_iterator;
+
+      Playlist();
+
+      size_t size() const { return entries_.size(); }
+      bool empty() const { return entries_.empty(); }
+
+      const Entry& operator[](size_t position) const { return entries_[position]; }
+      const_iterator begin() const { return entries_.begin(); }
+      const_iterator end() const { return entries_.end(); }
+
+      /**
+       * \brief Reserves storage for at least the given number of entries.
+       */
+      void reserve(size_t capacity);
+
+      /**
+       * \brief Adds a track at the end of the playlist.
+       *
+       * \param path The file the track was imported from.
+       * \param track The track metadata.
+       * \return The handle of the new entry.
+       */
+      Handle append(InternedString path, Track track);
+      Handle append(std::string_view path, Track track);
+
+      /**
+       * \brief Returns the current position of an entry, or npos if it was removed.
+       */
+      size_t positionOf(Handle handle) const;
+
+      /**
+       * \brief Returns the number of handles given so far: handles are given in increasing order and never reused.
+       */
+      Handle handleCount() const { return static_cast<Handle>(positions_.size()); }
+
+      /**
+       * \brief Returns the positions of all entries imported from a file, in no particular order.
+       */
+      std::vector<size_t> positionsOf(InternedString path) const;
+
+      /**
+       * \brief Returns the number of entries imported from a file.
+       */
+      size_t countOf(InternedString path) const;
+
+      /**
+       * \brief Removes the entry at the given position.
+       *
+       * \return The position of the entry that followed the removed one.
+       */
+      size_t erase(size_t position);
+
+      /**
+       * \brief Removes every entry matching a predicate, in a single pass over the playlist.
+       *
+       * \param predicate Called with the position and the entry, returns true if the entry must be removed.
+       * \return The number of removed entries.
+       */
+      template <typename Predicate>
+      size_t removeIf(Predicate predicate);
+
+      /**
+       * \brief Removes the entries of ranges of positions, in a single pass from the first removed position.
+       *
+       * \param ranges The ranges, in any order; overlapping ranges are merged and the positions past the end ignored.
+       * \return The number of removed entries.
+       */
+      size_t removeRanges(std::vector<Range> ranges);
+
+      /**
+       * \brief Removes every entry outside of ranges of positions.
+       *
+       * \return The number of removed entries.
+       */
+      size_t keepRanges(std::vector<Range> ranges);
+
+      /**
+       * \brief Removes the entries imported from a file that was already imported by a previous entry.
+       *
+       * \return The number of removed entries.
+       */
+      size_t removeDuplicates();
+
+      /**
+       * \brief Moves a range of entries, keeping their order.
+       *
+       * \param range The entries to move.
+       * \param target The position of the first moved entry once they are moved.
+       * \return false if the range or the target is out of the playlist.
+       */
+      bool move(Range range, size_t target);
+
+      /**
+       * \brief Removes all entries.
+       */
+      void clear();
+
+      /**
+       * \brief Records the next changes to the entries in a journal, or stops recording them if nullptr.
+       */
+      void setJournal(PlaylistJournal* journal) { journal_ = journal; }
+
+      /**
+       * \brief Returns the first position whose entry changed since the previous call, or npos if none did.
+       *
+       * Used to rebuild only the changed part of a snapshot of the playlist; there can be a single such user.
+       */
+      size_t takeFirstChanged();
+
+      // Selection
+      bool hasCurrent() const { return current_ != npos; }
+      size_t currentPosition() const { return current_; }
+      const Entry& current() const { return entries_[current_]; }
+      void setCurrentPosition(size_t position) { current_ = position < entries_.size() ? position : npos; }
+
+   private:
+      void unindex_(const Entry& entry);
+      void pruneIndex_(const std::vector<InternedString>& paths);
+
+      bool isJournaled_() const;
+      void journalRemoved_(const std::vector<Range>& ranges);
+
+      void changedFrom_(size_t position) { first_changed_ = std::min(first_changed_, position); }
+
+      std::vector<Entry> entries_;
+
+      // position of each entry, indexed by handle (npos for removed entries)
+      std::vector<size_t> positions_;
+
+      // handles of the entries imported from each file
+      std::unordered_map<InternedString, std::vector<Handle>> handles_by_path_;
+
+      size_t current_;
+
+      PlaylistJournal* journal_;
+
+      // first position changed since the last call to takeFirstChanged()
+      size_t first_changed_;
+   };
+
+   template <typename Predicate>
+   size_t Playlist::removeIf(Predicate predicate)
+   {
+      size_t kept(0);
+      bool current_was_removed(false);
+      std::vector<InternedString> removed_paths;
+
+      bool journaled = isJournaled_();
+      std::vector<Range> removed_ranges;
+      size_t first_removed(npos);
+
+      for (size_t position = 0; position < entries_.size(); position++)
+      {
+         Entry& entry = entries_[position];
+
+         if (predicate(position, static_cast<const Entry&>(entry)))
+         {
+            if (journaled && !removed_ranges.empty() && removed_ranges.back().first + removed_ranges.back().count == position)
+               removed_ranges.back().count++;
+            else if (journaled)
+               removed_ranges.push_back({ position, 1 });
+
+            positions_[entry.handle] = npos;
+            removed_paths.push_back(entry.path);
+            first_removed = std::min(first_removed, position);
+            if (position == current_)
+               current_was_removed = true;
+            continue;
+         }
+
+         if (position == current_ || (current_was_removed && position > current_))
+         {
+            // the selection follows the entry, or moves to the first entry kept after the removed one
+            current_ = kept;
+            current_was_removed = false;
+         }
+
+         if (kept != position)
+            entries_[kept] = std::move(entry);
+
+         positions_[entries_[kept].handle] = kept;
+         kept++;
+      }
+
+      if (current_was_removed)
+         current_ = npos;
+
+      size_t removed = entries_.size() - kept;
+      if (removed > 0)
+         changedFrom_(first_removed);
+      entries_.erase(entries_.begin() + kept, entries_.end());
+
+      pruneIndex_(removed_paths);
+
+      if (!removed_ranges.empty())
+         journalRemoved_(removed_ranges);
+
+      return removed;
+   }
+
+}
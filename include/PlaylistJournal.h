@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Playlist.h"
+#include "PlaylistLoader.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Reads and writes playlists in the journaled *.iplj format, where saving only appends what changed.
+    *
+    * Layout (all integers little-endian):
+    * - a 16-byte header: "IPLJ" magic, format version, then the size of the snapshot;
+    * - the snapshot: the playlist as it was when the file was last rewritten, as a complete binary playlist;
+    * - the journal: one record per change made since, each made of the size of its payload, the FNV-1a checksum
+    *   of the payload, then the payload: an operation code followed by its operands.
+    *
+    * The journal attached to a playlist records its changes once the playlist was loaded from or saved to a
+    * journaled file. Saving to that file again appends the pending records, and the file is rewritten with a new
+    * snapshot when the journal would grow larger than kCompactionMinSize and than the snapshot. Loading replays
+    * the journal over the snapshot; a record cut by an interrupted save ends the journal.
+    */
+   class PlaylistJournal
+   {
+   public:
+      static constexpr char kExtension[] = ".iplj";
+      static constexpr std::uint16_t kVersion = 1;
+
+      static constexpr size_t kHeaderSize = 16;
+
+      // journals smaller than this are never compacted
+      static constexpr size_t kCompactionMinSize = 64 * 1024;
+
+      struct SaveReport
+      {
+         size_t written_bytes = 0;
+         size_t record_count = 0;
+         bool compacted = false;
+      };
+
+      PlaylistJournal();
+
+      /**
+       * \brief Tells whether a file name designates a journaled playlist, based on its extension.
+       */
+      static bool isJournaledPlaylist(std::string_view file_name);
+
+      /**
+       * \brief Writes the changes recorded since the playlist was last loaded from or saved to the file, or the
+       * whole playlist if the changes were not recorded against this file.
+       *
+       * \param file_name The path of the file to write.
+       * \param playlist The playlist to save, whose changes are recorded by this journal.
+       * \param report Receives what was written.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the file could not be written.
+       */
+      bool save(const std::string& file_name, const Playlist& playlist, SaveReport& report, std::string& error);
+
+      /**
+       * \brief Appends all entries of a journaled playlist file to a playlist.
+       *
+       * The snapshot and the journal are replayed entirely before any entry is added. If the playlist was empty,
+       * its next changes are recorded against the file.
+       *
+       * \param file_name The path of the file to read.
+       * \param playlist The playlist to append the entries to, whose changes are recorded by this journal.
+       * \param report Receives statistics about the loading.
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the file could not be opened or is not a valid journaled playlist.
+       */
+      bool load(const std::string& file_name, Playlist& playlist, PlaylistLoader::Report& report, std::string& error);
+
+      /**
+       * \brief Tells whether changes are currently recorded, so that the playlist can skip describing them.
+       */
+      bool isRecording() const { return !file_name_.empty() && !overflowed_; }
+
+      // Changes, recorded by the playlist
+      void recordAppend(const Playlist::Entry& entry);
+      void recordRemove(const std::vector<Playlist::Range>& ranges);
+      void recordRemoveDuplicates();
+      void recordMove(Playlist::Range range, size_t target);
+      void recordClear();
+
+   private:
+      void addRecord_(const std::string& payload);
+      void detach_();
+
+      bool rewrite_(const std::string& file_name, const Playlist& playlist, SaveReport& report, std::string& error);
+
+      // absolute path of the file the changes are recorded against, empty if none
+      std::string file_name_;
+
+      // size of the file when it was last read or written, the next records being appended there
+      std::uintmax_t file_size_;
+      size_t snapshot_size_;
+      size_t journal_size_;
+
+      // records not saved yet
+      std::string pending_;
+      size_t pending_count_;
+
+      // set when the pending records grew too large: the next save rewrites the file
+      bool overflowed_;
+   };
+
+}
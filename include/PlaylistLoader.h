@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Playlist.h"
+
+#include <string>
+#include <string_view>
+
+namespace MusicPlayer
+{
+   class ThreadPool;
+
+   /**
+    * \brief Reads *.playlist files into a playlist.
+    *
+    * The file is memory-mapped and parsed in place: file names and titles are interned directly from the
+    * mapped text, so a line only allocates if it introduces a new file name or title. Large files are cut in chunks at line
+    * boundaries and parsed on a thread pool, then merged back in file order.
+    */
+   class PlaylistLoader
+   {
+   public:
+      // files at least this large are parsed in parallel
+      static constexpr size_t kParallelThreshold = 4 * 1024 * 1024;
+
+      struct Report
+      {
+         size_t line_count = 0;
+         size_t loaded_count = 0;
+         size_t malformed_count = 0;
+
+         // line number (starting at 1) and reason of the first line that was not imported
+         size_t first_malformed_line = 0;
+         std::string first_error;
+
+         double seconds = 0.0;
+         size_t chunk_count = 0;
+      };
+
+      /**
+       * \brief Appends all tracks of a playlist file to a playlist.
+       *
+       * Malformed lines are skipped and counted in the report.
+       *
+       * \param file_name The path of the *.playlist file.
+       * \param playlist The playlist to append the tracks to.
+       * \param report Receives statistics about the loading.
+       * \return false if the file could not be opened.
+       */
+      static bool load(const std::string& file_name, Playlist& playlist, Report& report);
+
+      /**
+       * \brief Appends all tracks of a playlist file to a playlist, parsing large files on the given pool.
+       */
+      static bool load(const std::string& file_name, Playlist& playlist, Report& report, ThreadPool& pool);
+
+      /**
+       * \brief Appends all tracks described in the contents of a playlist file to a playlist.
+       *
+       * \param contents The text of the playlist, one "<file>||<title>;<mm:ss>;<codec>" record per line.
+       * \param playlist The playlist to append the tracks to.
+       * \param report Receives statistics about the parsing.
+       */
+      static void parse(std::string_view contents, Playlist& playlist, Report& report);
+
+      /**
+       * \brief Same as parse(), but cuts the contents in chunks that are parsed concurrently.
+       *
+       * \param pool The thread pool running the chunk parsers.
+       * \param chunk_count The number of chunks to cut the contents in, or 0 to pick one from the pool size.
+       */
+      static void parseParallel(std::string_view contents, Playlist& playlist, Report& report, ThreadPool& pool, size_t chunk_count = 0);
+
+      /**
+       * \brief Parses one line of a playlist file.
+       *
+       * \param line The line, without its line break.
+       * \param track_file Receives the file name part of the record.
+       * \param track Receives the track metadata.
+       * \param error Receives the reason why the line is malformed, if it is.
+       * \return false if the line is malformed.
+       */
+      static bool parseLine(std::string_view line, std::string_view& track_file, Track& track, std::string& error);
+   };
+
+}
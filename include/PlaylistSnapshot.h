@@ -0,0 +1,172 @@
+#pragma once
+
+#include "Playlist.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief An immutable copy of a playlist and of its playback state, readable from any thread.
+    *
+    * The entries are stored in chunks, themselves grouped in blocks, shared with the previous snapshot: publishing
+    * a snapshot only copies the chunks from the first changed position on, and the blocks holding them. Appending a
+    * track to a large playlist copies a chunk and a block, and moving the selection copies nothing.
+    */
+   class PlaylistSnapshot
+   {
+   public:
+      // entries per chunk, and chunks per block
+      static constexpr size_t kChunkSize = 256;
+      static constexpr size_t kBlockSize = 256;
+
+      using Chunk = std::vector<Playlist::Entry>;
+      using Block = std::vector<std::shared_ptr<const Chunk>>;
+
+      size_t size() const { return size_; }
+      bool empty() const { return size_ == 0; }
+
+      const Playlist::Entry& operator[](size_t position) const
+      {
+         const Block& block = *(*blocks_)[position / (kChunkSize * kBlockSize)];
+         return (*block[position / kChunkSize % kBlockSize])[position % kChunkSize];
+      }
+
+      bool hasCurrent() const { return current_ != Playlist::npos; }
+      size_t currentPosition() const { return current_; }
+      const Playlist::Entry& current() const { return (*this)[current_]; }
+
+      bool isPlaying() const { return is_playing_; }
+      bool isRandom() const { return random_mode_; }
+      bool isRepeating() const { return repeat_mode_; }
+
+      // incremented by every published snapshot
+      std::uint64_t getVersion() const { return version_; }
+
+   private:
+      friend class PlaylistSnapshots;
+
+      PlaylistSnapshot();
+
+      using BlockList = std::vector<std::shared_ptr<const Block>>;
+
+      // shared as a whole with the previous snapshot when only the playback state changed
+      std::shared_ptr<const BlockList> blocks_;
+      size_t size_;
+
+      size_t current_;
+      bool is_playing_;
+      bool random_mode_;
+      bool repeat_mode_;
+
+      std::uint64_t version_;
+   };
+
+   /**
+    * \brief Publishes the snapshots of a playlist to concurrent readers with epoch-based reclamation.
+    *
+    * A single writer publishes new snapshots. Readers pin the latest one without locking nor waiting: they
+    * announce the current epoch in their slot, then load the snapshot pointer. A replaced snapshot is retired
+    * with the epoch of its replacement and deleted once no reader announced an epoch up to that one.
+    *
+    * Registering and unregistering readers takes a mutex, acquiring and releasing snapshots does not.
+    */
+   class PlaylistSnapshots
+   {
+   public:
+      /**
+       * \brief A registered reader, used by a single thread.
+       */
+      class Reader
+      {
+      public:
+         explicit Reader(PlaylistSnapshots& snapshots);
+         ~Reader();
+
+         Reader(const Reader&) = delete;
+         Reader& operator=(const Reader&) = delete;
+
+         /**
+          * \brief Pins the latest snapshot until release(). Wait-free.
+          *
+          * A reader pins one snapshot at a time: acquiring again releases the previous one.
+          */
+         const PlaylistSnapshot& acquire();
+
+         /**
+          * \brief Unpins the snapshot, which must not be accessed anymore.
+          */
+         void release();
+
+      private:
+         friend class PlaylistSnapshots;
+
+         static constexpr std::uint64_t kIdle = UINT64_MAX;
+
+         PlaylistSnapshots& snapshots_;
+
+         // the epoch announced by the reader, alone on its cache line so that readers do not slow each other down
+         struct alignas(64) Slot
+         {
+            std::atomic<std::uint64_t> epoch{ kIdle };
+         };
+
+         std::unique_ptr<Slot> slot_;
+      };
+
+      struct Statistics
+      {
+         std::uint64_t published = 0;
+         std::uint64_t reused_chunks = 0;
+         std::uint64_t copied_chunks = 0;
+
+         // replaced snapshots still pinned by a reader
+         size_t retired = 0;
+      };
+
+      /**
+       * \brief Publishes an empty snapshot.
+       */
+      PlaylistSnapshots();
+
+      /**
+       * \brief Deletes the snapshots. The readers must have been destroyed.
+       */
+      ~PlaylistSnapshots();
+
+      PlaylistSnapshots(const PlaylistSnapshots&) = delete;
+      PlaylistSnapshots& operator=(const PlaylistSnapshots&) = delete;
+
+      /**
+       * \brief Publishes a snapshot of a playlist, unless nothing changed since the previous one. Writer only.
+       *
+       * \param playlist The playlist, whose changes since the previous snapshot are taken with takeFirstChanged().
+       */
+      void publish(Playlist& playlist, bool is_playing, bool random_mode, bool repeat_mode);
+
+      Statistics getStatistics() const;
+
+   private:
+      void reclaim_();
+
+      std::atomic<const PlaylistSnapshot*> current_;
+      std::atomic<std::uint64_t> epoch_;
+
+      // snapshots replaced, with the epoch they were replaced in; writer only
+      std::vector<std::pair<const PlaylistSnapshot*, std::uint64_t>> retired_;
+
+      mutable std::mutex readers_mutex_;
+      std::vector<Reader::Slot*> slots_;
+
+      std::atomic<std::uint64_t> published_;
+      std::atomic<std::uint64_t> reused_chunks_;
+      std::atomic<std::uint64_t> copied_chunks_;
+      std::atomic<size_t> retired_count_;
+   };
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Codec.h"
+#include "Playlist.h"
+
+#include <ctime>
+#include <optional>
+#include <vector>
+
+namespace MusicPlayer
+{
+   class ThreadPool;
+
+   /**
+    * \brief A sorted and filtered view of a playlist, as a permutation of entry handles.
+    *
+    * The view references the entries by handle and never copies them: a view of a million entries takes 4 MB,
+    * whatever the size of the tracks. It is sorted entirely when it is defined, with the sort split across a thread
+    * pool for large playlists.
+    *
+    * The view then follows the changes of the playlist incrementally when it is refreshed: the entries added since are
+    * sorted among themselves and merged in, and the removed ones are dropped in a single pass. Views in playlist order
+    * are rebuilt by a single pass over the playlist instead, as moved entries change their order.
+    */
+   class PlaylistView
+   {
+   public:
+      enum class Order
+      {
+         Playlist,
+         Title,
+         Duration,
+         Codec
+      };
+
+      struct Filter
+      {
+         std::optional<Codec::Type> codec;
+
+         // in seconds, exclusive
+         std::optional<time_t> longer_than;
+         std::optional<time_t> shorter_than;
+
+         bool matches(const Track& track) const;
+      };
+
+      PlaylistView();
+
+      /**
+       * \brief Defines the view and builds it from the entries of a playlist, sorting on the shared thread pool.
+       */
+      void define(const Playlist& playlist, Order order, const Filter& filter);
+
+      /**
+       * \brief Same as define(), sorting on the given pool.
+       */
+      void define(const Playlist& playlist, Order order, const Filter& filter, ThreadPool& pool);
+
+      /**
+       * \brief Brings the view up to date with the entries added to and removed from the playlist since it was built.
+       */
+      void refresh(const Playlist& playlist);
+
+      /**
+       * \brief Forgets the definition of the view.
+       */
+      void clear();
+
+      bool isDefined() const { return defined_; }
+      Order getOrder() const { return order_; }
+      const Filter& getFilter() const { return filter_; }
+
+      size_t size() const { return handles_.size(); }
+      Playlist::Handle operator[](size_t index) const { return handles_[index]; }
+
+      static const char* getOrderName(Order order);
+
+   private:
+      void build_(const Playlist& playlist, ThreadPool& pool);
+
+      bool defined_;
+      Order order_;
+      Filter filter_;
+
+      // the matching entries, in view order
+      std::vector<Playlist::Handle> handles_;
+
+      // the handles below were considered, and the playlist had this many entries, when the view was last refreshed
+      Playlist::Handle known_handles_;
+      size_t known_size_;
+   };
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Decoder.h"
+#include "PlaybackEngine.h"
+#include "Playlist.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Opens the upcoming track and decodes its first frames in the background.
+    *
+    * One track is prefetched at a time, by a job of the shared thread pool at the prefetch priority. Taking the
+    * prefetched decoder when the playback moves to that track makes the transition warm: the file is already open
+    * and the first frames are decoded. Transitions to any other track, or to a track whose prefetch is still
+    * running, are cold.
+    *
+    * Replacing or discarding the prefetched track cancels its job: a job that did not start is skipped, and a
+    * running one stops after opening the file.
+    *
+    * All methods are thread-safe.
+    */
+   class Prefetcher
+   {
+   public:
+      static constexpr size_t kDefaultPrefetchFrames = 16384;
+
+      /**
+       * \param prefetch_frames The number of frames decoded ahead.
+       */
+      explicit Prefetcher(size_t prefetch_frames = kDefaultPrefetchFrames);
+
+      Prefetcher(const Prefetcher&) = delete;
+      Prefetcher& operator=(const Prefetcher&) = delete;
+
+      /**
+       * \brief Starts preparing a track, replacing the previously prefetched one.
+       *
+       * \param handle The playlist entry of the track.
+       * \param codec The codec of the track.
+       * \param audio_file The path of the audio file of the track.
+       * \param gain The gain of the track stream.
+       */
+      void prefetch(Playlist::Handle handle, Codec::Type codec, std::string audio_file, float gain);
+
+      /**
+       * \brief Discards the prefetched track.
+       */
+      void cancel();
+
+      /**
+       * \brief Returns the entry being prefetched, or kInvalidHandle.
+       */
+      Playlist::Handle getPendingHandle() const;
+
+      /**
+       * \brief Takes the decoder prefetched for an entry, and counts the transition as warm or cold.
+       *
+       * \return The stream, whose decoder is positioned at the start of the track, or no decoder if this entry was not
+       *         prefetched or could not be opened.
+       */
+      PlaybackEngine::Stream take(Playlist::Handle handle);
+
+      /**
+       * \brief Takes the prefetched decoder if it produces the given format, for a gapless transition.
+       *
+       * Waits for the prefetch to complete. Decoders of another format are kept for take().
+       *
+       * \param format The format of the stream to continue. A sample rate of 0 accepts any rate.
+       * \param handle Receives the entry of the returned decoder.
+       * \return The stream, or no decoder if no compatible track is prefetched.
+       */
+      PlaybackEngine::Stream takeCompatible(const AudioFormat& format, Playlist::Handle& handle);
+
+      size_t getWarmCount() const { return warm_count_.load(std::memory_order_relaxed); }
+      size_t getColdCount() const { return cold_count_.load(std::memory_order_relaxed); }
+
+   private:
+      bool resolve_();
+      void countTransition_(bool warm);
+
+      const size_t prefetch_frames_;
+
+      mutable std::mutex mutex_;
+      Playlist::Handle pending_handle_;
+      float pending_gain_;
+      std::future<std::unique_ptr<Decoder>> pending_;
+      ThreadPool::CancellationToken pending_token_;
+      std::unique_ptr<Decoder> ready_;
+
+      std::atomic<size_t> warm_count_;
+      std::atomic<size_t> cold_count_;
+   };
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Converts interleaved float samples from one sample rate to another with a polyphase filter.
+    *
+    * For a rate ratio reduced to L/M, every output frame is computed with one of L precomputed filter phases.
+    * The filter tables only depend on the ratio and on the quality: they are computed once, and shared by all
+    * resamplers through a process-wide cache.
+    *
+    * The resampler is a streaming stage: input blocks of any size can be pushed, and flush() outputs the end
+    * of the stream. The output is aligned on the input: it does not start with the delay of the filter.
+    */
+   class Resampler
+   {
+   public:
+      enum class Quality
+      {
+         // linear interpolation between the two nearest input frames
+         Fast,
+         // 16-tap windowed sinc
+         Medium,
+         // 64-tap windowed sinc
+         High
+      };
+
+      static std::string_view getQualityName(Quality quality);
+      static std::optional<Quality> findQuality(std::string_view name);
+
+      Resampler();
+
+      /**
+       * \brief Prepares the conversion of a stream, and resets the state of the previous one.
+       */
+      void configure(unsigned input_rate, unsigned output_rate, unsigned channels, Quality quality);
+
+      /**
+       * \brief Returns the maximum number of frames output for an input block of the given size.
+       */
+      size_t getMaxOutputFrames(size_t input_frames) const;
+
+      /**
+       * \brief Resamples an input block.
+       *
+       * \param input The interleaved input frames.
+       * \param input_frames The number of input frames.
+       * \param output Receives at most getMaxOutputFrames(input_frames) interleaved frames.
+       * \return The number of output frames.
+       */
+      size_t process(const float* input, size_t input_frames, float* output);
+
+      /**
+       * \brief Outputs the frames still held by the filter at the end of the stream.
+       *
+       * \param output Receives at most getMaxOutputFrames(0) frames.
+       * \return The number of output frames.
+       */
+      size_t flush(float* output);
+
+      unsigned getInputRate() const { return input_rate_; }
+      unsigned getOutputRate() const { return output_rate_; }
+      Quality getQuality() const { return quality_; }
+
+   private:
+      struct FilterBank
+      {
+         unsigned phases;
+         unsigned taps;
+
+         // taps coefficients of each phase, applied to the frames from the center - taps / 2 + 1
+         std::vector<float> coefficients;
+      };
+
+      using FilterKey = std::tuple<std::uint64_t, std::uint64_t, Quality>;
+
+      static std::shared_ptr<const FilterBank> filterBankFor_(std::uint64_t upsampling, std::uint64_t downsampling, Quality quality);
+      static std::shared_ptr<const FilterBank> computeFilterBank_(std::uint64_t upsampling, std::uint64_t downsampling, Quality quality);
+
+      size_t produce_(float* output, size_t max_frames);
+
+      unsigned input_rate_;
+      unsigned output_rate_;
+      unsigned channels_;
+      Quality quality_;
+
+      // the rate ratio is upsampling_ / downsampling_
+      std::uint64_t upsampling_;
+      std::uint64_t downsampling_;
+
+      std::shared_ptr<const FilterBank> filters_;
+
+      // input frames not consumed yet, preceded by the frames still needed by the filter
+      std::vector<float> history_;
+      size_t history_frames_;
+
+      // frame of the history under the next output frame, and its fractional position in 1 / upsampling_ units
+      size_t center_;
+      std::uint64_t phase_;
+
+      std::uint64_t input_count_;
+      std::uint64_t output_count_;
+   };
+
+}
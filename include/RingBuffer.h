@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Lock-free ring buffer for exactly one producer thread and one consumer thread.
+    *
+    * The storage is allocated once by the constructor: reads and writes never allocate nor block. The read and
+    * write indices only grow and live on separate cache lines, so that each side only writes to its own line.
+    */
+   template <typename T>
+   class RingBuffer
+   {
+   public:
+      /**
+       * \param capacity The minimum number of items the buffer can hold, rounded up to a power of two.
+       */
+      explicit RingBuffer(size_t capacity) :
+         items_(roundUpToPowerOfTwo_(capacity)),
+         mask_(items_.size() - 1),
+         write_index_(0),
+         read_index_(0)
+      {
+      }
+
+      RingBuffer(const RingBuffer&) = delete;
+      RingBuffer& operator=(const RingBuffer&) = delete;
+
+      size_t capacity() const { return items_.size(); }
+
+      /**
+       * \brief Returns the number of items that can be read. Called by the consumer.
+       */
+      size_t readAvailable() const
+      {
+         return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * \brief Returns the number of items that can be written. Called by the producer.
+       */
+      size_t writeAvailable() const
+      {
+         return items_.size() - (write_index_.load(std::memory_order_relaxed) - read_index_.load(std::memory_order_acquire));
+      }
+
+      /**
+       * \brief Appends as many items as there is room for. Called by the producer.
+       *
+       * \return The number of items written.
+       */
+      size_t write(const T* items, size_t count)
+      {
+         size_t write_index = write_index_.load(std::memory_order_relaxed);
+         count = std::min(count, items_.size() - (write_index - read_index_.load(std::memory_order_acquire)));
+
+         // the items may wrap around the end of the storage
+         size_t start = write_index & mask_;
+         size_t first_part = std::min(count, items_.size() - start);
+         std::copy(items, items + first_part, items_.begin() + start);
+         std::copy(items + first_part, items + count, items_.begin());
+
+         write_index_.store(write_index + count, std::memory_order_release);
+         return count;
+      }
+
+      /**
+       * \brief Removes up to count items from the buffer. Called by the consumer.
+       *
+       * \return The number of items read.
+       */
+      size_t read(T* items, size_t count)
+      {
+         size_t read_index = read_index_.load(std::memory_order_relaxed);
+         count = std::min(count, write_index_.load(std::memory_order_acquire) - read_index);
+
+         size_t start = read_index & mask_;
+         size_t first_part = std::min(count, items_.size() - start);
+         std::copy(items_.begin() + start, items_.begin() + start + first_part, items);
+         std::copy(items_.begin(), items_.begin() + (count - first_part), items + first_part);
+
+         read_index_.store(read_index + count, std::memory_order_release);
+         return count;
+      }
+
+      /**
+       * \brief Empties the buffer. Neither the producer nor the consumer may be running.
+       */
+      void clear()
+      {
+         write_index_.store(0, std::memory_order_relaxed);
+         read_index_.store(0, std::memory_order_relaxed);
+      }
+
+   private:
+      static size_t roundUpToPowerOfTwo_(size_t value)
+      {
+         size_t rounded(1);
+         while (rounded < value)
+            rounded <<= 1;
+         return rounded;
+      }
+
+      std::vector<T> items_;
+      const size_t mask_;
+
+      alignas(64) std::atomic<size_t> write_index_;
+      alignas(64) std::atomic<size_t> read_index_;
+   };
+
+}
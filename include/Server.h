@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Hosts independent shell sessions in one process, driven over a local Unix socket.
+    *
+    * Every connection is a session with its own shell: its own playlist, selection and playback. The sessions
+    * share the process-wide resources of the player: the interned strings, the codec tables, the DSP kernels,
+    * the resampler filter tables and the background thread pool.
+    *
+    * A single thread multiplexes all connections with poll(). Instructions are executed by a fixed pool of
+    * executor threads, one instruction of a session at a time and in the order they were received.
+    *
+    * Protocol: the client sends one instruction per line. Each instruction is answered, in order, by a header
+    * line "ok <length>" or "error <length>", followed by the <length> bytes the instruction printed. The
+    * session ends when the client closes the connection, or after answering the exit instruction.
+    *
+    * Sessions cannot change the current directory, shared by the process, nor use the wait instruction, which
+    * would hold an executor for the length of a track: clients poll the playback with playback_stats instead.
+    *
+    * Only available on POSIX systems.
+    */
+   class Server
+   {
+   public:
+      static constexpr size_t kMaxLineLength = 64 * 1024;
+
+      /**
+       * \param socket_path The path of the socket to listen on.
+       * \param executor_count The number of threads executing instructions, or 0 for one per hardware thread.
+       */
+      explicit Server(std::string socket_path, size_t executor_count = 0);
+
+      /**
+       * \brief Closes all sessions and removes the socket.
+       */
+      ~Server();
+
+      Server(const Server&) = delete;
+      Server& operator=(const Server&) = delete;
+
+      /**
+       * \brief Creates the socket and starts listening. A stale socket left at the same path is replaced.
+       *
+       * \param error Receives the reason of the failure, if any.
+       * \return false if the socket could not be created.
+       */
+      bool listen(std::string& error);
+
+      /**
+       * \brief Serves the sessions until stop() is called.
+       */
+      void run();
+
+      /**
+       * \brief Makes run() return. Can be called from any thread, and from a signal handler.
+       */
+      void stop();
+
+      size_t getSessionCount() const { return session_count_.load(std::memory_order_relaxed); }
+      std::uint64_t getInstructionCount() const { return instruction_count_.load(std::memory_order_relaxed); }
+
+   private:
+      struct Session;
+
+      void accept_();
+      bool receive_(const std::shared_ptr<Session>& session);
+      bool send_(Session& session);
+      void close_(int fd);
+      void execute_(const std::shared_ptr<Session>& session);
+      void notify_(const std::shared_ptr<Session>& session);
+
+      const std::string socket_path_;
+
+      int listen_fd_;
+
+      // written by the executors and stop() to wake the poll() loop
+      int wake_read_fd_;
+      int wake_write_fd_;
+
+      std::atomic<bool> stop_requested_;
+
+      // accessed by the poll() loop only
+      std::unordered_map<int, std::shared_ptr<Session>> sessions_;
+
+      // sessions with answers to send, queued by the executors
+      std::mutex answered_mutex_;
+      std::vector<std::shared_ptr<Session>> answered_;
+
+      std::atomic<size_t> session_count_;
+      std::atomic<std::uint64_t> instruction_count_;
+
+      // released first by the destructor, so that no instruction is running when the sockets are closed
+      std::unique_ptr<ThreadPool> executors_;
+   };
+
+}
@@ -1,14 +1,19 @@
 #pragma once
 
-#include "Track.h"
-
-#include <functional>
+#include "PlaybackEngine.h"
+#include "PlayQueue.h"
+#include "Playlist.h"
+#include "PlaylistJournal.h"
+#include "PlaylistSnapshot.h"
+#include "PlaylistView.h"
+#include "Prefetcher.h"
+#include "Shuffle.h"
+
+#include <atomic>
 #include <iostream>
-#include <list>
-#include <random>
 #include <set>
 #include <string>
-#include <tuple>
+#include <string_view>
 #include <vector>
 
 namespace MusicPlayer
@@ -16,10 +21,8 @@ namespace MusicPlayer
    class Shell
    {
    public:
-      using ArgumentArray = std::vector<std::string>;
-      using Instruction = std::function<void(Shell*, const ArgumentArray&)>;
-
-      using Playlist = std::list<std::pair<std::string, Track>>;
+      using ArgumentArray = std::vector<std::string_view>;
+      using Instruction = void (Shell::*)(const ArgumentArray&);
 
       Shell();
 
@@ -35,27 +38,151 @@ namespace MusicPlayer
          output_ = &out;
       }
 
-      void run();
+      /**
+       * \brief Sets whether the shell prints its welcome message and a prompt before each instruction.
+       */
+      void setInteractive(bool interactive)
+      {
+         interactive_ = interactive;
+      }
+
+      /**
+       * \brief Sets whether run() stops at the first instruction that fails.
+       */
+      void setStopOnError(bool stop_on_error)
+      {
+         stop_on_error_ = stop_on_error;
+      }
+
+      /**
+       * \brief Sets whether the current_directory instruction can change the directory of the process.
+       *
+       * Shells sharing a process with other shells must not change it under their feet.
+       */
+      void setDirectoryChangeAllowed(bool allowed)
+      {
+         directory_change_allowed_ = allowed;
+      }
+
+      /**
+       * \brief Sets whether the wait instruction can block until the current track ends.
+       *
+       * Shells executed by a shared pool of threads must not hold one of them for the length of a track.
+       */
+      void setWaitAllowed(bool allowed)
+      {
+         wait_allowed_ = allowed;
+      }
+
+      /**
+       * \brief Tells whether the exit instruction was executed.
+       */
+      bool isExitRequested() const
+      {
+         return exit_requested_;
+      }
+
+      /**
+       * \brief Returns the snapshots of the playlist and of the playback state, published after each instruction.
+       *
+       * Other threads read them through a PlaylistSnapshots::Reader without blocking the shell.
+       */
+      PlaylistSnapshots& getSnapshots()
+      {
+         return snapshots_;
+      }
+
+      /**
+       * \brief Executes instructions from the input stream until its end, or until the exit instruction.
+       *
+       * \return 0, or 1 if the shell stopped on a failed instruction.
+       */
+      int run();
+
+      /**
+       * \brief Executes a single instruction line.
+       *
+       * Looking up the instruction and splitting its arguments does not allocate memory.
+       *
+       * \return false if the instruction failed.
+       */
+      bool execute(std::string_view command_line);
 
    private:
-      std::unordered_map<std::string, Instruction> available_instructions_;
+      struct InstructionEntry
+      {
+         std::string_view name;
+         Instruction instruction;
+      };
+
+      static const InstructionEntry kInstructions[];
       const std::string sHelpFlag = "--help";
 
+      // reused between instructions, so that reading and splitting a command line does not allocate
+      std::string full_input_;
+      ArgumentArray arguments_;
+
       Playlist playlist_;
-      Playlist::iterator currently_playing_;
       bool is_playing_;
+
+      // records the changes of the playlist since it was last saved to or loaded from a journaled file
+      PlaylistJournal journal_;
+
+      PlaylistSnapshots snapshots_;
+
+      // sorted and filtered view shown by the "view" instruction, refreshed when shown
+      PlaylistView playlist_view_;
+
+      // declared before the playback engine, whose producer takes the prefetched tracks
+      Prefetcher prefetcher_;
+      PlaybackEngine playback_;
+
+      // entry decoded by the playback engine, or kInvalidHandle
+      Playlist::Handle playing_handle_;
+      bool decoding_;
+
+      // entry handed to the playback engine for a gapless transition, set from its producer
+      std::atomic<Playlist::Handle> gapless_handle_;
+      size_t seen_transitions_;
+
+      // loudness normalization of the tracks that start playing
+      bool replay_gain_;
+      float replay_gain_preamp_db_;
+
+      // order of the tracks in random mode, with the tracks played since the start of the cycle
+      Shuffle shuffle_;
       bool random_mode_;
       bool repeat_mode_;
 
-      std::mt19937 rng_;
+      // tracks to play before the playlist order continues, from the entry that was selected when they started
+      PlayQueue play_queue_;
+      Playlist::Handle queued_handle_;
+      Playlist::Handle queue_return_;
 
       std::istream* input_;
       std::ostream* output_;
 
+      bool interactive_;
+      bool stop_on_error_;
+      bool directory_change_allowed_;
+      bool wait_allowed_;
+      bool exit_requested_;
+      bool instruction_failed_;
+
       void printWelcomeMessage_();
-      std::tuple<Instruction, ArgumentArray> getInstruction_();
+      Instruction getInstruction_(std::string_view full_input);
+      std::ostream& error_();
       std::set<int> parseIndicesFromArgs_(const ArgumentArray&);
-      void goToRandomTrack_();
+      std::vector<Playlist::Range> parseRangesFromArgs_(const ArgumentArray&);
+      void goToRandomTrack_(long long number_of_jumps, bool forward);
+      size_t orderPosition_() const;
+      size_t upcomingPosition_();
+      void moveToUpcoming_(size_t position);
+      bool startPlayback_();
+      void selectionChanged_();
+      void syncPlayback_();
+      void prefetchUpcoming_();
+      float streamGain_(const Track& track) const;
 
       // Instructions
       void help_(const ArgumentArray&);
@@ -63,19 +190,36 @@ namespace MusicPlayer
       void unknownInstruction_(const ArgumentArray&);
 
       void addTrack_(const ArgumentArray&);
+      void addDirectory_(const ArgumentArray&);
+      void metadataCache_(const ArgumentArray&);
       void removeTrack_(const ArgumentArray&);
       void removeDuplicates_(const ArgumentArray&);
+      void keepTracks_(const ArgumentArray&);
+      void moveTracks_(const ArgumentArray&);
       void showTrack_(const ArgumentArray&);
       void showPlaylist_(const ArgumentArray&);
+      void view_(const ArgumentArray&);
 
       void play_(const ArgumentArray&);
       void pause_(const ArgumentArray&);
       void next_(const ArgumentArray&);
       void previous_(const ArgumentArray&);
+      void queue_(const ArgumentArray&);
+      void queueNext_(const ArgumentArray&);
+      void dequeue_(const ArgumentArray&);
+      void wait_(const ArgumentArray&);
+
+      void setOutput_(const ArgumentArray&);
+      void resample_(const ArgumentArray&);
+      void crossfade_(const ArgumentArray&);
+      void replayGain_(const ArgumentArray&);
+      void volume_(const ArgumentArray&);
+      void showPlaybackStatistics_(const ArgumentArray&);
 
       void random_(const ArgumentArray&);
       void repeat_(const ArgumentArray&);
 
+      void exit_(const ArgumentArray&);
       void cd_(const ArgumentArray&);
       void loadPlaylist_(const ArgumentArray&);
       void savePlaylist_(const ArgumentArray&);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Playlist.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief A random order of the entries of a playlist, in which every entry is played once per cycle.
+    *
+    * The order is a Fisher-Yates shuffle of the entry handles, drawn lazily: the handles before the drawn mark
+    * are the history of the cycle, in play order, and each step forward draws the next handle among the
+    * remaining ones. Stepping forward and back costs constant time, and going back returns to the entries that
+    * were actually played.
+    *
+    * The shuffle follows the changes of the playlist incrementally: entries added since the previous step join
+    * the handles left to draw, and removed entries are skipped and forgotten when they are met.
+    */
+   class Shuffle
+   {
+   public:
+      Shuffle();
+
+      void seed(std::uint32_t seed);
+
+      /**
+       * \brief Forgets the history and the drawn order: the next step starts a new cycle.
+       */
+      void reset();
+
+      /**
+       * \brief Returns the entry played after the current one, drawing it if needed, without moving to it.
+       *
+       * \param current The handle of the selected entry, which becomes the current one of the shuffle if it is not.
+       * \param repeat Whether a new cycle starts once every entry was played.
+       * \return The handle of the entry, or kInvalidHandle if the cycle is over.
+       */
+      Playlist::Handle peekNext(const Playlist& playlist, Playlist::Handle current, bool repeat);
+
+      /**
+       * \brief Moves to the entry played after the current one.
+       *
+       * \return The handle of the entry, or kInvalidHandle if the cycle is over.
+       */
+      Playlist::Handle next(const Playlist& playlist, Playlist::Handle current, bool repeat);
+
+      /**
+       * \brief Moves back to the entry played before the current one in the history.
+       *
+       * \return The handle of the entry, or kInvalidHandle at the start of the history.
+       */
+      Playlist::Handle previous(const Playlist& playlist, Playlist::Handle current);
+
+   private:
+      static constexpr std::uint32_t kNotShuffled = UINT32_MAX;
+
+      void sync_(const Playlist& playlist);
+      void anchor_(Playlist::Handle current);
+      void swap_(size_t first, size_t second);
+      void forget_(size_t index);
+      size_t upcomingIndex_(const Playlist& playlist, bool repeat);
+      void startCycle_(const Playlist& playlist);
+
+      // the drawn handles in play order, then the handles left to draw
+      std::vector<Playlist::Handle> order_;
+      size_t drawn_;
+
+      // index in order_ of the current entry, or npos
+      size_t cursor_;
+
+      // index in order_ of each handle, or kNotShuffled
+      std::vector<std::uint32_t> index_;
+
+      std::mt19937 rng_;
+   };
+
+}
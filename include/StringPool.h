@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief A string stored once in a StringPool.
+    *
+    * Equal strings interned in the same pool share the same storage, so two interned strings are compared by
+    * comparing their addresses. The storage is never released while the pool exists.
+    */
+   class InternedString
+   {
+   public:
+      InternedString();
+
+      std::string_view view() const { return view_; }
+      const char* data() const { return view_.data(); }
+      size_t size() const { return view_.size(); }
+      bool empty() const { return view_.empty(); }
+
+      operator std::string_view() const { return view_; }
+
+      bool operator==(const InternedString& other) const { return view_.data() == other.view_.data(); }
+      bool operator!=(const InternedString& other) const { return view_.data() != other.view_.data(); }
+
+      friend std::ostream& operator<<(std::ostream& out, const InternedString& value)
+      {
+         return out << value.view_;
+      }
+
+   private:
+      friend class StringPool;
+
+      explicit InternedString(std::string_view view) : view_(view) {}
+
+      std::string_view view_;
+   };
+
+   /**
+    * \brief Stores each distinct string once, in an arena indexed by a hash table.
+    *
+    * The pool is split in shards selected by the string hash, each with its own lock, so that several threads
+    * can intern strings at the same time.
+    */
+   class StringPool
+   {
+   public:
+      StringPool();
+
+      StringPool(const StringPool&) = delete;
+      StringPool& operator=(const StringPool&) = delete;
+
+      /**
+       * \brief Returns the interned copy of a string, adding it to the pool if needed.
+       */
+      InternedString intern(std::string_view value);
+
+      /**
+       * \brief Looks a string up without adding it.
+       *
+       * \param value The string to look for.
+       * \param found Receives the interned copy of the string, if it is in the pool.
+       * \return false if the string was never interned.
+       */
+      bool find(std::string_view value, InternedString& found) const;
+
+      /**
+       * \brief Number of distinct strings in the pool.
+       */
+      size_t size() const;
+
+      /**
+       * \brief Number of bytes reserved by the arena of the pool.
+       */
+      size_t allocatedBytes() const;
+
+      /**
+       * \brief Returns the pool shared by all the playlists and tracks of the player.
+       */
+      static StringPool& shared();
+
+   private:
+      static constexpr size_t kShardCount = 16;
+      static constexpr size_t kBlockSize = 64 * 1024;
+
+      struct Shard
+      {
+         mutable std::mutex mutex;
+         std::unordered_map<std::string_view, InternedString> index;
+
+         std::vector<std::unique_ptr<char[]>> blocks;
+         size_t block_used = kBlockSize;
+         size_t allocated_bytes = 0;
+      };
+
+      std::array<Shard, kShardCount> shards_;
+
+      static size_t shardOf_(size_t hash) { return hash % kShardCount; }
+      static std::string_view store_(Shard& shard, std::string_view value);
+   };
+
+}
+
+namespace std
+{
+   template <>
+   struct hash<MusicPlayer::InternedString>
+   {
+      size_t operator()(const MusicPlayer::InternedString& value) const noexcept
+      {
+         return std::hash<const char*>()(value.data());
+      }
+   };
+}
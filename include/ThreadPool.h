@@ -0,0 +1,225 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief A fixed set of worker threads executing submitted jobs by priority, with work stealing.
+    *
+    * Each worker owns a deque of jobs per priority. Jobs submitted by a worker go to its own deques, and the worker
+    * takes back its newest job first, whose data is still in its cache. Jobs submitted from other threads go to a
+    * shared deque. An idle worker takes the oldest jobs of the shared deque, then steals the oldest jobs of the other
+    * workers. A worker always looks for a job of the highest priority first, but never interrupts the job it runs:
+    * jobs must be short for the realtime ones to be scheduled in time.
+    *
+    * Cancelling a job before it starts skips it, and its future reports a broken promise. A job that is already
+    * running may check its cancellation token to stop early.
+    */
+   class ThreadPool
+   {
+   public:
+      enum class Priority
+      {
+         Realtime,     // decoding for the audio output
+         Prefetch,     // preparing the upcoming track
+         Background    // loading and scanning playlists
+      };
+
+      static constexpr size_t kPriorityCount = 3;
+
+      /**
+       * \brief A shared flag requesting a job to be abandoned. Copies share the flag.
+       */
+      class CancellationToken
+      {
+      public:
+         CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+         void cancel() { cancelled_->store(true, std::memory_order_relaxed); }
+         bool isCancelled() const { return cancelled_->load(std::memory_order_relaxed); }
+
+      private:
+         friend class ThreadPool;
+
+         std::shared_ptr<std::atomic<bool>> cancelled_;
+      };
+
+      struct Statistics
+      {
+         struct Level
+         {
+            std::uint64_t executed = 0;
+            std::uint64_t cancelled = 0;
+
+            // time between the submission of a job and its start
+            double average_latency_us = 0.0;
+            double max_latency_us = 0.0;
+         };
+
+         std::array<Level, kPriorityCount> levels;
+
+         // jobs a worker took from the deques of another worker
+         std::uint64_t steals = 0;
+      };
+
+      /**
+       * \brief Starts the worker threads.
+       *
+       * \param thread_count Number of workers, or 0 to use one per hardware thread.
+       */
+      explicit ThreadPool(size_t thread_count = 0);
+
+      /**
+       * \brief Waits for the pending jobs to complete and stops the workers.
+       */
+      ~ThreadPool();
+
+      ThreadPool(const ThreadPool&) = delete;
+      ThreadPool& operator=(const ThreadPool&) = delete;
+
+      size_t size() const { return threads_.size(); }
+
+      /**
+       * \brief Queues a job for execution on one of the workers, at the background priority.
+       *
+       * \param job The callable to execute.
+       * \return A future holding the result of the job, or the exception it threw.
+       */
+      template <typename Function>
+      std::future<std::invoke_result_t<Function>> submit(Function&& job);
+
+      template <typename Function>
+      std::future<std::invoke_result_t<Function>> submit(Priority priority, Function&& job);
+
+      /**
+       * \brief Queues a job that is skipped if the token is cancelled before it starts.
+       */
+      template <typename Function>
+      std::future<std::invoke_result_t<Function>> submit(Priority priority, const CancellationToken& token, Function&& job);
+
+      /**
+       * \brief Waits for the result of a job. A worker of the pool executes the queued jobs of a priority meanwhile.
+       *
+       * Waiting from a worker does not hold the pool up: a job of the same priority as the awaited one is always
+       * either running, or executed by the waiting worker. Other threads only wait.
+       */
+      template <typename Result>
+      void wait(const std::future<Result>& result, Priority priority);
+
+      Statistics getStatistics() const;
+
+      static const char* getPriorityName(Priority priority);
+
+      /**
+       * \brief Returns the pool shared by all background work of the player.
+       */
+      static ThreadPool& shared();
+
+   private:
+      using Clock = std::chrono::steady_clock;
+
+      // how long a waiting thread that found no job to execute sleeps before looking again
+      static constexpr std::chrono::microseconds kHelpInterval{ 200 };
+
+      struct Job
+      {
+         std::function<void()> run;
+         std::shared_ptr<std::atomic<bool>> cancelled;
+         Clock::time_point submitted_at;
+      };
+
+      // the deques of a worker, or the shared deques for the last one
+      struct alignas(64) Queue
+      {
+         std::mutex mutex;
+         std::array<std::deque<Job>, kPriorityCount> jobs;
+      };
+
+      struct alignas(64) LevelCounters
+      {
+         std::atomic<std::uint64_t> executed{ 0 };
+         std::atomic<std::uint64_t> cancelled{ 0 };
+         std::atomic<std::int64_t> latency_total_ns{ 0 };
+         std::atomic<std::int64_t> latency_max_ns{ 0 };
+      };
+
+      void enqueue_(Priority priority, Job job);
+      bool take_(size_t worker, size_t first_level, size_t last_level, Job& job, size_t& level);
+      void run_(Job& job, size_t level);
+      bool help_(Priority priority);
+      void work_(size_t worker);
+
+      std::vector<std::thread> threads_;
+      std::vector<std::unique_ptr<Queue>> queues_;
+
+      // number of jobs queued per priority, and in total; counted before the job is queued
+      std::array<std::atomic<size_t>, kPriorityCount> queued_;
+      std::atomic<size_t> queued_total_;
+
+      std::mutex sleep_mutex_;
+      std::condition_variable job_available_;
+      bool stopping_;
+
+      std::array<LevelCounters, kPriorityCount> counters_;
+      std::atomic<std::uint64_t> steals_;
+   };
+
+   template <typename Function>
+   std::future<std::invoke_result_t<Function>> ThreadPool::submit(Function&& job)
+   {
+      return submit(Priority::Background, std::forward<Function>(job));
+   }
+
+   template <typename Function>
+   std::future<std::invoke_result_t<Function>> ThreadPool::submit(Priority priority, Function&& job)
+   {
+      using Result = std::invoke_result_t<Function>;
+
+      // std::function requires copyable callables, so the task is shared
+      auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(job));
+      std::future<Result> result = task->get_future();
+
+      enqueue_(priority, { [task]() { (*task)(); }, nullptr, Clock::now() });
+
+      return result;
+   }
+
+   template <typename Function>
+   std::future<std::invoke_result_t<Function>> ThreadPool::submit(Priority priority, const CancellationToken& token, Function&& job)
+   {
+      using Result = std::invoke_result_t<Function>;
+
+      auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(job));
+      std::future<Result> result = task->get_future();
+
+      // a skipped task is destroyed without running, which breaks its promise
+      enqueue_(priority, { [task]() { (*task)(); }, token.cancelled_, Clock::now() });
+
+      return result;
+   }
+
+   template <typename Result>
+   void ThreadPool::wait(const std::future<Result>& result, Priority priority)
+   {
+      while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      {
+         if (!help_(priority))
+            result.wait_for(kHelpInterval);
+      }
+   }
+
+}
@@ -1,28 +1,58 @@
 #pragma once
 
 #include "Codec.h"
+#include "StringPool.h"
 
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 
 namespace MusicPlayer
 {
 
+   /**
+    * \brief The loudness normalization metadata of a track.
+    */
+   struct ReplayGain
+   {
+      // gain bringing the track to the reference loudness, in dB
+      float gain_db = 0.0f;
+
+      // highest absolute sample value, 1.0 being full scale, or 0 if unknown
+      float peak = 0.0f;
+
+      bool operator==(const ReplayGain& other) const { return gain_db == other.gain_db && peak == other.peak; }
+
+      /**
+       * \brief Returns the linear gain to apply to the track, lowered if needed so that its peak does not clip.
+       *
+       * \param preamp_db An additional gain, in dB.
+       */
+      float getFactor(float preamp_db) const;
+   };
+
    /**
     * \brief A music track that can be played in the music player.
+    *
+    * The title is interned in the shared string pool, so tracks with the same title share its storage.
+    * The error message of an invalid track is not: it can hold user input, and the pool is never freed.
+    * The ReplayGain metadata are optional.
     */
    class Track
    {
    public:
       Track();
 
-      Track(std::string title, time_t duration, std::string _codec);
+      Track(std::string_view title, time_t duration, std::string_view codec);
+
+      Track(std::string_view title, time_t duration, Codec::Type codec);
 
       std::string serialize() const;
-      bool deserialize(const std::string& input);
+      bool deserialize(std::string_view input);
 
-      bool operator=(const Track& other) const;
+      bool operator==(const Track& other) const;
 
       // Manipulators for output format
       static inline std::ostream& shortFormat(std::ostream& os)
@@ -40,17 +70,27 @@ namespace MusicPlayer
       bool isInvalid() const;
       std::string getErrorMessage() const;
 
+      InternedString getTitle() const { return title_; }
+      time_t getDuration() const { return duration_; }
+      Codec::Type getCodec() const { return codec_; }
+      const std::optional<ReplayGain>& getReplayGain() const { return replay_gain_; }
+      void setReplayGain(std::optional<ReplayGain> replay_gain) { replay_gain_ = replay_gain; }
+
    private:
-      std::string title_;
+      InternedString title_;
       time_t duration_;
       Codec::Type codec_;
+      std::optional<ReplayGain> replay_gain_;
+
+      // set only for invalid tracks, and shared by their copies
+      std::shared_ptr<const std::string> error_message_;
 
       static const long kShortFormat = 0;
       static const long kLongFormat = 1;
       static std::ostream& setFormat(std::ostream& os, long format);
       static const int kFormatFlagHandle;
 
-      void setInvalid_(const std::string& message);
+      void setInvalid_(std::string message);
    };
 
 }
@@ -1,17 +1,144 @@
 #pragma once
 
+#include <cstddef>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace MusicPlayer {
+   /**
+    * \brief Lazily splits a string into the substrings found between occurrences of a delimiter.
+    *
+    * Empty substrings are skipped. The tokens are views on the original string, so iterating over them does
+    * not allocate memory, and the original string must outlive them.
+    *
+    * Usage:
+    *    for (std::string_view word : Tokenizer(line, ' ')) { ... }
+    */
+   class Tokenizer {
+   public:
+      class iterator {
+      public:
+         using iterator_category = std::input_iterator_tag;
+         using value_type = std::string_view;
+         using difference_type = std::ptrdiff_t;
+         using pointer = const std::string_view*;
+         using reference = const std::string_view&;
+
+         iterator() : tokenizer_(nullptr) {}
+
+         reference operator*() const { return token_; }
+         pointer operator->() const { return &token_; }
+
+         iterator& operator++() {
+            if (!tokenizer_->next_(rest_, token_))
+               tokenizer_ = nullptr;
+            return *this;
+         }
+
+         iterator operator++(int) {
+            iterator previous(*this);
+            ++*this;
+            return previous;
+         }
+
+         bool operator==(const iterator& other) const {
+            // all iterators are equal to end() once the tokens are exhausted
+            return tokenizer_ == other.tokenizer_ && (!tokenizer_ || rest_.data() == other.rest_.data());
+         }
+
+         bool operator!=(const iterator& other) const { return !(*this == other); }
+
+      private:
+         friend class Tokenizer;
+
+         iterator(const Tokenizer* tokenizer, std::string_view source) : tokenizer_(tokenizer), rest_(source) {
+            ++*this;
+         }
+
+         const Tokenizer* tokenizer_;
+         std::string_view rest_;
+         std::string_view token_;
+      };
+
+      Tokenizer(std::string_view source, char delimiter) :
+         source_(source), delimiter_char_(delimiter) {}
+
+      Tokenizer(std::string_view source, std::string_view delimiter) :
+         source_(source), delimiter_(delimiter), delimiter_char_('\0') {}
+
+      iterator begin() const { return iterator(this, source_); }
+      iterator end() const { return iterator(); }
+
+      /**
+       * \brief Extracts the next non-empty token, and advances the tokenizer past it.
+       *
+       * Iterating over the tokenizer afterwards only yields the tokens that were not extracted yet.
+       *
+       * \param token Receives the extracted token.
+       * \return false if there was no non-empty token left.
+       */
+      bool next(std::string_view& token) {
+         return next_(source_, token);
+      }
+
+   private:
+      // extracts the next non-empty token of the remaining text, and advances the text past it
+      bool next_(std::string_view& rest, std::string_view& token) const {
+         while (!rest.empty()) {
+            size_t delimiter_size = delimiter_.empty() ? 1 : delimiter_.size();
+            size_t end = delimiter_.empty() ? rest.find(delimiter_char_) : rest.find(delimiter_);
+
+            token = rest.substr(0, end);
+            rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + delimiter_size);
+
+            if (!token.empty())
+               return true;
+         }
+
+         return false;
+      }
+
+      std::string_view source_;
+      std::string_view delimiter_;
+      char delimiter_char_;
+   };
+
    /**
     * \brief Splits a string into multiple substrings according to a delimiter.
     *
     * Values corresponding to a single whitespace are not included in the returned array.
+    * This copies every substring: prefer Tokenizer, unless the substrings must outlive the original string.
     *
     * \param original The string to split.
     * \param delimiter The delimiter to split the string around.
     * \return A vector of the splitted parts.
     */
    std::vector<std::string> split(const std::string& original, const std::string& delimiter);
+
+   /**
+    * \brief Parses a whole string as a base-10 integer.
+    *
+    * \param text The string to parse.
+    * \param value Receives the parsed number.
+    * \return false if the string is not entirely made of an integer.
+    */
+   bool parseInteger(std::string_view text, long long& value);
+
+   /**
+    * \brief Parses a whole string as a base-10 decimal number, such as "-6.5".
+    *
+    * \param text The string to parse.
+    * \param value Receives the parsed number.
+    * \return false if the string is not entirely made of a finite number.
+    */
+   bool parseDecimal(std::string_view text, double& value);
+
+   /**
+    * \brief Returns the largest amount of physical memory used by the process so far.
+    *
+    * \return The peak resident set size in bytes, or 0 if it is not available on this platform.
+    */
+   size_t getPeakResidentMemory();
 }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Decoder.h"
+#include "MappedFile.h"
+
+namespace MusicPlayer
+{
+
+   /**
+    * \brief Decodes uncompressed RIFF/WAVE files: 8, 16, 24 and 32-bit integer PCM, and 32-bit float.
+    */
+   class WavDecoder : public Decoder
+   {
+   public:
+      bool open(const std::string& file_name) override;
+      size_t read(float* samples, size_t frames) override;
+
+   private:
+      MappedFile file_;
+
+      const unsigned char* data_ = nullptr;
+      std::uint64_t next_frame_ = 0;
+
+      bool is_float_ = false;
+      unsigned bytes_per_sample_ = 0;
+   };
+
+}
@@ -0,0 +1,141 @@
+#include "AudioSink.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+   constexpr size_t kWaveHeaderSize = 44;
+
+   void writeLittleEndian(std::ostream& out, std::uint32_t value, size_t byte_count)
+   {
+      for (size_t idx = 0; idx < byte_count; idx++)
+         out.put(static_cast<char>((value >> (8 * idx)) & 0xFF));
+   }
+
+   void writeWaveHeader(std::ostream& out, const MusicPlayer::AudioFormat& format, std::uint64_t frames)
+   {
+      const std::uint32_t block_align = format.channels * sizeof(float);
+      const std::uint64_t data_size = frames * block_align;
+
+      out.write("RIFF", 4);
+      writeLittleEndian(out, static_cast<std::uint32_t>(kWaveHeaderSize - 8 + data_size), 4);
+      out.write("WAVE", 4);
+
+      out.write("fmt ", 4);
+      writeLittleEndian(out, 16, 4);
+      writeLittleEndian(out, 3, 2);
+      writeLittleEndian(out, format.channels, 2);
+      writeLittleEndian(out, format.sample_rate, 4);
+      writeLittleEndian(out, format.sample_rate * block_align, 4);
+      writeLittleEndian(out, block_align, 2);
+      writeLittleEndian(out, 32, 2);
+
+      out.write("data", 4);
+      writeLittleEndian(out, static_cast<std::uint32_t>(data_size), 4);
+   }
+
+   bool isLittleEndian()
+   {
+      const std::uint16_t probe = 1;
+      return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+   }
+}
+
+namespace MusicPlayer
+{
+
+   NullSink::NullSink(bool realtime) :
+      realtime_(realtime), sample_rate_(0)
+   {
+   }
+
+   bool NullSink::open(const AudioFormat& format, std::string&)
+   {
+      sample_rate_ = format.sample_rate;
+      played_until_ = std::chrono::steady_clock::now();
+      return true;
+   }
+
+   void NullSink::write(const float*, size_t frames)
+   {
+      if (!realtime_ || sample_rate_ == 0)
+         return;
+
+      // returns when a device would have played the frames, counting from the end of the previous write if
+      // the stream was not interrupted
+      played_until_ = std::max(played_until_, std::chrono::steady_clock::now())
+         + std::chrono::nanoseconds(static_cast<std::int64_t>(frames) * 1000000000 / sample_rate_);
+      std::this_thread::sleep_until(played_until_);
+   }
+
+   FileSink::FileSink(std::string file_name) :
+      file_name_(std::move(file_name)), frames_written_(0)
+   {
+   }
+
+   FileSink::~FileSink()
+   {
+      close();
+      file_.close();
+   }
+
+   bool FileSink::open(const AudioFormat& format, std::string& error)
+   {
+      if (file_.is_open())
+      {
+         // the following streams are appended to the same file
+         if (format.sample_rate == format_.sample_rate && format.channels == format_.channels)
+            return true;
+
+         error = "File \"" + file_name_ + "\" already holds audio in another format.";
+         return false;
+      }
+
+      if (!isLittleEndian())
+      {
+         error = "The file output is only supported on little-endian systems.";
+         return false;
+      }
+
+      file_.open(file_name_, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+      if (!file_.is_open())
+      {
+         error = "File \"" + file_name_ + "\" could not be opened.";
+         return false;
+      }
+
+      format_ = format;
+      frames_written_ = 0;
+
+      // the sizes are written again at the end of each stream
+      writeWaveHeader(file_, format, 0);
+
+      return true;
+   }
+
+   void FileSink::write(const float* samples, size_t frames)
+   {
+      file_.write(reinterpret_cast<const char*>(samples), frames * format_.channels * sizeof(float));
+      frames_written_ += frames;
+   }
+
+   void FileSink::close()
+   {
+      if (!file_.is_open())
+         return;
+
+      const std::uint32_t data_size = static_cast<std::uint32_t>(frames_written_ * format_.channels * sizeof(float));
+
+      // the file stays valid between streams
+      file_.seekp(4);
+      writeLittleEndian(file_, static_cast<std::uint32_t>(kWaveHeaderSize - 8 + data_size), 4);
+      file_.seekp(kWaveHeaderSize - 4);
+      writeLittleEndian(file_, data_size, 4);
+
+      file_.seekp(0, std::ofstream::end);
+      file_.flush();
+   }
+
+}
@@ -0,0 +1,257 @@
+#include "BinaryPlaylist.h"
+
+#include "MappedFile.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+   using MusicPlayer::InternedString;
+
+   constexpr char kMagic[4] = { 'I', 'P', 'L', 'B' };
+
+   // version 1 records have no ReplayGain fields
+   constexpr std::uint16_t kVersion1 = 1;
+   constexpr size_t kVersion1RecordSize = 24;
+
+   void putUInt(std::string& out, std::uint64_t value, size_t byte_count)
+   {
+      for (size_t idx = 0; idx < byte_count; idx++)
+         out.push_back(static_cast<char>((value >> (8 * idx)) & 0xFF));
+   }
+
+   std::uint64_t getUInt(const char* in, size_t byte_count)
+   {
+      std::uint64_t value(0);
+      for (size_t idx = 0; idx < byte_count; idx++)
+         value |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[idx])) << (8 * idx);
+      return value;
+   }
+
+   std::uint32_t floatBits(float value)
+   {
+      std::uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      return bits;
+   }
+
+   float bitsFloat(std::uint64_t bits)
+   {
+      auto narrowed = static_cast<std::uint32_t>(bits);
+      float value;
+      std::memcpy(&value, &narrowed, sizeof(value));
+      return value;
+   }
+
+   /**
+    * \brief Builds the deduplicated string table of a binary playlist.
+    */
+   class StringTable
+   {
+   public:
+      /**
+       * \brief Returns the offset of a string in the table, adding it if it is not there yet.
+       */
+      std::uint32_t add(InternedString value)
+      {
+         auto known = offsets_.find(value);
+         if (known != offsets_.end())
+            return known->second;
+
+         auto offset = static_cast<std::uint32_t>(contents_.size());
+         contents_.append(value.view());
+         offsets_.emplace(value, offset);
+         return offset;
+      }
+
+      const std::string& contents() const { return contents_; }
+
+   private:
+      std::string contents_;
+      std::unordered_map<InternedString, std::uint32_t> offsets_;
+   };
+}
+
+namespace MusicPlayer
+{
+
+   bool BinaryPlaylist::isBinaryPlaylist(std::string_view file_name)
+   {
+      std::string_view extension(kExtension);
+      return file_name.size() >= extension.size()
+         && file_name.compare(file_name.size() - extension.size(), extension.size(), extension) == 0;
+   }
+
+   bool BinaryPlaylist::save(const std::string& file_name, const Playlist& playlist, std::string& error)
+   {
+      std::string image;
+      if (!encode(playlist, image, error))
+         return false;
+
+      std::ofstream file(file_name, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+      if (!file.is_open())
+      {
+         error = "File \"" + file_name + "\" could not be opened.";
+         return false;
+      }
+
+      file.write(image.data(), image.size());
+
+      if (!file)
+      {
+         error = "File \"" + file_name + "\" could not be written.";
+         return false;
+      }
+
+      return true;
+   }
+
+   bool BinaryPlaylist::encode(const Playlist& playlist, std::string& image, std::string& error)
+   {
+      std::string records;
+      records.reserve(playlist.size() * kRecordSize);
+
+      StringTable strings;
+
+      for (const Playlist::Entry& entry : playlist)
+      {
+         const Track& track = entry.track;
+
+         std::uint32_t path_offset = strings.add(entry.path);
+         std::uint32_t title_offset = strings.add(track.getTitle());
+
+         putUInt(records, static_cast<std::uint64_t>(track.getDuration()), 4);
+         putUInt(records, static_cast<std::uint64_t>(track.getCodec()), 1);
+         putUInt(records, track.getReplayGain() ? 1 : 0, 1);
+         putUInt(records, 0, 2);
+         putUInt(records, path_offset, 4);
+         putUInt(records, entry.path.size(), 4);
+         putUInt(records, title_offset, 4);
+         putUInt(records, track.getTitle().size(), 4);
+
+         ReplayGain replay_gain = track.getReplayGain().value_or(ReplayGain());
+         putUInt(records, floatBits(replay_gain.gain_db), 4);
+         putUInt(records, floatBits(replay_gain.peak), 4);
+      }
+
+      if (strings.contents().size() > UINT32_MAX)
+      {
+         error = "The playlist strings exceed the capacity of the binary format.";
+         return false;
+      }
+
+      image.clear();
+      image.reserve(kHeaderSize + records.size() + strings.contents().size());
+      image.append(kMagic, sizeof(kMagic));
+      putUInt(image, kVersion, 2);
+      putUInt(image, kRecordSize, 2);
+      putUInt(image, playlist.size(), 8);
+      putUInt(image, kHeaderSize + records.size(), 8);
+      putUInt(image, strings.contents().size(), 8);
+      image.append(records);
+      image.append(strings.contents());
+
+      return true;
+   }
+
+   bool BinaryPlaylist::load(const std::string& file_name, Playlist& playlist, PlaylistLoader::Report& report, std::string& error)
+   {
+      auto start = std::chrono::steady_clock::now();
+
+      MappedFile file;
+      if (!file.open(file_name))
+      {
+         error = "File \"" + file_name + "\" could not be opened.";
+         return false;
+      }
+
+      if (!decode(file.view(), file_name, playlist, report, error))
+         return false;
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      report.seconds = elapsed.count();
+
+      return true;
+   }
+
+   bool BinaryPlaylist::decode(std::string_view image, const std::string& file_name, Playlist& playlist, PlaylistLoader::Report& report, std::string& error)
+   {
+      const char* data = image.data();
+      const size_t size = image.size();
+
+      // Header
+      if (size < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0)
+      {
+         error = "File \"" + file_name + "\" is not a binary playlist.";
+         return false;
+      }
+
+      std::uint64_t version = getUInt(data + 4, 2);
+      std::uint64_t record_size = getUInt(data + 6, 2);
+
+      if (!(version == kVersion && record_size == kRecordSize) && !(version == kVersion1 && record_size == kVersion1RecordSize))
+      {
+         error = "File \"" + file_name + "\" uses an unsupported binary playlist version.";
+         return false;
+      }
+
+      std::uint64_t entry_count = getUInt(data + 8, 8);
+      std::uint64_t strings_offset = getUInt(data + 16, 8);
+      std::uint64_t strings_size = getUInt(data + 24, 8);
+
+      if (entry_count > (size - kHeaderSize) / record_size
+         || strings_offset != kHeaderSize + entry_count * record_size
+         || strings_size != size - strings_offset)
+      {
+         error = "File \"" + file_name + "\" is truncated or corrupted.";
+         return false;
+      }
+
+      std::string_view strings(data + strings_offset, strings_size);
+
+      // Records are all validated before the playlist is modified
+      for (std::uint64_t idx = 0; idx < entry_count; idx++)
+      {
+         const char* record = data + kHeaderSize + idx * record_size;
+
+         std::uint64_t path_end = getUInt(record + 8, 4) + getUInt(record + 12, 4);
+         std::uint64_t title_end = getUInt(record + 16, 4) + getUInt(record + 20, 4);
+
+         if (static_cast<unsigned char>(record[4]) >= Codec::kTypeCount
+            || getUInt(record + 12, 4) == 0 || path_end > strings_size || title_end > strings_size
+            || (record_size == kRecordSize && record[5] != 0 && !std::isfinite(bitsFloat(getUInt(record + 24, 4)))))
+         {
+            error = "Record #" + std::to_string(idx + 1) + " of file \"" + file_name + "\" is corrupted.";
+            return false;
+         }
+      }
+
+      playlist.reserve(playlist.size() + entry_count);
+
+      for (std::uint64_t idx = 0; idx < entry_count; idx++)
+      {
+         const char* record = data + kHeaderSize + idx * record_size;
+
+         std::string_view path = strings.substr(getUInt(record + 8, 4), getUInt(record + 12, 4));
+         std::string_view title = strings.substr(getUInt(record + 16, 4), getUInt(record + 20, 4));
+
+         Track track(title, static_cast<time_t>(getUInt(record, 4)), static_cast<Codec::Type>(record[4]));
+         if (record_size == kRecordSize && record[5] != 0)
+            track.setReplayGain(ReplayGain{ bitsFloat(getUInt(record + 24, 4)), bitsFloat(getUInt(record + 28, 4)) });
+         playlist.append(path, std::move(track));
+      }
+
+      report.line_count = entry_count;
+      report.loaded_count = entry_count;
+      report.chunk_count = 1;
+
+      return true;
+   }
+
+}
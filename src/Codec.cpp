@@ -1,16 +1,19 @@
 #include "Codec.h"
 
+#include <stdexcept>
+
 namespace MusicPlayer {
-   std::unordered_map<Codec::Type, std::string> Codec::_string_representations =
+   static_assert(Codec::getCodecName(Codec::Type::G_711) == "G.711", "The codec names must be ordered as the Type enumeration.");
+   static_assert(Codec::findCodecType("vorbis") == Codec::Type::VORBIS, "Codec names must be matched ignoring case.");
+
+   Codec::Type Codec::getCodecTypeFromString(std::string_view source)
    {
-      {Codec::Type::AAC, "AAC"},
-      {Codec::Type::ALAC, "ALAC"},
-      {Codec::Type::AMR, "AMR"},
-      {Codec::Type::FLAC, "FLAC"},
-      {Codec::Type::G_711, "G.711"},
-      {Codec::Type::G_722, "G.722"},
-      {Codec::Type::MP3, "MP3"},
-      {Codec::Type::OPUS, "Opus"},
-      {Codec::Type::VORBIS, "Vorbis"},
-   };
-}
\ No newline at end of file
+      std::optional<Type> match = findCodecType(source);
+
+      if (!match) {
+         throw std::invalid_argument("The codec type " + std::string(source) + " is not supported");
+      }
+
+      return *match;
+   }
+}
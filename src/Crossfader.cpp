@@ -0,0 +1,179 @@
+#include "Crossfader.h"
+
+#include "Dsp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+   constexpr double kHalfPi = 1.57079632679489661923;
+
+   // equal-power curves: the power of the mix stays constant for uncorrelated streams
+   double fadeOutGain(double progress)
+   {
+      return std::cos(progress * kHalfPi);
+   }
+
+   double fadeInGain(double progress)
+   {
+      return std::sin(progress * kHalfPi);
+   }
+}
+
+namespace MusicPlayer
+{
+
+   Crossfader::Crossfader() :
+      fade_frames_(0),
+      channels_(0),
+      gain_(1.0f),
+      tail_start_(0),
+      tail_frames_(0),
+      crossfade_position_(0),
+      crossfade_frames_(0)
+   {
+   }
+
+   void Crossfader::configure(size_t fade_frames, unsigned channels)
+   {
+      fade_frames_ = fade_frames;
+      channels_ = channels;
+      gain_ = 1.0f;
+
+      // only reallocated when the length or the layout changes
+      tail_.resize(fade_frames * channels);
+
+      tail_start_ = 0;
+      tail_frames_ = 0;
+      crossfade_position_ = 0;
+      crossfade_frames_ = 0;
+   }
+
+   void Crossfader::startStream(float gain)
+   {
+      // the stream that ended was shorter than the crossfade into it
+      fadeOutRemainingTail_();
+
+      gain_ = gain;
+      crossfade_position_ = 0;
+      crossfade_frames_ = tail_frames_;
+   }
+
+   size_t Crossfader::process(float* samples, size_t frames)
+   {
+      const Dsp::Kernels& dsp = Dsp::kernels();
+
+      // the first frames of the stream are mixed into the tail of the previous one
+      size_t mixed = std::min(frames, crossfade_frames_ - crossfade_position_);
+      if (mixed > 0)
+         mix_(samples, mixed);
+
+      float* input = samples + mixed * channels_;
+      size_t input_frames = frames - mixed;
+
+      if (input_frames == 0)
+         return 0;
+
+      if (gain_ != 1.0f)
+         dsp.applyGain(input, input_frames, channels_, gain_, 0.0f);
+
+      if (fade_frames_ == 0)
+         return frames;
+
+      // the tail fills up before any frame is output
+      while (input_frames > 0 && tail_frames_ < fade_frames_)
+      {
+         size_t end = (tail_start_ + tail_frames_) % fade_frames_;
+         size_t copied = std::min(input_frames, std::min(fade_frames_ - tail_frames_, fade_frames_ - end));
+
+         std::copy_n(input, copied * channels_, tail_.begin() + end * channels_);
+         tail_frames_ += copied;
+         input += copied * channels_;
+         input_frames -= copied;
+      }
+
+      // then each frame received takes the place of the oldest one, which is output
+      float* output = input;
+      for (size_t swapped = 0; swapped < input_frames;)
+      {
+         size_t count = std::min(input_frames - swapped, fade_frames_ - tail_start_);
+
+         std::swap_ranges(output + swapped * channels_, output + (swapped + count) * channels_, tail_.begin() + tail_start_ * channels_);
+         tail_start_ = (tail_start_ + count) % fade_frames_;
+         swapped += count;
+      }
+
+      if (output != samples && input_frames > 0)
+         std::memmove(samples, output, input_frames * channels_ * sizeof(float));
+
+      return input_frames;
+   }
+
+   size_t Crossfader::flush(const float*& samples)
+   {
+      fadeOutRemainingTail_();
+
+      // the held frames are made contiguous, oldest first
+      std::rotate(tail_.begin(), tail_.begin() + tail_start_ * channels_, tail_.end());
+
+      size_t frames = tail_frames_;
+      samples = tail_.data();
+
+      tail_start_ = 0;
+      tail_frames_ = 0;
+      crossfade_position_ = 0;
+      crossfade_frames_ = 0;
+
+      return frames;
+   }
+
+   /**
+    * Fades out the next frames of the tail and mixes in the stream frames faded in, or fades out the tail only
+    * if samples is nullptr.
+    */
+   void Crossfader::mix_(const float* samples, size_t frames)
+   {
+      const Dsp::Kernels& dsp = Dsp::kernels();
+      const double length = static_cast<double>(crossfade_frames_);
+
+      while (frames > 0)
+      {
+         // the gains change linearly over each segment of the curves
+         size_t segment_start = crossfade_position_ / kCurveSegmentFrames * kCurveSegmentFrames;
+         size_t segment_end = std::min(segment_start + kCurveSegmentFrames, crossfade_frames_);
+         size_t segment_frames = segment_end - segment_start;
+
+         size_t tail_position = (tail_start_ + crossfade_position_) % fade_frames_;
+         size_t count = std::min(frames, std::min(segment_end - crossfade_position_, fade_frames_ - tail_position));
+         auto offset = static_cast<double>(crossfade_position_ - segment_start);
+
+         double out_start = fadeOutGain(segment_start / length);
+         double out_step = (fadeOutGain(segment_end / length) - out_start) / segment_frames;
+         float* tail = tail_.data() + tail_position * channels_;
+
+         dsp.applyGain(tail, count, channels_, static_cast<float>(out_start + offset * out_step), static_cast<float>(out_step));
+
+         if (samples)
+         {
+            double in_start = fadeInGain(segment_start / length);
+            double in_step = (fadeInGain(segment_end / length) - in_start) / segment_frames;
+
+            dsp.mixGain(samples, tail, count, channels_, static_cast<float>((in_start + offset * in_step) * gain_),
+               static_cast<float>(in_step * gain_));
+            samples += count * channels_;
+         }
+
+         crossfade_position_ += count;
+         frames -= count;
+      }
+   }
+
+   void Crossfader::fadeOutRemainingTail_()
+   {
+      if (crossfade_position_ < crossfade_frames_)
+         mix_(nullptr, crossfade_frames_ - crossfade_position_);
+   }
+
+}
@@ -0,0 +1,58 @@
+#include "Decoder.h"
+
+#include "FlacDecoder.h"
+#include "WavDecoder.h"
+
+namespace
+{
+   template <typename DecoderType>
+   std::unique_ptr<MusicPlayer::Decoder> makeDecoder()
+   {
+      return std::make_unique<DecoderType>();
+   }
+}
+
+namespace MusicPlayer
+{
+
+   std::array<DecoderRegistry::Entry, Codec::kTypeCount>& DecoderRegistry::entries_()
+   {
+      static std::array<Entry, Codec::kTypeCount> entries = []()
+      {
+         std::array<Entry, Codec::kTypeCount> builtins;
+         builtins[static_cast<size_t>(Codec::Type::PCM)] = { ".wav", &makeDecoder<WavDecoder> };
+         builtins[static_cast<size_t>(Codec::Type::FLAC)] = { ".flac", &makeDecoder<FlacDecoder> };
+         return builtins;
+      }();
+
+      return entries;
+   }
+
+   void DecoderRegistry::registerDecoder(Codec::Type codec, std::string_view extension, Factory factory)
+   {
+      entries_()[static_cast<size_t>(codec)] = { extension, factory };
+   }
+
+   std::unique_ptr<Decoder> DecoderRegistry::create(Codec::Type codec)
+   {
+      const Entry& entry = entries_()[static_cast<size_t>(codec)];
+      return entry.factory ? entry.factory() : nullptr;
+   }
+
+   std::string DecoderRegistry::audioFileFor(std::string_view track_file, Codec::Type codec)
+   {
+      const Entry& entry = entries_()[static_cast<size_t>(codec)];
+      if (!entry.factory)
+         return std::string();
+
+      // replace the extension of the file name, if any
+      size_t extension_start = track_file.find_last_of("./\\");
+      if (extension_start != std::string_view::npos && track_file[extension_start] == '.')
+         track_file = track_file.substr(0, extension_start);
+
+      std::string audio_file(track_file);
+      audio_file.append(entry.extension);
+      return audio_file;
+   }
+
+}
@@ -0,0 +1,213 @@
+#include "Dsp.h"
+
+#include <initializer_list>
+
+#if defined(IPLAYER_DSP_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+   namespace Scalar
+   {
+      void int16ToFloat(const void* source, float* destination, size_t count)
+      {
+         const unsigned char* bytes = static_cast<const unsigned char*>(source);
+
+         for (size_t idx = 0; idx < count; idx++, bytes += 2)
+         {
+            auto value = static_cast<std::int16_t>(bytes[0] | (bytes[1] << 8));
+            destination[idx] = value * (1.0f / 32768.0f);
+         }
+      }
+
+      void int24ToFloat(const void* source, float* destination, size_t count)
+      {
+         const unsigned char* bytes = static_cast<const unsigned char*>(source);
+
+         for (size_t idx = 0; idx < count; idx++, bytes += 3)
+         {
+            // assembled in the top bytes, then shifted back to sign-extend
+            std::uint32_t top = (std::uint32_t(bytes[0]) << 8) | (std::uint32_t(bytes[1]) << 16) | (std::uint32_t(bytes[2]) << 24);
+            destination[idx] = (static_cast<std::int32_t>(top) >> 8) * (1.0f / 8388608.0f);
+         }
+      }
+
+      void int32ToFloat(const void* source, float* destination, size_t count)
+      {
+         const unsigned char* bytes = static_cast<const unsigned char*>(source);
+
+         for (size_t idx = 0; idx < count; idx++, bytes += 4)
+         {
+            std::uint32_t value = bytes[0] | (std::uint32_t(bytes[1]) << 8) | (std::uint32_t(bytes[2]) << 16) | (std::uint32_t(bytes[3]) << 24);
+            destination[idx] = static_cast<float>(static_cast<std::int32_t>(value)) * (1.0f / 2147483648.0f);
+         }
+      }
+
+      void applyGain(float* samples, size_t frames, unsigned channels, float start_gain, float gain_step)
+      {
+         for (size_t frame = 0; frame < frames; frame++)
+         {
+            float gain = start_gain + static_cast<float>(frame) * gain_step;
+
+            for (unsigned channel = 0; channel < channels; channel++)
+               samples[frame * channels + channel] *= gain;
+         }
+      }
+
+      void mixGain(const float* source, float* destination, size_t frames, unsigned channels, float start_gain, float gain_step)
+      {
+         for (size_t frame = 0; frame < frames; frame++)
+         {
+            float gain = start_gain + static_cast<float>(frame) * gain_step;
+
+            for (unsigned channel = 0; channel < channels; channel++)
+               destination[frame * channels + channel] += source[frame * channels + channel] * gain;
+         }
+      }
+
+      void downmixStereo(const float* source, float* destination, size_t frames)
+      {
+         for (size_t frame = 0; frame < frames; frame++)
+            destination[frame] = (source[2 * frame] + source[2 * frame + 1]) * 0.5f;
+      }
+   }
+
+   constexpr MusicPlayer::Dsp::Kernels kScalarKernels = {
+      "scalar",
+      &Scalar::int16ToFloat,
+      &Scalar::int24ToFloat,
+      &Scalar::int32ToFloat,
+      &Scalar::applyGain,
+      &Scalar::mixGain,
+      &Scalar::downmixStereo
+   };
+}
+
+#ifdef IPLAYER_DSP_X86
+
+// defined in DspSse2.cpp and DspAvx2.cpp, which are built for their instruction set
+namespace MusicPlayer::Dsp::Sse2
+{
+   void int16ToFloat(const void* source, float* destination, size_t count);
+   void int32ToFloat(const void* source, float* destination, size_t count);
+   void applyGain(float* samples, size_t frames, unsigned channels, float start_gain, float gain_step);
+   void mixGain(const float* source, float* destination, size_t frames, unsigned channels, float start_gain, float gain_step);
+   void downmixStereo(const float* source, float* destination, size_t frames);
+}
+
+namespace MusicPlayer::Dsp::Avx2
+{
+   void int16ToFloat(const void* source, float* destination, size_t count);
+   void int24ToFloat(const void* source, float* destination, size_t count);
+   void int32ToFloat(const void* source, float* destination, size_t count);
+   void applyGain(float* samples, size_t frames, unsigned channels, float start_gain, float gain_step);
+   void mixGain(const float* source, float* destination, size_t frames, unsigned channels, float start_gain, float gain_step);
+   void downmixStereo(const float* source, float* destination, size_t frames);
+}
+
+namespace
+{
+   // SSE2 has no byte shuffle to unpack 24-bit samples
+   constexpr MusicPlayer::Dsp::Kernels kSse2Kernels = {
+      "SSE2",
+      &MusicPlayer::Dsp::Sse2::int16ToFloat,
+      &Scalar::int24ToFloat,
+      &MusicPlayer::Dsp::Sse2::int32ToFloat,
+      &MusicPlayer::Dsp::Sse2::applyGain,
+      &MusicPlayer::Dsp::Sse2::mixGain,
+      &MusicPlayer::Dsp::Sse2::downmixStereo
+   };
+
+   constexpr MusicPlayer::Dsp::Kernels kAvx2Kernels = {
+      "AVX2",
+      &MusicPlayer::Dsp::Avx2::int16ToFloat,
+      &MusicPlayer::Dsp::Avx2::int24ToFloat,
+      &MusicPlayer::Dsp::Avx2::int32ToFloat,
+      &MusicPlayer::Dsp::Avx2::applyGain,
+      &MusicPlayer::Dsp::Avx2::mixGain,
+      &MusicPlayer::Dsp::Avx2::downmixStereo
+   };
+
+   bool cpuSupportsAvx2()
+   {
+#ifdef _MSC_VER
+      int info[4];
+
+      __cpuid(info, 0);
+      if (info[0] < 7)
+         return false;
+
+      // the operating system must also save the AVX registers
+      __cpuid(info, 1);
+      bool has_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+
+      __cpuidex(info, 7, 0);
+      return has_avx && (info[1] & (1 << 5));
+#else
+      return __builtin_cpu_supports("avx2");
+#endif
+   }
+}
+
+#endif
+
+namespace MusicPlayer::Dsp
+{
+
+   bool isSupported(InstructionSet instruction_set)
+   {
+      switch (instruction_set)
+      {
+      case InstructionSet::Scalar:
+         return true;
+#ifdef IPLAYER_DSP_X86
+      case InstructionSet::SSE2:
+         // part of the x86-64 baseline
+         return true;
+      case InstructionSet::AVX2:
+      {
+         static const bool supported = cpuSupportsAvx2();
+         return supported;
+      }
+#endif
+      default:
+         return false;
+      }
+   }
+
+   const Kernels* kernelsFor(InstructionSet instruction_set)
+   {
+      if (!isSupported(instruction_set))
+         return nullptr;
+
+      switch (instruction_set)
+      {
+#ifdef IPLAYER_DSP_X86
+      case InstructionSet::SSE2:
+         return &kSse2Kernels;
+      case InstructionSet::AVX2:
+         return &kAvx2Kernels;
+#endif
+      default:
+         return &kScalarKernels;
+      }
+   }
+
+   const Kernels& kernels()
+   {
+      static const Kernels& best = []() -> const Kernels&
+      {
+         for (InstructionSet instruction_set : { InstructionSet::AVX2, InstructionSet::SSE2 })
+         {
+            if (const Kernels* supported = kernelsFor(instruction_set))
+               return *supported;
+         }
+
+         return kScalarKernels;
+      }();
+
+      return best;
+   }
+
+}
@@ -0,0 +1,181 @@
+// Kernels for the AVX2 instruction set. This file is the only one built with AVX2 enabled, and must not
+// use inline functions shared with other files, whose AVX2 version could be picked by the linker.
+//
+// The tails that do not fill a vector use the same expressions as the scalar kernels.
+
+#include "Dsp.h"
+
+#include <immintrin.h>
+
+namespace MusicPlayer::Dsp::Avx2
+{
+
+   void int16ToFloat(const void* source, float* destination, size_t count)
+   {
+      const unsigned char* bytes = static_cast<const unsigned char*>(source);
+      const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+
+      size_t idx(0);
+      for (; idx + 8 <= count; idx += 8)
+      {
+         __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 2 * idx));
+         __m256i samples = _mm256_cvtepi16_epi32(packed);
+         _mm256_storeu_ps(destination + idx, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+      }
+
+      for (; idx < count; idx++)
+      {
+         auto value = static_cast<std::int16_t>(bytes[2 * idx] | (bytes[2 * idx + 1] << 8));
+         destination[idx] = value * (1.0f / 32768.0f);
+      }
+   }
+
+   void int24ToFloat(const void* source, float* destination, size_t count)
+   {
+      const unsigned char* bytes = static_cast<const unsigned char*>(source);
+      const __m256 scale = _mm256_set1_ps(1.0f / 8388608.0f);
+
+      // moves the 3 bytes of each of 4 samples to the top of a 32-bit lane, zeroing the lowest byte
+      const __m256i unpack = _mm256_setr_epi8(
+         -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+         -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+      // each 16-byte load uses 12 bytes: the last loads stop 4 bytes before the end of the samples
+      size_t idx(0);
+      for (; idx + 10 <= count; idx += 8)
+      {
+         const unsigned char* first = bytes + 3 * idx;
+
+         __m256i packed = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 12)), 1);
+
+         __m256i samples = _mm256_srai_epi32(_mm256_shuffle_epi8(packed, unpack), 8);
+         _mm256_storeu_ps(destination + idx, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+      }
+
+      for (; idx < count; idx++)
+      {
+         const unsigned char* sample = bytes + 3 * idx;
+         std::uint32_t top = (std::uint32_t(sample[0]) << 8) | (std::uint32_t(sample[1]) << 16) | (std::uint32_t(sample[2]) << 24);
+         destination[idx] = (static_cast<std::int32_t>(top) >> 8) * (1.0f / 8388608.0f);
+      }
+   }
+
+   void int32ToFloat(const void* source, float* destination, size_t count)
+   {
+      const unsigned char* bytes = static_cast<const unsigned char*>(source);
+      const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+
+      size_t idx(0);
+      for (; idx + 8 <= count; idx += 8)
+      {
+         __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + 4 * idx));
+         _mm256_storeu_ps(destination + idx, _mm256_mul_ps(_mm256_cvtepi32_ps(packed), scale));
+      }
+
+      for (; idx < count; idx++)
+      {
+         const unsigned char* sample = bytes + 4 * idx;
+         std::uint32_t value = sample[0] | (std::uint32_t(sample[1]) << 8) | (std::uint32_t(sample[2]) << 16) | (std::uint32_t(sample[3]) << 24);
+         destination[idx] = static_cast<float>(static_cast<std::int32_t>(value)) * (1.0f / 2147483648.0f);
+      }
+   }
+
+   void applyGain(float* samples, size_t frames, unsigned channels, float start_gain, float gain_step)
+   {
+      const __m256 start = _mm256_set1_ps(start_gain);
+      const __m256 step = _mm256_set1_ps(gain_step);
+
+      size_t frame(0);
+
+      if (channels == 1)
+      {
+         for (; frame + 8 <= frames; frame += 8)
+         {
+            __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(frame)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            __m256 gains = _mm256_add_ps(start, _mm256_mul_ps(_mm256_cvtepi32_ps(indices), step));
+            _mm256_storeu_ps(samples + frame, _mm256_mul_ps(_mm256_loadu_ps(samples + frame), gains));
+         }
+      }
+      else if (channels == 2)
+      {
+         for (; frame + 4 <= frames; frame += 4)
+         {
+            __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(frame)), _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+            __m256 gains = _mm256_add_ps(start, _mm256_mul_ps(_mm256_cvtepi32_ps(indices), step));
+            _mm256_storeu_ps(samples + 2 * frame, _mm256_mul_ps(_mm256_loadu_ps(samples + 2 * frame), gains));
+         }
+      }
+
+      for (; frame < frames; frame++)
+      {
+         float gain = start_gain + static_cast<float>(frame) * gain_step;
+
+         for (unsigned channel = 0; channel < channels; channel++)
+            samples[frame * channels + channel] *= gain;
+      }
+   }
+
+   void mixGain(const float* source, float* destination, size_t frames, unsigned channels, float start_gain, float gain_step)
+   {
+      const __m256 start = _mm256_set1_ps(start_gain);
+      const __m256 step = _mm256_set1_ps(gain_step);
+
+      size_t frame(0);
+
+      if (channels == 1)
+      {
+         for (; frame + 8 <= frames; frame += 8)
+         {
+            __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(frame)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            __m256 gains = _mm256_add_ps(start, _mm256_mul_ps(_mm256_cvtepi32_ps(indices), step));
+            __m256 mixed = _mm256_add_ps(_mm256_loadu_ps(destination + frame), _mm256_mul_ps(_mm256_loadu_ps(source + frame), gains));
+            _mm256_storeu_ps(destination + frame, mixed);
+         }
+      }
+      else if (channels == 2)
+      {
+         for (; frame + 4 <= frames; frame += 4)
+         {
+            __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(frame)), _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+            __m256 gains = _mm256_add_ps(start, _mm256_mul_ps(_mm256_cvtepi32_ps(indices), step));
+            __m256 mixed = _mm256_add_ps(_mm256_loadu_ps(destination + 2 * frame), _mm256_mul_ps(_mm256_loadu_ps(source + 2 * frame), gains));
+            _mm256_storeu_ps(destination + 2 * frame, mixed);
+         }
+      }
+
+      for (; frame < frames; frame++)
+      {
+         float gain = start_gain + static_cast<float>(frame) * gain_step;
+
+         for (unsigned channel = 0; channel < channels; channel++)
+            destination[frame * channels + channel] += source[frame * channels + channel] * gain;
+      }
+   }
+
+   void downmixStereo(const float* source, float* destination, size_t frames)
+   {
+      const __m256 half = _mm256_set1_ps(0.5f);
+
+      size_t frame(0);
+      for (; frame + 8 <= frames; frame += 8)
+      {
+         __m256 first = _mm256_loadu_ps(source + 2 * frame);
+         __m256 second = _mm256_loadu_ps(source + 2 * frame + 8);
+
+         // the shuffles work within 128-bit lanes: the pairs of frames are put back in order afterwards
+         __m256 left = _mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+         __m256 right = _mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+
+         __m256 mixed = _mm256_mul_ps(_mm256_add_ps(left, right), half);
+         mixed = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mixed), _MM_SHUFFLE(3, 1, 2, 0)));
+
+         _mm256_storeu_ps(destination + frame, mixed);
+      }
+
+      for (; frame < frames; frame++)
+         destination[frame] = (source[2 * frame] + source[2 * frame + 1]) * 0.5f;
+   }
+
+}
@@ -0,0 +1,149 @@
+// Kernels for the SSE2 instruction set, the baseline of x86-64 processors.
+//
+// The tails that do not fill a vector use the same expressions as the scalar kernels.
+
+#include "Dsp.h"
+
+#include <emmintrin.h>
+
+namespace MusicPlayer::Dsp::Sse2
+{
+
+   void int16ToFloat(const void* source, float* destination, size_t count)
+   {
+      const unsigned char* bytes = static_cast<const unsigned char*>(source);
+      const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+
+      size_t idx(0);
+      for (; idx + 8 <= count; idx += 8)
+      {
+         __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 2 * idx));
+
+         // each sample is duplicated in a 32-bit lane, then shifted down to sign-extend it
+         __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+         __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+
+         _mm_storeu_ps(destination + idx, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+         _mm_storeu_ps(destination + idx + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+      }
+
+      for (; idx < count; idx++)
+      {
+         auto value = static_cast<std::int16_t>(bytes[2 * idx] | (bytes[2 * idx + 1] << 8));
+         destination[idx] = value * (1.0f / 32768.0f);
+      }
+   }
+
+   void int32ToFloat(const void* source, float* destination, size_t count)
+   {
+      const unsigned char* bytes = static_cast<const unsigned char*>(source);
+      const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+
+      size_t idx(0);
+      for (; idx + 4 <= count; idx += 4)
+      {
+         __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 4 * idx));
+         _mm_storeu_ps(destination + idx, _mm_mul_ps(_mm_cvtepi32_ps(packed), scale));
+      }
+
+      for (; idx < count; idx++)
+      {
+         const unsigned char* sample = bytes + 4 * idx;
+         std::uint32_t value = sample[0] | (std::uint32_t(sample[1]) << 8) | (std::uint32_t(sample[2]) << 16) | (std::uint32_t(sample[3]) << 24);
+         destination[idx] = static_cast<float>(static_cast<std::int32_t>(value)) * (1.0f / 2147483648.0f);
+      }
+   }
+
+   void applyGain(float* samples, size_t frames, unsigned channels, float start_gain, float gain_step)
+   {
+      const __m128 start = _mm_set1_ps(start_gain);
+      const __m128 step = _mm_set1_ps(gain_step);
+
+      size_t frame(0);
+
+      if (channels == 1)
+      {
+         for (; frame + 4 <= frames; frame += 4)
+         {
+            __m128i indices = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(frame)), _mm_setr_epi32(0, 1, 2, 3));
+            __m128 gains = _mm_add_ps(start, _mm_mul_ps(_mm_cvtepi32_ps(indices), step));
+            _mm_storeu_ps(samples + frame, _mm_mul_ps(_mm_loadu_ps(samples + frame), gains));
+         }
+      }
+      else if (channels == 2)
+      {
+         for (; frame + 2 <= frames; frame += 2)
+         {
+            __m128i indices = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(frame)), _mm_setr_epi32(0, 0, 1, 1));
+            __m128 gains = _mm_add_ps(start, _mm_mul_ps(_mm_cvtepi32_ps(indices), step));
+            _mm_storeu_ps(samples + 2 * frame, _mm_mul_ps(_mm_loadu_ps(samples + 2 * frame), gains));
+         }
+      }
+
+      for (; frame < frames; frame++)
+      {
+         float gain = start_gain + static_cast<float>(frame) * gain_step;
+
+         for (unsigned channel = 0; channel < channels; channel++)
+            samples[frame * channels + channel] *= gain;
+      }
+   }
+
+   void mixGain(const float* source, float* destination, size_t frames, unsigned channels, float start_gain, float gain_step)
+   {
+      const __m128 start = _mm_set1_ps(start_gain);
+      const __m128 step = _mm_set1_ps(gain_step);
+
+      size_t frame(0);
+
+      if (channels == 1)
+      {
+         for (; frame + 4 <= frames; frame += 4)
+         {
+            __m128i indices = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(frame)), _mm_setr_epi32(0, 1, 2, 3));
+            __m128 gains = _mm_add_ps(start, _mm_mul_ps(_mm_cvtepi32_ps(indices), step));
+            __m128 mixed = _mm_add_ps(_mm_loadu_ps(destination + frame), _mm_mul_ps(_mm_loadu_ps(source + frame), gains));
+            _mm_storeu_ps(destination + frame, mixed);
+         }
+      }
+      else if (channels == 2)
+      {
+         for (; frame + 2 <= frames; frame += 2)
+         {
+            __m128i indices = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(frame)), _mm_setr_epi32(0, 0, 1, 1));
+            __m128 gains = _mm_add_ps(start, _mm_mul_ps(_mm_cvtepi32_ps(indices), step));
+            __m128 mixed = _mm_add_ps(_mm_loadu_ps(destination + 2 * frame), _mm_mul_ps(_mm_loadu_ps(source + 2 * frame), gains));
+            _mm_storeu_ps(destination + 2 * frame, mixed);
+         }
+      }
+
+      for (; frame < frames; frame++)
+      {
+         float gain = start_gain + static_cast<float>(frame) * gain_step;
+
+         for (unsigned channel = 0; channel < channels; channel++)
+            destination[frame * channels + channel] += source[frame * channels + channel] * gain;
+      }
+   }
+
+   void downmixStereo(const float* source, float* destination, size_t frames)
+   {
+      const __m128 half = _mm_set1_ps(0.5f);
+
+      size_t frame(0);
+      for (; frame + 4 <= frames; frame += 4)
+      {
+         __m128 first = _mm_loadu_ps(source + 2 * frame);
+         __m128 second = _mm_loadu_ps(source + 2 * frame + 4);
+
+         __m128 left = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+         __m128 right = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+
+         _mm_storeu_ps(destination + frame, _mm_mul_ps(_mm_add_ps(left, right), half));
+      }
+
+      for (; frame < frames; frame++)
+         destination[frame] = (source[2 * frame] + source[2 * frame + 1]) * 0.5f;
+   }
+
+}
@@ -0,0 +1,513 @@
+#include "FlacDecoder.h"
+
+#include <cstring>
+
+namespace
+{
+   /**
+    * \brief Reads big-endian bit fields from a buffer, most significant bit first.
+    *
+    * Reading past the end of the buffer returns zeros and sets the overrun flag.
+    */
+   class BitReader
+   {
+   public:
+      BitReader(const unsigned char* data, size_t size, size_t byte_offset) :
+         data_(data),
+         bit_count_(size * 8),
+         bit_position_(byte_offset * 8),
+         overrun_(false)
+      {
+      }
+
+      std::uint32_t read(unsigned bit_count)
+      {
+         if (bit_position_ + bit_count > bit_count_)
+         {
+            overrun_ = true;
+            bit_position_ = bit_count_;
+            return 0;
+         }
+
+         std::uint32_t value(0);
+         while (bit_count > 0)
+         {
+            unsigned available = 8 - (bit_position_ & 7);
+            unsigned taken = available < bit_count ? available : bit_count;
+            unsigned bits = (data_[bit_position_ >> 3] >> (available - taken)) & ((1u << taken) - 1);
+
+            value = (value << taken) | bits;
+            bit_count -= taken;
+            bit_position_ += taken;
+         }
+
+         return value;
+      }
+
+      std::int32_t readSigned(unsigned bit_count)
+      {
+         if (bit_count == 0)
+            return 0;
+
+         // align the value on the top bits to sign-extend it
+         std::uint32_t value = read(bit_count) << (32 - bit_count);
+         return static_cast<std::int32_t>(value) >> (32 - bit_count);
+      }
+
+      // counts the zero bits before the next one bit
+      std::uint32_t readUnary()
+      {
+         std::uint32_t zeros(0);
+
+         while (bit_position_ < bit_count_)
+         {
+            unsigned available = 8 - (bit_position_ & 7);
+            unsigned bits = data_[bit_position_ >> 3] & ((1u << available) - 1);
+
+            if (bits == 0)
+            {
+               zeros += available;
+               bit_position_ += available;
+               continue;
+            }
+
+            // position of the highest one bit among the available ones
+            unsigned leading = 0;
+            while (!(bits & (1u << (available - 1 - leading))))
+               leading++;
+
+            bit_position_ += leading + 1;
+            return zeros + leading;
+         }
+
+         overrun_ = true;
+         return zeros;
+      }
+
+      void alignToByte() { bit_position_ = (bit_position_ + 7) & ~static_cast<size_t>(7); }
+
+      size_t bytePosition() const { return bit_position_ >> 3; }
+      bool hasOverrun() const { return overrun_; }
+
+   private:
+      const unsigned char* data_;
+      size_t bit_count_;
+      size_t bit_position_;
+      bool overrun_;
+   };
+
+   std::uint8_t crc8(const unsigned char* bytes, size_t size)
+   {
+      std::uint8_t crc(0);
+
+      for (size_t idx = 0; idx < size; idx++)
+      {
+         crc ^= bytes[idx];
+         for (int bit = 0; bit < 8; bit++)
+            crc = static_cast<std::uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+      }
+
+      return crc;
+   }
+
+   enum ChannelAssignment : unsigned
+   {
+      kLeftSide = 8,
+      kRightSide = 9,
+      kMidSide = 10
+   };
+
+   constexpr unsigned kMaxBitsPerSample = 24;
+   constexpr size_t kStreamInfoSize = 34;
+
+   bool decodeResidual(BitReader& reader, unsigned predictor_order, size_t block_size, std::int32_t* residual)
+   {
+      unsigned method = reader.read(2);
+      if (method > 1)
+         return false;
+
+      const unsigned parameter_bits = method == 0 ? 4 : 5;
+      const unsigned escape_parameter = (1u << parameter_bits) - 1;
+
+      unsigned partition_order = reader.read(4);
+      size_t partition_count = size_t(1) << partition_order;
+      size_t partition_size = block_size >> partition_order;
+
+      if (partition_size * partition_count != block_size || partition_size < predictor_order)
+         return false;
+
+      size_t sample(predictor_order);
+      for (size_t partition = 0; partition < partition_count; partition++)
+      {
+         size_t end = (partition + 1) * partition_size;
+         unsigned parameter = reader.read(parameter_bits);
+
+         if (parameter == escape_parameter)
+         {
+            // unencoded partition
+            unsigned raw_bits = reader.read(5);
+            for (; sample < end; sample++)
+               residual[sample] = reader.readSigned(raw_bits);
+            continue;
+         }
+
+         for (; sample < end; sample++)
+         {
+            std::uint32_t folded = (reader.readUnary() << parameter) | reader.read(parameter);
+            residual[sample] = static_cast<std::int32_t>(folded >> 1) ^ -static_cast<std::int32_t>(folded & 1);
+         }
+
+         if (reader.hasOverrun())
+            return false;
+      }
+
+      return !reader.hasOverrun();
+   }
+
+   bool decodeSubframe(BitReader& reader, unsigned bits_per_sample, size_t block_size, std::int32_t* samples)
+   {
+      if (reader.read(1) != 0)
+         return false;
+
+      unsigned type = reader.read(6);
+
+      unsigned wasted_bits(0);
+      if (reader.read(1))
+         wasted_bits = reader.readUnary() + 1;
+
+      if (wasted_bits >= bits_per_sample)
+         return false;
+      bits_per_sample -= wasted_bits;
+
+      if (type == 0)
+      {
+         // constant
+         std::int32_t value = reader.readSigned(bits_per_sample);
+         for (size_t sample = 0; sample < block_size; sample++)
+            samples[sample] = value;
+      }
+      else if (type == 1)
+      {
+         // verbatim
+         for (size_t sample = 0; sample < block_size; sample++)
+            samples[sample] = reader.readSigned(bits_per_sample);
+      }
+      else if (type >= 8 && type <= 12)
+      {
+         // fixed polynomial predictor
+         unsigned order = type - 8;
+         if (order > block_size)
+            return false;
+
+         for (unsigned sample = 0; sample < order; sample++)
+            samples[sample] = reader.readSigned(bits_per_sample);
+
+         if (!decodeResidual(reader, order, block_size, samples))
+            return false;
+
+         // the residuals are replaced in place by the predicted samples
+         std::int32_t* s = samples;
+         switch (order)
+         {
+         case 1:
+            for (size_t idx = 1; idx < block_size; idx++)
+               s[idx] += s[idx - 1];
+            break;
+         case 2:
+            for (size_t idx = 2; idx < block_size; idx++)
+               s[idx] += 2 * s[idx - 1] - s[idx - 2];
+            break;
+         case 3:
+            for (size_t idx = 3; idx < block_size; idx++)
+               s[idx] += 3 * s[idx - 1] - 3 * s[idx - 2] + s[idx - 3];
+            break;
+         case 4:
+            for (size_t idx = 4; idx < block_size; idx++)
+               s[idx] += 4 * s[idx - 1] - 6 * s[idx - 2] + 4 * s[idx - 3] - s[idx - 4];
+            break;
+         default:
+            break;
+         }
+      }
+      else if (type >= 32)
+      {
+         // linear predictor
+         unsigned order = type - 31;
+         if (order > block_size)
+            return false;
+
+         for (unsigned sample = 0; sample < order; sample++)
+            samples[sample] = reader.readSigned(bits_per_sample);
+
+         unsigned precision = reader.read(4) + 1;
+         if (precision == 16)
+            return false;
+
+         int shift = reader.readSigned(5);
+         if (shift < 0)
+            return false;
+
+         std::int32_t coefficients[32];
+         for (unsigned idx = 0; idx < order; idx++)
+            coefficients[idx] = reader.readSigned(precision);
+
+         if (!decodeResidual(reader, order, block_size, samples))
+            return false;
+
+         for (size_t idx = order; idx < block_size; idx++)
+         {
+            std::int64_t prediction(0);
+            for (unsigned coefficient = 0; coefficient < order; coefficient++)
+               prediction += static_cast<std::int64_t>(coefficients[coefficient]) * samples[idx - 1 - coefficient];
+
+            samples[idx] += static_cast<std::int32_t>(prediction >> shift);
+         }
+      }
+      else
+      {
+         return false;
+      }
+
+      if (wasted_bits > 0)
+      {
+         for (size_t sample = 0; sample < block_size; sample++)
+            samples[sample] = static_cast<std::int32_t>(static_cast<std::uint32_t>(samples[sample]) << wasted_bits);
+      }
+
+      return !reader.hasOverrun();
+   }
+}
+
+namespace MusicPlayer
+{
+
+   bool FlacDecoder::open(const std::string& file_name)
+   {
+      if (!file_.open(file_name))
+         return fail_("File \"" + file_name + "\" could not be opened.");
+
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file_.data());
+      const size_t size = file_.size();
+
+      // files converted from MP3 sometimes keep their ID3v2 tag
+      size_t pos(0);
+      if (size >= 10 && std::memcmp(bytes, "ID3", 3) == 0)
+      {
+         size_t tag_size = (size_t(bytes[6] & 0x7F) << 21) | (size_t(bytes[7] & 0x7F) << 14) | (size_t(bytes[8] & 0x7F) << 7) | (bytes[9] & 0x7F);
+         pos = 10 + tag_size + (bytes[5] & 0x10 ? 10 : 0);
+      }
+
+      if (pos + 4 > size || std::memcmp(bytes + pos, "fLaC", 4) != 0)
+         return fail_("File \"" + file_name + "\" is not a FLAC file.");
+      pos += 4;
+
+      bool has_stream_info(false);
+      bool is_last(false);
+
+      while (!is_last)
+      {
+         if (pos + 4 > size)
+            return fail_("File \"" + file_name + "\" has truncated metadata.");
+
+         is_last = (bytes[pos] & 0x80) != 0;
+         unsigned type = bytes[pos] & 0x7F;
+         size_t length = (size_t(bytes[pos + 1]) << 16) | (size_t(bytes[pos + 2]) << 8) | bytes[pos + 3];
+         pos += 4;
+
+         if (pos + length > size)
+            return fail_("File \"" + file_name + "\" has truncated metadata.");
+
+         if (type == 0 && length >= kStreamInfoSize)
+         {
+            BitReader reader(bytes, pos + length, pos);
+
+            reader.read(16);
+            block_capacity_ = reader.read(16);
+            reader.read(24);
+            reader.read(24);
+            format_.sample_rate = reader.read(20);
+            format_.channels = reader.read(3) + 1;
+            format_.bits_per_sample = reader.read(5) + 1;
+            total_frames_ = (std::uint64_t(reader.read(4)) << 32) | reader.read(32);
+
+            has_stream_info = true;
+         }
+
+         pos += length;
+      }
+
+      if (!has_stream_info)
+         return fail_("File \"" + file_name + "\" has no stream information.");
+
+      if (format_.bits_per_sample < 4 || format_.bits_per_sample > kMaxBitsPerSample || format_.sample_rate == 0)
+         return fail_("File \"" + file_name + "\" uses an unsupported FLAC sample format.");
+
+      next_frame_offset_ = pos;
+      block_frames_ = 0;
+      block_position_ = 0;
+      decoded_frames_ = 0;
+      scale_ = 1.0f / static_cast<float>(1u << (format_.bits_per_sample - 1));
+
+      // the maximum block size of the stream may be unset, frames then grow the buffer
+      if (block_capacity_ < 16)
+         block_capacity_ = 4096;
+      block_.assign(block_capacity_ * format_.channels, 0);
+
+      return true;
+   }
+
+   size_t FlacDecoder::read(float* samples, size_t frames)
+   {
+      const unsigned channels = format_.channels;
+      size_t decoded(0);
+
+      while (decoded < frames)
+      {
+         if (block_position_ == block_frames_ && !decodeFrame_())
+            break;
+
+         size_t count = block_frames_ - block_position_;
+         if (count > frames - decoded)
+            count = frames - decoded;
+
+         for (unsigned channel = 0; channel < channels; channel++)
+         {
+            const std::int32_t* source = block_.data() + channel * block_capacity_ + block_position_;
+            float* destination = samples + decoded * channels + channel;
+
+            for (size_t idx = 0; idx < count; idx++)
+               destination[idx * channels] = source[idx] * scale_;
+         }
+
+         block_position_ += count;
+         decoded += count;
+      }
+
+      return decoded;
+   }
+
+   bool FlacDecoder::decodeFrame_()
+   {
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file_.data());
+      const size_t size = file_.size();
+
+      // trailing tags after the last frame are ignored
+      if (hasFailed() || next_frame_offset_ + 2 > size || (total_frames_ > 0 && decoded_frames_ >= total_frames_))
+         return false;
+
+      const size_t frame_start = next_frame_offset_;
+      BitReader reader(bytes, size, frame_start);
+
+      if (reader.read(14) != 0x3FFE)
+         return fail_("Invalid FLAC frame synchronization code.");
+
+      reader.read(2);
+      unsigned block_size_code = reader.read(4);
+      unsigned sample_rate_code = reader.read(4);
+      unsigned channel_assignment = reader.read(4);
+      unsigned sample_size_code = reader.read(3);
+      reader.read(1);
+
+      // frame or sample number, coded like UTF-8
+      std::uint32_t first_byte = reader.read(8);
+      unsigned continuation_bytes(0);
+      while (continuation_bytes < 7 && (first_byte & (0x80u >> continuation_bytes)))
+         continuation_bytes++;
+      if (continuation_bytes == 1)
+         return fail_("Invalid FLAC frame number.");
+      if (continuation_bytes > 1)
+         continuation_bytes--;
+      for (unsigned idx = 0; idx < continuation_bytes; idx++)
+         reader.read(8);
+
+      size_t block_size(0);
+      if (block_size_code == 1)
+         block_size = 192;
+      else if (block_size_code >= 2 && block_size_code <= 5)
+         block_size = size_t(576) << (block_size_code - 2);
+      else if (block_size_code == 6)
+         block_size = reader.read(8) + 1;
+      else if (block_size_code == 7)
+         block_size = reader.read(16) + 1;
+      else if (block_size_code >= 8)
+         block_size = size_t(256) << (block_size_code - 8);
+
+      if (sample_rate_code == 12)
+         reader.read(8);
+      else if (sample_rate_code == 13 || sample_rate_code == 14)
+         reader.read(16);
+
+      size_t header_size = reader.bytePosition() - frame_start;
+      std::uint32_t header_crc = reader.read(8);
+
+      if (reader.hasOverrun() || crc8(bytes + frame_start, header_size) != header_crc)
+         return fail_("Corrupted FLAC frame header.");
+
+      static constexpr unsigned kSampleSizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+      unsigned bits_per_sample = sample_size_code == 0 ? format_.bits_per_sample : kSampleSizes[sample_size_code];
+
+      unsigned channels = channel_assignment < 8 ? channel_assignment + 1 : 2;
+
+      if (block_size == 0 || channel_assignment > kMidSide || channels != format_.channels
+         || bits_per_sample == 0 || bits_per_sample > kMaxBitsPerSample)
+         return fail_("Unsupported FLAC frame format.");
+
+      if (block_size > block_capacity_)
+      {
+         block_capacity_ = block_size;
+         block_.assign(block_capacity_ * channels, 0);
+      }
+
+      for (unsigned channel = 0; channel < channels; channel++)
+      {
+         // the side channel needs one more bit
+         bool is_side = (channel_assignment == kLeftSide && channel == 1)
+            || (channel_assignment == kRightSide && channel == 0)
+            || (channel_assignment == kMidSide && channel == 1);
+
+         if (!decodeSubframe(reader, bits_per_sample + (is_side ? 1 : 0), block_size, block_.data() + channel * block_capacity_))
+            return fail_("Corrupted FLAC subframe.");
+      }
+
+      std::int32_t* first = block_.data();
+      std::int32_t* second = block_.data() + block_capacity_;
+
+      switch (channel_assignment)
+      {
+      case kLeftSide:
+         for (size_t idx = 0; idx < block_size; idx++)
+            second[idx] = first[idx] - second[idx];
+         break;
+      case kRightSide:
+         for (size_t idx = 0; idx < block_size; idx++)
+            first[idx] += second[idx];
+         break;
+      case kMidSide:
+         for (size_t idx = 0; idx < block_size; idx++)
+         {
+            std::int32_t side = second[idx];
+            std::int32_t mid = static_cast<std::int32_t>(static_cast<std::uint32_t>(first[idx]) << 1) | (side & 1);
+            first[idx] = (mid + side) >> 1;
+            second[idx] = (mid - side) >> 1;
+         }
+         break;
+      default:
+         break;
+      }
+
+      // the frame ends with a CRC-16 of its contents
+      reader.alignToByte();
+      reader.read(16);
+
+      if (reader.hasOverrun())
+         return fail_("Truncated FLAC frame.");
+
+      next_frame_offset_ = reader.bytePosition();
+      block_frames_ = block_size;
+      block_position_ = 0;
+      decoded_frames_ += block_size;
+
+      return true;
+   }
+
+}
@@ -19,7 +19,8 @@ using std::endl;
 //        { "repeat", &Shell::repeat_ },
 //        { "remove_dupes", &Shell::removeDuplicates_ },
 //        { "change_directory", &Shell::cd_ },
-//        { "load", &Shell::loadPlaylist_ }
+//        { "load", &Shell::loadPlaylist_ },
+//        { "exit", &Shell::exit_ }
 
 namespace {
     void addUsage(std::stringstream& out, const char* command, const int lines, ...) {
@@ -41,7 +42,7 @@ namespace {
 }
 
 namespace MusicPlayer {
-    string HelpMessages::forInstruction(const string& instruction) {
+    string HelpMessages::forInstruction(std::string_view instruction) {
         std::stringstream message_builder;
 
         message_builder << "Usage:" << endl;
@@ -61,33 +62,99 @@ namespace MusicPlayer {
                 "The file names provided can be paths, and must be without whitespaces."
             );
         }
+        else if(instruction == "add_dir") {
+            addUsage(message_builder, "add_dir <directory> [--recursive]", 2, "Adds the tracks of all *.music files of a directory, and of its subdirectories with --recursive.", "The files are read in parallel and added in name order, the files of a directory before those of its subdirectories.");
+        }
+        else if(instruction == "cache") {
+            addUsage(message_builder, "cache", "Prints the statistics of the metadata cache: its entries and its hits and misses.");
+            addUsage(message_builder, "cache on [<cache file>]", 2, "Opens the metadata cache, by default in the user cache directory. add_track and add_dir then skip the files it knows unchanged.", "A file is known unchanged if its path, size and modification time match. The cache is shared by all sessions of a server.");
+            addUsage(message_builder, "cache off", "Closes the metadata cache.");
+            addUsage(message_builder, "cache compact", "Rewrites the cache file without its replaced entries.");
+        }
         else if(instruction == "remove_track") {
             addUsage(message_builder, "remove_track <track file name> [<track file name> ...]", "Removes all tracks imported from the file name(s) specified.");
             addUsage(message_builder, "remove_track <track position> [<track position> ...]", "Removes the track located at the specified position(s) in the playlist.");
+            addUsage(message_builder, "remove_track <first>-<last> [<first>-<last> ...]", "Removes the tracks located in the specified range(s) of positions, such as 100-2000.");
+        }
+        else if(instruction == "keep") {
+            addUsage(message_builder, "keep <track name, position or range> [<track name, position or range> ...]", 2, "Removes every track of the playlist except the ones specified.", "Ranges of positions are written <first>-<last>, such as 1-1000.");
+        }
+        else if(instruction == "move") {
+            addUsage(message_builder, "move <track position> to <position>", "Moves a track to the specified position in the playlist.");
+            addUsage(message_builder, "move <first>-<last> to <position>", 2, "Moves a range of tracks, keeping their order, so that the first one ends up at the specified position.", "The other tracks keep their order.");
         }
         else if(instruction == "show_track") {
             addUsage(message_builder, "show_track", "Prints detailed infos about the currently selected track.");
             addUsage(message_builder, "show_track <track name or position> [<track name or position> ...]", "Prints detailed infos about the track in the playlist with the specified file name, or at the specified position.");
         }
+        else if(instruction == "view") {
+            addUsage(message_builder, "view", "Prints the tracks of the view, with their position in the playlist.");
+            addUsage(message_builder, "view [by title|duration|codec] [only <codec>] [longer <duration>] [shorter <duration>]", 3, "Defines a view of the playlist, sorted and filtered without changing the playlist.", "Durations are given in seconds or as minutes and seconds, such as 5:00.", "The view follows the tracks added to and removed from the playlist.");
+            addUsage(message_builder, "view off", "Removes the view.");
+        }
         else if(instruction == "show_list") {
             addUsage(message_builder, "show_list", "Prints the playlist contents.");
         }
         else if(instruction == "play") {
-            addUsage(message_builder, "play", "Plays the currently selected track.");
+            addUsage(message_builder, "play", 2, "Plays the currently selected track.", "The audio is read from the file with the track file name and the extension of its codec: *.wav for PCM, *.flac for FLAC.");
         }
         else if(instruction == "pause") {
             addUsage(message_builder, "pause", "Pauses the currently playing track.");
         }
+        else if(instruction == "playback_stats") {
+            addUsage(message_builder, "playback_stats", "Prints the number of frames played, the number of underruns and the latency of the current or last played stream, how many track transitions started from prefetched buffers, and how long the background jobs of each priority waited for a worker.");
+        }
+        else if(instruction == "output") {
+            addUsage(message_builder, "output null [--mono]", "Discards the decoded audio at the pace of an audio device. This is the default output.");
+            addUsage(message_builder, "output file <path> [--mono]", "Writes the decoded audio to a 32-bit float WAVE file, as fast as it is decoded. The following tracks are appended to the same file.");
+            message_builder << "\tWith --mono, stereo tracks are mixed down to mono." << endl;
+        }
+        else if(instruction == "resample") {
+            addUsage(message_builder, "resample", "Prints the output sample rate.");
+            addUsage(message_builder, "resample <rate> [fast|medium|high]", 2, "Resamples all tracks to the given rate in Hz, with the given quality (medium by default).", "Fast uses linear interpolation, medium and high use 16 and 64-tap windowed sinc filters.");
+            addUsage(message_builder, "resample off", "Outputs each track at its own sample rate.");
+        }
+        else if(instruction == "crossfade") {
+            addUsage(message_builder, "crossfade", "Prints the length of the crossfades between tracks.");
+            addUsage(message_builder, "crossfade <seconds>", 2, "Crossfades the end of each track into the start of the next one, over up to 20 seconds.", "Only tracks that follow each other without gap are crossfaded.");
+            addUsage(message_builder, "crossfade off", "Plays the tracks one after the other.");
+        }
+        else if(instruction == "replaygain") {
+            addUsage(message_builder, "replaygain", "Prints whether the loudness of the tracks is normalized.");
+            addUsage(message_builder, "replaygain on [<preamp dB>]", 2, "Applies the ReplayGain of the tracks that have one, plus an optional preamp gain.", "The gain is lowered when the peak of the track would clip. Takes effect from the next track.");
+            addUsage(message_builder, "replaygain off", "Plays the tracks at their original loudness.");
+        }
+        else if(instruction == "volume") {
+            addUsage(message_builder, "volume", "Prints the playback volume.");
+            addUsage(message_builder, "volume <percentage>", "Sets the playback volume, between 0 and 100.");
+        }
+        else if(instruction == "wait") {
+            addUsage(message_builder, "wait", 2, "Waits until the current track has been entirely played.", "The playback then continues with the next track, without gap when it has the same format. Not available in server sessions.");
+        }
         else if(instruction == "prev") {
             addUsage(message_builder, "prev", "Changes the selected track to the previous one on the list.");
             addUsage(message_builder, "prev <number>", "Rewinds the playlist to N tracks before the currently selected one.");
+            addUsage(message_builder, "prev [<number>] (random mode)", "Goes back to the track(s) played before in the shuffle.");
         }
         else if(instruction == "next") {
             addUsage(message_builder, "next", "Changes the selected track to the next one on the list.");
             addUsage(message_builder, "next <number>", "Fast forwards the playlist to N tracks after the currently selected one.");
+            addUsage(message_builder, "next [<number>] (random mode)", 2, "Moves to the next track(s) of the shuffle, in which every track is played once.", "Once every track was played, a new shuffle starts in repeat mode.");
+        }
+        else if(instruction == "queue") {
+            addUsage(message_builder, "queue", "Prints the tracks queued to play next.");
+            addUsage(message_builder, "queue <track name or position> [<track name or position> ...]", 2, "Queues the track(s) after the queued ones.", "The queued tracks play before the playlist order continues from the track selected before them. The playlist itself is unchanged.");
+        }
+        else if(instruction == "queue_next") {
+            addUsage(message_builder, "queue_next <track name or position> [<track name or position> ...]", "Queues the track(s) before the queued ones, to play right after the current track.");
+        }
+        else if(instruction == "dequeue") {
+            addUsage(message_builder, "dequeue", "Clears the queue.");
+            addUsage(message_builder, "dequeue <queue index> [<queue index> ...]", "Removes the track(s) at the specified index(es) of the queue, as printed by \"queue\".");
         }
         else if(instruction == "random") {
-            addUsage(message_builder, "random", "Toggles random mode: the tracks will be played in random order.");
+            addUsage(message_builder, "random", 2, "Toggles random mode: the tracks will be played in random order.", "Every track is played once before any is played again, and the tracks added meanwhile join the shuffle.");
+            addUsage(message_builder, "random <seed>", "Starts a new shuffle from the selected track, in the order given by the seed.");
         }
         else if(instruction == "repeat") {
             addUsage(message_builder, "repeat", "Toggles repeat mode: when going past one end of the playlist, the playback will move to the other end of the playlist.");
@@ -100,10 +167,13 @@ namespace MusicPlayer {
             addUsage(message_builder, "current_directory <path>", "Changes the current directory to the requested location.");
         }
         else if(instruction == "load") {
-            addUsage(message_builder, "load <playlist file>", "Loads a playlist from a *.playlist file.");
+            addUsage(message_builder, "load <playlist file>", 2, "Loads a playlist from a *.playlist text file, a *.iplb binary file or a *.iplj journaled file.", "The format is chosen from the file extension.");
         }
         else if(instruction == "save") {
-            addUsage(message_builder, "save <path>", "Saves a playlist to a file on disk.");
+            addUsage(message_builder, "save <path>", 3, "Saves a playlist to a file on disk.", "Paths ending with .iplb are saved in the compact binary format, other paths in the text format.", "Paths ending with .iplj are journaled: saving again to the file the playlist was saved to or loaded from only appends the changes.");
+        }
+        else if(instruction == "exit") {
+            addUsage(message_builder, "exit", "Exits the music player.");
         }
         else {
             message_builder << "This instruction has no documentation yet." << endl;
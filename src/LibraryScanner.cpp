@@ -0,0 +1,322 @@
+#include "LibraryScanner.h"
+
+#include "MetadataCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <iterator>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+   using MusicPlayer::InternedString;
+   using MusicPlayer::LibraryScanner;
+   using MusicPlayer::MetadataCache;
+   using MusicPlayer::StringPool;
+   using MusicPlayer::ThreadPool;
+   using MusicPlayer::Track;
+
+   namespace fs = std::filesystem;
+
+   // number of track files read by each job
+   constexpr size_t kFilesPerJob = 256;
+
+   // number of jobs listing the directories of a level, per worker
+   constexpr size_t kListingJobsPerWorker = 4;
+
+   struct Directory
+   {
+      fs::path path;
+
+      // sorted by name
+      std::vector<std::string> files;
+      std::vector<fs::path> subdirectories;
+
+      // indexes of the subdirectories in the scanned tree
+      std::vector<size_t> children;
+
+      std::string error;
+   };
+
+   struct ScannedFile
+   {
+      enum class Status
+      {
+         Added,
+         Unreadable,
+         Malformed
+      };
+
+      Status status = Status::Added;
+      InternedString path;
+      Track track;
+      std::string error;
+
+      // whether the track came from the metadata cache, or was parsed and should be stored in it with this stamp
+      bool cached = false;
+      bool parsed = false;
+      MetadataCache::FileStamp stamp;
+   };
+
+   /**
+    * \brief Lists the track files and, if recursive, the subdirectories of a directory.
+    */
+   void listDirectory(Directory& directory, bool recursive)
+   {
+      std::error_code error;
+      fs::directory_iterator entries(directory.path, error);
+
+      for (; !error && entries != fs::directory_iterator(); entries.increment(error))
+      {
+         const fs::directory_entry& entry = *entries;
+         std::error_code status_error;
+
+         if (recursive && entry.is_directory(status_error) && !entry.is_symlink(status_error))
+            directory.subdirectories.push_back(entry.path());
+         else if (entry.path().extension() == LibraryScanner::kTrackExtension && entry.is_regular_file(status_error))
+            directory.files.push_back(entry.path().string());
+      }
+
+      if (error)
+      {
+         directory.error = "Directory \"" + directory.path.string() + "\" could not be listed. (Reason: " + error.message() + ")";
+         return;
+      }
+
+      std::sort(directory.files.begin(), directory.files.end());
+      std::sort(directory.subdirectories.begin(), directory.subdirectories.end());
+   }
+
+   /**
+    * \brief Reads a whole file. Track files are small: most are read with a single system call.
+    *
+    * \param opened Receives whether the file could be opened.
+    * \return false if the file could not be opened or read.
+    */
+   bool readFile(const std::string& file_name, std::string& buffer, bool& opened)
+   {
+      char chunk[4096];
+      buffer.clear();
+
+#ifdef _WIN32
+      std::FILE* file = std::fopen(file_name.c_str(), "rb");
+      opened = file != nullptr;
+      if (!opened)
+         return false;
+
+      size_t read;
+      while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+         buffer.append(chunk, read);
+
+      bool failed = std::ferror(file) != 0;
+      std::fclose(file);
+#else
+      int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+      opened = fd >= 0;
+      if (!opened)
+         return false;
+
+      ssize_t read;
+      while ((read = ::read(fd, chunk, sizeof(chunk))) > 0)
+         buffer.append(chunk, static_cast<size_t>(read));
+
+      bool failed = read < 0;
+      ::close(fd);
+#endif
+
+      return !failed;
+   }
+
+   /**
+    * \brief Reads and parses a track file, unless the metadata cache knows it.
+    *
+    * \param buffer Receives the contents of the file, reused from one file to the next.
+    * \param cache The metadata cache, or nullptr if it is closed.
+    */
+   void readTrackFile(const std::string& file_name, std::string& buffer, MetadataCache* cache, ScannedFile& scanned)
+   {
+      if (cache != nullptr && MetadataCache::getFileStamp(file_name, scanned.stamp))
+      {
+         if (cache->lookup(file_name, scanned.stamp, scanned.track))
+         {
+            scanned.path = StringPool::shared().intern(file_name);
+            scanned.cached = true;
+            return;
+         }
+
+         // stamped before the file is read: if it changes in between, the next lookup misses
+         scanned.parsed = true;
+      }
+
+      bool opened(false);
+
+      if (!readFile(file_name, buffer, opened))
+      {
+         scanned.status = ScannedFile::Status::Unreadable;
+         scanned.error = "File \"" + file_name + (opened ? "\" could not be read." : "\" could not be opened.");
+         return;
+      }
+
+      if (!scanned.track.deserialize(buffer))
+      {
+         scanned.status = ScannedFile::Status::Malformed;
+         scanned.error = "File \"" + file_name + "\" was not imported. (Reason: " + scanned.track.getErrorMessage() + ")";
+         return;
+      }
+
+      scanned.path = StringPool::shared().intern(file_name);
+   }
+
+   void countError(LibraryScanner::ErrorCategory& category, std::string& error)
+   {
+      if (category.count++ == 0)
+         category.first_error = std::move(error);
+   }
+}
+
+namespace MusicPlayer
+{
+
+   bool LibraryScanner::scan(const std::string& directory, bool recursive, Playlist& playlist, Report& report, std::string& error)
+   {
+      return scan(directory, recursive, playlist, report, error, ThreadPool::shared());
+   }
+
+   bool LibraryScanner::scan(const std::string& directory, bool recursive, Playlist& playlist, Report& report, std::string& error, ThreadPool& pool)
+   {
+      auto start = std::chrono::steady_clock::now();
+
+      std::error_code status_error;
+      if (!fs::is_directory(directory, status_error))
+      {
+         error = "The path \"" + directory + "\" is not a directory.";
+         return false;
+      }
+
+      // the tree is listed one level at a time: the directories of a level are known when the previous one is listed
+      std::vector<Directory> directories(1);
+      directories[0].path = directory;
+
+      for (size_t level_start = 0; level_start < directories.size();)
+      {
+         size_t level_end = directories.size();
+         size_t batch_size = (level_end - level_start + pool.size() * kListingJobsPerWorker - 1) / (pool.size() * kListingJobsPerWorker);
+
+         // the jobs only access the directories of the level, which do not move until they complete
+         std::vector<std::future<void>> listings;
+         for (size_t first = level_start; first < level_end; first += batch_size)
+         {
+            size_t last = std::min(first + batch_size, level_end);
+            listings.push_back(pool.submit(ThreadPool::Priority::Background, [&directories, first, last, recursive]()
+               {
+                  for (size_t idx = first; idx < last; idx++)
+                     listDirectory(directories[idx], recursive);
+               }));
+         }
+
+         for (std::future<void>& listing : listings)
+            listing.get();
+
+         for (size_t idx = level_start; idx < level_end; idx++)
+         {
+            for (size_t sub = 0; sub < directories[idx].subdirectories.size(); sub++)
+            {
+               Directory child;
+               child.path = std::move(directories[idx].subdirectories[sub]);
+
+               directories[idx].children.push_back(directories.size());
+               directories.push_back(std::move(child));
+            }
+         }
+
+         level_start = level_end;
+      }
+
+      report.directory_count += directories.size();
+
+      // the files of a directory come before those of its subdirectories
+      std::vector<std::string> files;
+      std::vector<size_t> pending_directories = { 0 };
+
+      while (!pending_directories.empty())
+      {
+         Directory& current = directories[pending_directories.back()];
+         pending_directories.pop_back();
+
+         if (!current.error.empty())
+            countError(report.unlisted_directories, current.error);
+
+         std::move(current.files.begin(), current.files.end(), std::back_inserter(files));
+         pending_directories.insert(pending_directories.end(), current.children.rbegin(), current.children.rend());
+      }
+
+      directories.clear();
+      report.file_count += files.size();
+
+      MetadataCache* cache = MetadataCache::shared().isOpen() ? &MetadataCache::shared() : nullptr;
+
+      std::vector<std::future<std::vector<ScannedFile>>> batches;
+      batches.reserve(files.size() / kFilesPerJob + 1);
+
+      for (size_t first = 0; first < files.size(); first += kFilesPerJob)
+      {
+         size_t last = std::min(first + kFilesPerJob, files.size());
+         batches.push_back(pool.submit(ThreadPool::Priority::Background, [&files, first, last, cache]()
+            {
+               std::vector<ScannedFile> batch(last - first);
+               std::string buffer;
+
+               for (size_t idx = first; idx < last; idx++)
+                  readTrackFile(files[idx], buffer, cache, batch[idx - first]);
+
+               return batch;
+            }));
+      }
+
+      // appended in the order of the files, whatever the order the batches completed in
+      playlist.reserve(playlist.size() + files.size());
+
+      for (std::future<std::vector<ScannedFile>>& pending_batch : batches)
+      {
+         for (ScannedFile& scanned : pending_batch.get())
+         {
+            switch (scanned.status)
+            {
+            case ScannedFile::Status::Added:
+               if (scanned.parsed && cache != nullptr)
+                  cache->store(scanned.path, scanned.stamp, scanned.track);
+
+               playlist.append(scanned.path, std::move(scanned.track));
+               report.added_count++;
+               report.cached_count += scanned.cached ? 1 : 0;
+               break;
+            case ScannedFile::Status::Unreadable:
+               countError(report.unreadable_files, scanned.error);
+               break;
+            case ScannedFile::Status::Malformed:
+               countError(report.malformed_files, scanned.error);
+               break;
+            }
+         }
+      }
+
+      std::string cache_error;
+      if (cache != nullptr && !cache->flush(cache_error))
+         countError(report.cache_writes, cache_error);
+
+      report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      return true;
+   }
+
+}
@@ -0,0 +1,176 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MusicPlayer
+{
+
+   MappedFile::MappedFile() :
+      data_(nullptr), size_(0), is_open_(false)
+#ifdef _WIN32
+      , file_handle_(nullptr), mapping_handle_(nullptr)
+#endif
+   {
+   }
+
+   MappedFile::MappedFile(const std::string& file_name) :
+      MappedFile()
+   {
+      open(file_name);
+   }
+
+   MappedFile::~MappedFile()
+   {
+      close();
+   }
+
+   MappedFile::MappedFile(MappedFile&& other) noexcept :
+      MappedFile()
+   {
+      *this = std::move(other);
+   }
+
+   MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+   {
+      if (this != &other)
+      {
+         close();
+
+         std::swap(data_, other.data_);
+         std::swap(size_, other.size_);
+         std::swap(is_open_, other.is_open_);
+#ifdef _WIN32
+         std::swap(file_handle_, other.file_handle_);
+         std::swap(mapping_handle_, other.mapping_handle_);
+#endif
+      }
+
+      return *this;
+   }
+
+#ifdef _WIN32
+
+   bool MappedFile::open(const std::string& file_name)
+   {
+      close();
+
+      HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+         return false;
+
+      LARGE_INTEGER file_size;
+      if (!GetFileSizeEx(file, &file_size))
+      {
+         CloseHandle(file);
+         return false;
+      }
+
+      file_handle_ = file;
+      size_ = static_cast<size_t>(file_size.QuadPart);
+      is_open_ = true;
+
+      // empty files cannot be mapped, but are valid
+      if (size_ == 0)
+         return true;
+
+      HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping == nullptr)
+      {
+         close();
+         return false;
+      }
+
+      mapping_handle_ = mapping;
+      data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+      if (data_ == nullptr)
+      {
+         close();
+         return false;
+      }
+
+      return true;
+   }
+
+   void MappedFile::close()
+   {
+      if (data_)
+         UnmapViewOfFile(data_);
+      if (mapping_handle_)
+         CloseHandle(mapping_handle_);
+      if (file_handle_)
+         CloseHandle(file_handle_);
+
+      data_ = nullptr;
+      size_ = 0;
+      is_open_ = false;
+      file_handle_ = nullptr;
+      mapping_handle_ = nullptr;
+   }
+
+#else
+
+   bool MappedFile::open(const std::string& file_name)
+   {
+      close();
+
+      int descriptor = ::open(file_name.c_str(), O_RDONLY);
+      if (descriptor < 0)
+         return false;
+
+      struct stat file_status;
+      if (fstat(descriptor, &file_status) != 0 || !S_ISREG(file_status.st_mode))
+      {
+         ::close(descriptor);
+         return false;
+      }
+
+      size_ = static_cast<size_t>(file_status.st_size);
+      is_open_ = true;
+
+      // empty files cannot be mapped, but are valid
+      if (size_ > 0)
+      {
+         void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+         if (mapping == MAP_FAILED)
+         {
+            ::close(descriptor);
+            close();
+            return false;
+         }
+
+         madvise(mapping, size_, MADV_SEQUENTIAL);
+         data_ = static_cast<const char*>(mapping);
+      }
+
+      // the mapping stays valid after the descriptor is closed
+      ::close(descriptor);
+
+      return true;
+   }
+
+   void MappedFile::close()
+   {
+      if (data_)
+         munmap(const_cast<char*>(data_), size_);
+
+      data_ = nullptr;
+      size_ = 0;
+      is_open_ = false;
+   }
+
+#endif
+
+}
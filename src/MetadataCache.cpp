@@ -0,0 +1,516 @@
+#include "MetadataCache.h"
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+   using MusicPlayer::Codec;
+   using MusicPlayer::MetadataCache;
+   using MusicPlayer::ReplayGain;
+   using MusicPlayer::Track;
+
+   namespace fs = std::filesystem;
+
+   constexpr char kMagic[4] = { 'I', 'P', 'M', 'C' };
+
+   // payload size and checksum
+   constexpr size_t kRecordHeaderSize = 8;
+
+   // size, modification time, duration, codec, ReplayGain flag, path and title lengths, gain and peak
+   constexpr size_t kFixedPayloadSize = 8 + 8 + 4 + 1 + 1 + 4 + 4 + 4 + 4;
+
+   void putUInt(std::string& out, std::uint64_t value, size_t byte_count)
+   {
+      for (size_t idx = 0; idx < byte_count; idx++)
+         out.push_back(static_cast<char>((value >> (8 * idx)) & 0xFF));
+   }
+
+   std::uint64_t getUInt(const char* in, size_t byte_count)
+   {
+      std::uint64_t value(0);
+      for (size_t idx = 0; idx < byte_count; idx++)
+         value |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[idx])) << (8 * idx);
+      return value;
+   }
+
+   std::uint32_t floatBits(float value)
+   {
+      std::uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      return bits;
+   }
+
+   float bitsFloat(std::uint64_t bits)
+   {
+      auto narrowed = static_cast<std::uint32_t>(bits);
+      float value;
+      std::memcpy(&value, &narrowed, sizeof(value));
+      return value;
+   }
+
+   std::uint32_t checksum(std::string_view payload)
+   {
+      std::uint32_t hash = 2166136261u;
+      for (char byte : payload)
+      {
+         hash ^= static_cast<unsigned char>(byte);
+         hash *= 16777619u;
+      }
+      return hash;
+   }
+
+   std::string encodeHeader()
+   {
+      std::string header(kMagic, sizeof(kMagic));
+      putUInt(header, MetadataCache::kVersion, 2);
+      putUInt(header, 0, 2);
+      return header;
+   }
+
+   void encodeRecord(std::string& out, std::string_view path, const MetadataCache::FileStamp& stamp, const Track& track)
+   {
+      std::string_view title = track.getTitle();
+      const std::optional<ReplayGain>& replay_gain = track.getReplayGain();
+
+      // the payload is encoded in place, after room for its size and checksum
+      size_t record_start = out.size();
+      out.append(kRecordHeaderSize, '\0');
+
+      putUInt(out, stamp.size, 8);
+      putUInt(out, static_cast<std::uint64_t>(stamp.modified_ns), 8);
+      putUInt(out, static_cast<std::uint64_t>(track.getDuration()), 4);
+      putUInt(out, static_cast<std::uint64_t>(track.getCodec()), 1);
+      putUInt(out, replay_gain ? 1 : 0, 1);
+      putUInt(out, path.size(), 4);
+      putUInt(out, title.size(), 4);
+      putUInt(out, replay_gain ? floatBits(replay_gain->gain_db) : 0, 4);
+      putUInt(out, replay_gain ? floatBits(replay_gain->peak) : 0, 4);
+      out.append(path);
+      out.append(title);
+
+      std::string_view payload(out.data() + record_start + kRecordHeaderSize, out.size() - record_start - kRecordHeaderSize);
+
+      std::string header;
+      putUInt(header, payload.size(), 4);
+      putUInt(header, checksum(payload), 4);
+      out.replace(record_start, kRecordHeaderSize, header);
+   }
+
+   /**
+    * \brief Decodes the record starting at the beginning of the input.
+    *
+    * \return The size of the record, or 0 if it is cut or corrupted.
+    */
+   size_t decodeRecord(std::string_view input, std::string_view& path, MetadataCache::FileStamp& stamp, Track& track)
+   {
+      if (input.size() < kRecordHeaderSize)
+         return 0;
+
+      size_t payload_size = getUInt(input.data(), 4);
+      if (payload_size < kFixedPayloadSize || input.size() - kRecordHeaderSize < payload_size)
+         return 0;
+
+      std::string_view payload = input.substr(kRecordHeaderSize, payload_size);
+      if (checksum(payload) != getUInt(input.data() + 4, 4))
+         return 0;
+
+      const char* fields = payload.data();
+      size_t codec = getUInt(fields + 20, 1);
+      size_t path_size = getUInt(fields + 22, 4);
+      size_t title_size = getUInt(fields + 26, 4);
+
+      if (codec >= Codec::kTypeCount || kFixedPayloadSize + path_size + title_size != payload_size)
+         return 0;
+
+      stamp.size = getUInt(fields, 8);
+      stamp.modified_ns = static_cast<std::int64_t>(getUInt(fields + 8, 8));
+      path = payload.substr(kFixedPayloadSize, path_size);
+
+      track = Track(payload.substr(kFixedPayloadSize + path_size, title_size), static_cast<time_t>(getUInt(fields + 16, 4)), static_cast<Codec::Type>(codec));
+      if (getUInt(fields + 21, 1) != 0)
+         track.setReplayGain(ReplayGain{ bitsFloat(getUInt(fields + 30, 4)), bitsFloat(getUInt(fields + 34, 4)) });
+
+      return kRecordHeaderSize + payload_size;
+   }
+
+   /**
+    * \brief Writes the buffered data of a file to the disk.
+    */
+   bool syncFile(std::FILE* file)
+   {
+      if (std::fflush(file) != 0)
+         return false;
+
+#ifdef _WIN32
+      return _commit(_fileno(file)) == 0;
+#else
+      return ::fsync(fileno(file)) == 0;
+#endif
+   }
+}
+
+namespace MusicPlayer
+{
+
+   MetadataCache::MetadataCache() :
+      log_(nullptr),
+      record_count_(0),
+      hits_(0),
+      misses_(0),
+      stale_(0),
+      compactions_(0),
+      recovered_bytes_(0)
+   {
+   }
+
+   MetadataCache::~MetadataCache()
+   {
+      close();
+   }
+
+   bool MetadataCache::open(const std::string& file_name, std::string& error)
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      closeLocked_();
+
+      std::error_code status_error;
+      fs::path parent = fs::path(file_name).parent_path();
+      if (!parent.empty())
+         fs::create_directories(parent, status_error);
+
+      std::uintmax_t file_size = fs::exists(file_name, status_error) ? fs::file_size(file_name, status_error) : 0;
+      if (status_error)
+      {
+         error = "Metadata cache \"" + file_name + "\" could not be accessed. (Reason: " + status_error.message() + ")";
+         return false;
+      }
+
+      std::unordered_map<InternedString, Entry> entries;
+      size_t record_count(0);
+      size_t valid_size(0);
+
+      if (file_size > 0)
+      {
+         MappedFile file;
+         if (!file.open(file_name))
+         {
+            error = "Metadata cache \"" + file_name + "\" could not be opened.";
+            return false;
+         }
+
+         std::string_view contents = file.view();
+         if (contents.size() < kHeaderSize || contents.compare(0, kHeaderSize, encodeHeader()) != 0)
+         {
+            error = "File \"" + file_name + "\" is not a metadata cache, or was written by another version.";
+            return false;
+         }
+
+         valid_size = kHeaderSize;
+
+         std::string_view path;
+         Entry entry;
+         while (size_t record_size = decodeRecord(contents.substr(valid_size), path, entry.stamp, entry.track))
+         {
+            entries.insert_or_assign(StringPool::shared().intern(path), entry);
+            record_count++;
+            valid_size += record_size;
+         }
+      }
+
+      // a record cut by a crash is dropped, so that the next records are appended after the last valid one
+      if (valid_size > 0 && valid_size < file_size)
+      {
+         fs::resize_file(file_name, valid_size, status_error);
+         if (status_error)
+         {
+            error = "Metadata cache \"" + file_name + "\" could not be repaired. (Reason: " + status_error.message() + ")";
+            return false;
+         }
+      }
+
+      log_ = std::fopen(file_name.c_str(), "ab");
+      if (log_ == nullptr)
+      {
+         error = "Metadata cache \"" + file_name + "\" could not be opened for writing.";
+         return false;
+      }
+
+      if (valid_size == 0)
+      {
+         std::string header = encodeHeader();
+         if (std::fwrite(header.data(), 1, header.size(), log_) != header.size() || !syncFile(log_))
+         {
+            std::fclose(log_);
+            log_ = nullptr;
+            error = "Metadata cache \"" + file_name + "\" could not be written.";
+            return false;
+         }
+      }
+
+      file_name_ = file_name;
+      entries_ = std::move(entries);
+      record_count_ = record_count;
+      recovered_bytes_ = file_size - std::min<std::uintmax_t>(valid_size, file_size);
+      compactions_ = 0;
+      hits_ = 0;
+      misses_ = 0;
+      stale_ = 0;
+
+      return true;
+   }
+
+   void MetadataCache::close()
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      closeLocked_();
+   }
+
+   bool MetadataCache::isOpen() const
+   {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      return log_ != nullptr;
+   }
+
+   std::string MetadataCache::getFileName() const
+   {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      return file_name_;
+   }
+
+   bool MetadataCache::getFileStamp(const std::string& file_name, FileStamp& stamp)
+   {
+#ifdef _WIN32
+      std::error_code error;
+      std::uintmax_t size = fs::file_size(file_name, error);
+      if (error)
+         return false;
+
+      fs::file_time_type modified = fs::last_write_time(file_name, error);
+      if (error)
+         return false;
+
+      stamp.size = size;
+      stamp.modified_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(modified.time_since_epoch()).count();
+#else
+      struct stat status;
+      if (::stat(file_name.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+         return false;
+
+      stamp.size = static_cast<std::uint64_t>(status.st_size);
+      stamp.modified_ns = static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+
+      return true;
+   }
+
+   bool MetadataCache::lookup(std::string_view track_file, const FileStamp& stamp, Track& track)
+   {
+      InternedString key = keyFor_(track_file);
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+
+      if (log_ == nullptr)
+         return false;
+
+      auto found = entries_.find(key);
+      if (found == entries_.end() || found->second.stamp != stamp)
+      {
+         if (found != entries_.end())
+            stale_++;
+
+         misses_++;
+         return false;
+      }
+
+      hits_++;
+      track = found->second.track;
+      return true;
+   }
+
+   void MetadataCache::store(std::string_view track_file, const FileStamp& stamp, const Track& track)
+   {
+      InternedString key = keyFor_(track_file);
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+
+      if (log_ == nullptr)
+         return;
+
+      encodeRecord(pending_, key, stamp, track);
+      record_count_++;
+      entries_.insert_or_assign(key, Entry{ stamp, track });
+   }
+
+   bool MetadataCache::flush(std::string& error)
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      return flushLocked_(error);
+   }
+
+   bool MetadataCache::compact(std::string& error)
+   {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+
+      if (log_ == nullptr)
+      {
+         error = "The metadata cache is not open.";
+         return false;
+      }
+
+      return compactLocked_(error);
+   }
+
+   MetadataCache::Statistics MetadataCache::getStatistics() const
+   {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+
+      Statistics statistics;
+      statistics.entry_count = entries_.size();
+      statistics.record_count = record_count_;
+      statistics.hits = hits_;
+      statistics.misses = misses_;
+      statistics.stale = stale_;
+      statistics.compactions = compactions_;
+      statistics.recovered_bytes = recovered_bytes_;
+      return statistics;
+   }
+
+   std::string MetadataCache::getDefaultFileName()
+   {
+      fs::path directory;
+
+      if (const char* cache_home = std::getenv("XDG_CACHE_HOME"); cache_home != nullptr && *cache_home != '\0')
+         directory = cache_home;
+      else if (const char* local_app_data = std::getenv("LOCALAPPDATA"); local_app_data != nullptr && *local_app_data != '\0')
+         directory = local_app_data;
+      else if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+         directory = fs::path(home) / ".cache";
+      else
+         directory = fs::temp_directory_path();
+
+      return (directory / "iplayer" / "metadata.cache").string();
+   }
+
+   MetadataCache& MetadataCache::shared()
+   {
+      static MetadataCache cache;
+      return cache;
+   }
+
+   InternedString MetadataCache::keyFor_(std::string_view track_file)
+   {
+      fs::path path(track_file);
+      if (path.is_absolute())
+         return StringPool::shared().intern(track_file);
+
+      // the same file is found whatever the directory the shell was in when it was added
+      std::error_code error;
+      fs::path absolute = fs::absolute(path, error);
+
+      return StringPool::shared().intern(error ? std::string(track_file) : absolute.lexically_normal().string());
+   }
+
+   void MetadataCache::closeLocked_()
+   {
+      if (log_ == nullptr)
+         return;
+
+      std::string error;
+      flushLocked_(error);
+
+      std::fclose(log_);
+      log_ = nullptr;
+
+      file_name_.clear();
+      entries_.clear();
+      pending_.clear();
+      record_count_ = 0;
+   }
+
+   bool MetadataCache::flushLocked_(std::string& error)
+   {
+      if (log_ == nullptr || pending_.empty())
+         return true;
+
+      bool written = std::fwrite(pending_.data(), 1, pending_.size(), log_) == pending_.size() && std::fflush(log_) == 0;
+      pending_.clear();
+
+      if (!written)
+      {
+         // the records that reached the file are checked when it is loaded again
+         error = "Metadata cache \"" + file_name_ + "\" could not be written.";
+         return false;
+      }
+
+      if (record_count_ > kCompactionMinRecords && record_count_ > 2 * entries_.size())
+         return compactLocked_(error);
+
+      return true;
+   }
+
+   bool MetadataCache::compactLocked_(std::string& error)
+   {
+      if (!flushLocked_(error))
+         return false;
+
+      std::string contents = encodeHeader();
+      for (const auto& [path, entry] : entries_)
+         encodeRecord(contents, path, entry.stamp, entry.track);
+
+      // the new log replaces the old one only once it is complete on the disk
+      std::string temporary_name = file_name_ + ".tmp";
+      std::FILE* temporary = std::fopen(temporary_name.c_str(), "wb");
+      if (temporary == nullptr)
+      {
+         error = "File \"" + temporary_name + "\" could not be created.";
+         return false;
+      }
+
+      bool written = std::fwrite(contents.data(), 1, contents.size(), temporary) == contents.size() && syncFile(temporary);
+      written = std::fclose(temporary) == 0 && written;
+
+      std::error_code rename_error;
+      if (written)
+      {
+         std::fclose(log_);
+         fs::rename(temporary_name, file_name_, rename_error);
+         log_ = std::fopen(file_name_.c_str(), "ab");
+      }
+
+      if (!written || rename_error || log_ == nullptr)
+      {
+         std::error_code remove_error;
+         fs::remove(temporary_name, remove_error);
+
+         if (log_ == nullptr)
+         {
+            error = "Metadata cache \"" + file_name_ + "\" could not be reopened after its compaction.";
+            file_name_.clear();
+            entries_.clear();
+            record_count_ = 0;
+         }
+         else
+            error = "Metadata cache \"" + file_name_ + "\" could not be compacted.";
+
+         return false;
+      }
+
+      record_count_ = entries_.size();
+      compactions_++;
+      return true;
+   }
+
+}
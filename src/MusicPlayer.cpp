@@ -2,17 +2,119 @@
 //
 
 #include "Shell.h"
+#include "Utils.h"
 
+#ifndef _WIN32
+#include "Server.h"
+
+#include <csignal>
+#endif
+
+#include <fstream>
 #include <iostream>
 #include <string_view>
 
 using namespace std::string_view_literals;
 
-int main()
+namespace
 {
-   MusicPlayer::Shell main_shell(std::cin, std::cout);
+   void printUsage()
+   {
+      std::cerr << "Usage:" << std::endl;
+      std::cerr << "\tiplayer" << std::endl;
+      std::cerr << "\t\tStarts the interactive shell." << std::endl;
+      std::cerr << "\tiplayer --batch <script file> [--stop-on-error]" << std::endl;
+      std::cerr << "\t\tExecutes the instructions of a script file without prompting, then exits." << std::endl;
+      std::cerr << "\t\tWith --stop-on-error, exits with a nonzero status at the first failed instruction." << std::endl;
+      std::cerr << "\tiplayer --server <socket path> [--executors <count>]" << std::endl;
+      std::cerr << "\t\tServes independent sessions over a Unix socket until interrupted, one session per connection." << std::endl;
+      std::cerr << "\t\tEach line received is an instruction, answered by \"ok <length>\" or \"error <length>\" and the printed text." << std::endl;
+   }
+
+   int runBatch(const char* script_name, bool stop_on_error)
+   {
+      std::ifstream script(script_name, std::ifstream::in);
+
+      if (!script.is_open())
+      {
+         std::cerr << "File \"" << script_name << "\" could not be opened." << std::endl;
+         return 1;
+      }
+
+      // the output is only flushed at the end or on errors, so it does not need to stay in sync with stdio
+      std::ios::sync_with_stdio(false);
+
+      MusicPlayer::Shell batch_shell(script, std::cout);
+      batch_shell.setInteractive(false);
+      batch_shell.setStopOnError(stop_on_error);
+
+      return batch_shell.run();
+   }
+
+#ifndef _WIN32
+   MusicPlayer::Server* running_server = nullptr;
+
+   void stopServer(int)
+   {
+      running_server->stop();
+   }
+
+   int runServer(const char* socket_path, size_t executor_count)
+   {
+      MusicPlayer::Server server(socket_path, executor_count);
+      std::string error;
+
+      if (!server.listen(error))
+      {
+         std::cerr << error << std::endl;
+         return 1;
+      }
 
-   main_shell.run();
+      running_server = &server;
+      std::signal(SIGINT, stopServer);
+      std::signal(SIGTERM, stopServer);
+
+      std::cout << "Serving sessions on " << socket_path << std::endl;
+      server.run();
+
+      std::cout << "Server stopped after " << server.getInstructionCount() << " instruction(s)." << std::endl;
+      return 0;
+   }
+#endif
+}
+
+int main(int argc, char** argv)
+{
+   if (argc > 1 && argv[1] == "--server"sv)
+   {
+      long long executor_count(0);
+
+      if (argc != 3 && (argc != 5 || argv[3] != "--executors"sv || !MusicPlayer::parseInteger(argv[4], executor_count) || executor_count < 1))
+      {
+         printUsage();
+         return 2;
+      }
+
+#ifdef _WIN32
+      std::cerr << "The server mode is not available on this platform." << std::endl;
+      return 1;
+#else
+      return runServer(argv[2], static_cast<size_t>(executor_count));
+#endif
+   }
+
+   if (argc > 1)
+   {
+      if (argv[1] != "--batch"sv || argc < 3 || argc > 4 || (argc == 4 && argv[3] != "--stop-on-error"sv))
+      {
+         printUsage();
+         return 2;
+      }
+
+      return runBatch(argv[2], argc == 4);
+   }
+
+   MusicPlayer::Shell main_shell(std::cin, std::cout);
 
-   return 0;
+   return main_shell.run();
 }
@@ -0,0 +1,93 @@
+#include "PlayQueue.h"
+
+namespace MusicPlayer
+{
+
+   namespace
+   {
+      constexpr size_t kInitialCapacity = 16;
+   }
+
+   PlayQueue::PlayQueue() :
+      slots_(kInitialCapacity, Playlist::kInvalidHandle),
+      head_(0),
+      size_(0)
+   {
+   }
+
+   void PlayQueue::pushBack(Playlist::Handle handle)
+   {
+      if (size_ == slots_.size())
+         grow_();
+
+      slots_[slot_(size_)] = handle;
+      size_++;
+   }
+
+   void PlayQueue::pushFront(Playlist::Handle handle)
+   {
+      if (size_ == slots_.size())
+         grow_();
+
+      head_ = slot_(slots_.size() - 1);
+      slots_[head_] = handle;
+      size_++;
+   }
+
+   Playlist::Handle PlayQueue::front(const Playlist& playlist)
+   {
+      while (size_ > 0 && playlist.positionOf(slots_[head_]) == Playlist::npos)
+         popFront();
+
+      return size_ > 0 ? slots_[head_] : Playlist::kInvalidHandle;
+   }
+
+   void PlayQueue::popFront()
+   {
+      head_ = slot_(1);
+      size_--;
+   }
+
+   void PlayQueue::erase(size_t index)
+   {
+      for (size_t moved = index + 1; moved < size_; moved++)
+         slots_[slot_(moved - 1)] = slots_[slot_(moved)];
+
+      size_--;
+   }
+
+   void PlayQueue::prune(const Playlist& playlist)
+   {
+      size_t kept(0);
+
+      for (size_t index = 0; index < size_; index++)
+      {
+         Playlist::Handle handle = slots_[slot_(index)];
+         if (playlist.positionOf(handle) != Playlist::npos)
+            slots_[slot_(kept++)] = handle;
+      }
+
+      size_ = kept;
+   }
+
+   void PlayQueue::clear()
+   {
+      head_ = 0;
+      size_ = 0;
+   }
+
+   /**
+    * Doubles the capacity, unwrapping the entries at the start of the new buffer.
+    */
+   void PlayQueue::grow_()
+   {
+      std::vector<Playlist::Handle> slots(slots_.size() * 2, Playlist::kInvalidHandle);
+
+      for (size_t index = 0; index < size_; index++)
+         slots[index] = slots_[slot_(index)];
+
+      slots_.swap(slots);
+      head_ = 0;
+   }
+
+}
@@ -0,0 +1,530 @@
+#include "PlaybackEngine.h"
+
+#include "Dsp.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+   // how long a thread waits before polling the ring buffer again
+   constexpr std::chrono::microseconds kPollInterval(500);
+
+   constexpr size_t kMarkerCapacity = 256;
+   constexpr size_t kStreamStartCapacity = 16;
+}
+
+namespace MusicPlayer
+{
+
+   PlaybackEngine::PlaybackEngine(size_t block_frames, size_t buffer_frames) :
+      block_frames_(block_frames),
+      buffer_frames_(std::max(buffer_frames, 2 * block_frames)),
+      sink_(std::make_unique<NullSink>()),
+      channels_(0),
+      markers_(kMarkerCapacity),
+      stream_starts_(kStreamStartCapacity),
+      transitions_(0),
+      downmix_(false),
+      downmix_active_(false),
+      output_rate_(0),
+      resampler_quality_(Resampler::Quality::Medium),
+      resampling_(false),
+      resampler_flushed_(false),
+      resample_ns_(0),
+      resampled_frames_(0),
+      crossfade_(0),
+      frames_decoded_(0),
+      staged_samples_(nullptr),
+      staged_sample_count_(0),
+      staged_frames_(0),
+      stream_start_pending_(false),
+      draining_(false),
+      target_gain_(1.0f),
+      gain_(1.0f),
+      producer_scheduled_(false),
+      stop_requested_(false),
+      paused_(false),
+      producer_done_(false),
+      finished_(false),
+      frames_played_(0),
+      underruns_(0),
+      latency_count_(0),
+      latency_total_us_(0),
+      latency_max_us_(0)
+   {
+   }
+
+   PlaybackEngine::~PlaybackEngine()
+   {
+      stop();
+   }
+
+   void PlaybackEngine::setSink(std::unique_ptr<AudioSink> sink)
+   {
+      stop();
+      sink_ = std::move(sink);
+   }
+
+   void PlaybackEngine::setNextStreamProvider(StreamProvider provider)
+   {
+      stop();
+      next_stream_provider_ = std::move(provider);
+   }
+
+   bool PlaybackEngine::start(Stream stream, std::string& error)
+   {
+      stop();
+
+      const AudioFormat& format = stream.decoder->getFormat();
+
+      // the sink receives the format after the resampling and the downmix
+      downmix_active_ = downmix_ && format.channels == 2;
+      AudioFormat output_format = format;
+      if (downmix_active_)
+         output_format.channels = 1;
+      if (output_rate_ != 0)
+         output_format.sample_rate = output_rate_;
+
+      if (!sink_->open(output_format, error))
+         return false;
+
+      decoder_ = std::move(stream.decoder);
+      configureResampler_();
+
+      // the crossfades are mixed at the output rate, before the downmix
+      crossfader_.configure(static_cast<size_t>(crossfade_.count() * output_format.sample_rate / 1000), format.channels);
+      crossfader_.startStream(stream.gain);
+
+      // the buffers are only reallocated when the stream layout changes
+      if (channels_ != format.channels || !samples_)
+      {
+         channels_ = format.channels;
+         samples_ = std::make_unique<RingBuffer<float>>(buffer_frames_ * channels_);
+         decode_block_.assign(block_frames_ * channels_, 0.0f);
+         output_block_.assign(block_frames_ * channels_, 0.0f);
+         downmix_block_.assign(block_frames_, 0.0f);
+      }
+
+      samples_->clear();
+      markers_.clear();
+      stream_starts_.clear();
+      decode_error_.clear();
+
+      stop_requested_ = false;
+      paused_ = false;
+      producer_done_ = false;
+      finished_ = false;
+
+      frames_played_ = 0;
+      underruns_ = 0;
+      transitions_ = 0;
+      latency_count_ = 0;
+      gain_ = target_gain_.load(std::memory_order_relaxed);
+      latency_total_us_ = 0;
+      latency_max_us_ = 0;
+
+      frames_decoded_ = 0;
+      staged_frames_ = 0;
+      staged_sample_count_ = 0;
+      stream_start_pending_ = false;
+      draining_ = false;
+
+      consumer_ = std::thread(&PlaybackEngine::consume_, this);
+      scheduleProducer_();
+
+      return true;
+   }
+
+   void PlaybackEngine::setDownmix(bool downmix)
+   {
+      stop();
+      downmix_ = downmix;
+   }
+
+   void PlaybackEngine::setOutputRate(unsigned output_rate, Resampler::Quality quality)
+   {
+      stop();
+      output_rate_ = output_rate;
+      resampler_quality_ = quality;
+   }
+
+   void PlaybackEngine::setCrossfade(std::chrono::milliseconds duration)
+   {
+      stop();
+      crossfade_ = duration;
+   }
+
+   void PlaybackEngine::setVolume(float volume)
+   {
+      target_gain_.store(volume, std::memory_order_relaxed);
+   }
+
+   void PlaybackEngine::pause()
+   {
+      paused_.store(true, std::memory_order_relaxed);
+   }
+
+   void PlaybackEngine::resume()
+   {
+      paused_.store(false, std::memory_order_relaxed);
+   }
+
+   void PlaybackEngine::stop()
+   {
+      stop_requested_.store(true, std::memory_order_relaxed);
+
+      // the consumer is the one scheduling the producer: it ends first
+      if (consumer_.joinable())
+      {
+         consumer_.join();
+         sink_->close();
+      }
+
+      waitForProducer_();
+      decoder_.reset();
+   }
+
+   void PlaybackEngine::waitUntilFinished()
+   {
+      if (consumer_.joinable())
+      {
+         consumer_.join();
+         sink_->close();
+      }
+
+      waitForProducer_();
+   }
+
+   PlaybackEngine::Statistics PlaybackEngine::getStatistics() const
+   {
+      Statistics statistics;
+
+      statistics.frames_played = frames_played_.load(std::memory_order_relaxed);
+      statistics.underruns = underruns_.load(std::memory_order_relaxed);
+
+      std::uint64_t latency_count = latency_count_.load(std::memory_order_relaxed);
+      if (latency_count > 0)
+         statistics.average_latency_ms = latency_total_us_.load(std::memory_order_relaxed) / 1000.0 / latency_count;
+      statistics.max_latency_ms = latency_max_us_.load(std::memory_order_relaxed) / 1000.0;
+
+      // time spent resampling, relative to the duration of the audio resampled
+      std::uint64_t resampled_frames = resampled_frames_.load(std::memory_order_relaxed);
+      if (resampled_frames > 0 && output_rate_ != 0)
+      {
+         double resampled_seconds = static_cast<double>(resampled_frames) / output_rate_;
+         statistics.resampler_cpu_percent = resample_ns_.load(std::memory_order_relaxed) / 1e9 / resampled_seconds * 100.0;
+      }
+
+      return statistics;
+   }
+
+   /**
+    * Schedules a run of the producer on the shared thread pool, unless one is already scheduled.
+    */
+   void PlaybackEngine::scheduleProducer_()
+   {
+      // a single run at a time: the state of the producer is not shared
+      if (producer_scheduled_.exchange(true, std::memory_order_acq_rel))
+         return;
+
+      ThreadPool::shared().submit(ThreadPool::Priority::Realtime, [this]() { produce_(); });
+   }
+
+   void PlaybackEngine::waitForProducer_()
+   {
+      // a run of the producer ends at its next block once the playback is stopped
+      while (producer_scheduled_.load(std::memory_order_acquire))
+         std::this_thread::sleep_for(kPollInterval);
+   }
+
+   /**
+    * Decodes until the ring buffer is full, the playback is stopped or the last stream ended. The frames that did not
+    * fit in the ring buffer stay staged for the next run.
+    */
+   void PlaybackEngine::produce_()
+   {
+      while (!stop_requested_.load(std::memory_order_relaxed))
+      {
+         if (!push_())
+            break;
+
+         if (stream_start_pending_)
+         {
+            // the consumer counts the transition when it reaches the first frame of the next stream
+            if (stream_starts_.write(&frames_decoded_, 1) == 0)
+               break;
+
+            stream_start_pending_ = false;
+         }
+
+         if (draining_)
+         {
+            if (decoder_->hasFailed())
+               decode_error_ = decoder_->getErrorMessage();
+
+            producer_done_.store(true, std::memory_order_release);
+            break;
+         }
+
+         size_t frames = decoder_->read(decode_block_.data(), block_frames_);
+
+         if (frames > 0)
+         {
+            if (resampling_)
+               mix_(resample_block_.data(), resample_(decode_block_.data(), frames));
+            else
+               mix_(decode_block_.data(), frames);
+         }
+         else if (resampling_ && !resampler_flushed_)
+         {
+            resampler_flushed_ = true;
+            mix_(resample_block_.data(), resample_(nullptr, 0));
+         }
+         else if (!startNextStream_())
+         {
+            // the end of the last stream is still held by the crossfader
+            const float* tail(nullptr);
+            size_t tail_frames = crossfader_.flush(tail);
+            stage_(tail, tail_frames);
+            draining_ = true;
+         }
+      }
+
+      // last access to the engine, which may be destroyed as soon as the flag is cleared
+      producer_scheduled_.store(false, std::memory_order_release);
+   }
+
+   /**
+    * Continues the playback with the stream given by the next stream provider, at the end of the current one.
+    *
+    * \return false if there is no stream to continue with.
+    */
+   bool PlaybackEngine::startNextStream_()
+   {
+      if (decoder_->hasFailed() || !next_stream_provider_)
+         return false;
+
+      // any sample rate can follow when the output rate is fixed
+      AudioFormat next_format = decoder_->getFormat();
+      if (output_rate_ != 0)
+         next_format.sample_rate = 0;
+
+      Stream next_stream = next_stream_provider_(next_format);
+      if (!next_stream.decoder)
+         return false;
+
+      stream_start_pending_ = true;
+
+      decoder_ = std::move(next_stream.decoder);
+      configureResampler_();
+      crossfader_.startStream(next_stream.gain);
+      return true;
+   }
+
+   /**
+    * Applies the stream gain and the crossfades to frames, then stages the frames output for the ring buffer.
+    */
+   void PlaybackEngine::mix_(float* samples, size_t frames)
+   {
+      stage_(samples, crossfader_.process(samples, frames));
+   }
+
+   /**
+    * Stages frames for the ring buffer. They must stay valid until push_() wrote them all.
+    */
+   void PlaybackEngine::stage_(const float* samples, size_t frames)
+   {
+      staged_samples_ = samples;
+      staged_sample_count_ = frames * channels_;
+      staged_frames_ = frames;
+   }
+
+   /**
+    * Writes the staged frames to the ring buffer, as many as it has room for.
+    *
+    * \return true once all the staged frames are written.
+    */
+   bool PlaybackEngine::push_()
+   {
+      if (staged_frames_ == 0)
+         return true;
+
+      // the capacity is a power of two, not always a whole number of frames: only whole frames are written, so that
+      // the consumer never reads a partial frame
+      size_t room = samples_->writeAvailable();
+      size_t written = samples_->write(staged_samples_, std::min(staged_sample_count_, room - room % channels_));
+      staged_samples_ += written;
+      staged_sample_count_ -= written;
+
+      if (staged_sample_count_ > 0)
+         return false;
+
+      frames_decoded_ += staged_frames_;
+      staged_frames_ = 0;
+
+      // a missing marker only makes the latency measurement coarser
+      LatencyMarker marker{ frames_decoded_, Clock::now() };
+      markers_.write(&marker, 1);
+
+      return true;
+   }
+
+   /**
+    * Resamples decoded frames to resample_block_, or flushes the resampler at the end of the stream.
+    *
+    * \return The number of resampled frames.
+    */
+   size_t PlaybackEngine::resample_(const float* samples, size_t frames)
+   {
+      Clock::time_point start = Clock::now();
+      size_t resampled = samples ? resampler_.process(samples, frames, resample_block_.data()) : resampler_.flush(resample_block_.data());
+      std::int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+      resample_ns_.fetch_add(elapsed_ns, std::memory_order_relaxed);
+      resampled_frames_.fetch_add(resampled, std::memory_order_relaxed);
+
+      return resampled;
+   }
+
+   /**
+    * Prepares the resampler for the stream of the current decoder, if its rate differs from the output rate.
+    */
+   void PlaybackEngine::configureResampler_()
+   {
+      const AudioFormat& format = decoder_->getFormat();
+      resampling_ = output_rate_ != 0 && format.sample_rate != output_rate_;
+      resampler_flushed_ = false;
+
+      // the cost is measured per stream
+      resample_ns_.store(0, std::memory_order_relaxed);
+      resampled_frames_.store(0, std::memory_order_relaxed);
+
+      if (!resampling_)
+         return;
+
+      resampler_.configure(format.sample_rate, output_rate_, format.channels, resampler_quality_);
+
+      size_t block_samples = resampler_.getMaxOutputFrames(block_frames_) * format.channels;
+      if (resample_block_.size() < block_samples)
+         resample_block_.resize(block_samples);
+   }
+
+   void PlaybackEngine::consume_()
+   {
+      const size_t block_samples = block_frames_ * channels_;
+      const size_t refill_samples = samples_->capacity() / 2;
+      const bool realtime = sink_->isRealtime();
+
+      std::uint64_t frames_played(0);
+      LatencyMarker marker{};
+      bool has_marker(false);
+      std::uint64_t stream_start(0);
+      bool has_stream_start(false);
+
+      while (!stop_requested_.load(std::memory_order_relaxed))
+      {
+         if (paused_.load(std::memory_order_relaxed))
+         {
+            std::this_thread::sleep_for(kPollInterval);
+            continue;
+         }
+
+         // read the flag before the buffer, so that no sample written before the end of the stream is missed
+         bool producer_done = producer_done_.load(std::memory_order_acquire);
+         size_t available = samples_->readAvailable();
+
+         // the producer decodes in batches, from when half of the ring buffer is free
+         if (!producer_done && samples_->writeAvailable() >= refill_samples)
+            scheduleProducer_();
+
+         if (available < block_samples && !producer_done)
+         {
+            if (!realtime || frames_played == 0)
+            {
+               // nothing is audible yet, or the sink can wait
+               std::this_thread::sleep_for(kPollInterval);
+               continue;
+            }
+
+            // the device cannot wait: play what is there, followed by silence
+            size_t read = samples_->read(output_block_.data(), available - available % channels_);
+            std::fill(output_block_.begin() + read, output_block_.end(), 0.0f);
+
+            underruns_.fetch_add(1, std::memory_order_relaxed);
+            output_(block_frames_);
+
+            frames_played += read / channels_;
+            frames_played_.store(frames_played, std::memory_order_relaxed);
+            continue;
+         }
+
+         size_t read = samples_->read(output_block_.data(), block_samples);
+         if (read == 0)
+            break;
+
+         output_(read / channels_);
+
+         frames_played += read / channels_;
+         frames_played_.store(frames_played, std::memory_order_relaxed);
+
+         while (has_stream_start || stream_starts_.read(&stream_start, 1) == 1)
+         {
+            has_stream_start = stream_start >= frames_played;
+            if (has_stream_start)
+               break;
+
+            transitions_.fetch_add(1, std::memory_order_release);
+         }
+
+         // the frames of every marker reached are now out
+         Clock::time_point now = Clock::now();
+         while (has_marker || markers_.read(&marker, 1) == 1)
+         {
+            if (marker.end_frame > frames_played)
+            {
+               has_marker = true;
+               break;
+            }
+
+            has_marker = false;
+
+            std::int64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(now - marker.decoded_at).count();
+            latency_count_.fetch_add(1, std::memory_order_relaxed);
+            latency_total_us_.fetch_add(latency_us, std::memory_order_relaxed);
+            if (latency_us > latency_max_us_.load(std::memory_order_relaxed))
+               latency_max_us_.store(latency_us, std::memory_order_relaxed);
+         }
+      }
+
+      finished_.store(true, std::memory_order_release);
+   }
+
+   /**
+    * Applies the volume and the downmix to the frames of the output block, then writes them to the sink.
+    */
+   void PlaybackEngine::output_(size_t frames)
+   {
+      const Dsp::Kernels& dsp = Dsp::kernels();
+      float target_gain = target_gain_.load(std::memory_order_relaxed);
+
+      if (gain_ != target_gain || gain_ != 1.0f)
+      {
+         // volume changes are spread over a block, so that they do not click
+         float gain_step = (target_gain - gain_) / static_cast<float>(block_frames_);
+         dsp.applyGain(output_block_.data(), frames, channels_, gain_, gain_step);
+         gain_ = frames == block_frames_ ? target_gain : gain_ + gain_step * static_cast<float>(frames);
+      }
+
+      if (downmix_active_)
+      {
+         dsp.downmixStereo(output_block_.data(), downmix_block_.data(), frames);
+         sink_->write(downmix_block_.data(), frames);
+      }
+      else
+      {
+         sink_->write(output_block_.data(), frames);
+      }
+   }
+
+}
@@ -0,0 +1,315 @@
+#include "Playlist.h"
+
+#include "PlaylistJournal.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace MusicPlayer
+{
+
+   Playlist::Playlist() :
+      current_(npos),
+      journal_(nullptr),
+      first_changed_(0)
+   {
+   }
+
+   void Playlist::reserve(size_t capacity)
+   {
+      entries_.reserve(capacity);
+      positions_.reserve(capacity);
+   }
+
+   Playlist::Handle Playlist::append(InternedString path, Track track)
+   {
+      Handle handle = static_cast<Handle>(positions_.size());
+
+      changedFrom_(entries_.size());
+      positions_.push_back(entries_.size());
+      entries_.push_back({ handle, path, std::move(track) });
+      handles_by_path_[path].push_back(handle);
+
+      if (journal_ != nullptr)
+         journal_->recordAppend(entries_.back());
+
+      return handle;
+   }
+
+   Playlist::Handle Playlist::append(std::string_view path, Track track)
+   {
+      return append(StringPool::shared().intern(path), std::move(track));
+   }
+
+   size_t Playlist::positionOf(Handle handle) const
+   {
+      return handle < positions_.size() ? positions_[handle] : npos;
+   }
+
+   std::vector<size_t> Playlist::positionsOf(InternedString path) const
+   {
+      std::vector<size_t> found_positions;
+
+      auto indexed = handles_by_path_.find(path);
+      if (indexed != handles_by_path_.end())
+      {
+         found_positions.reserve(indexed->second.size());
+         for (Handle handle : indexed->second)
+            found_positions.push_back(positions_[handle]);
+      }
+
+      return found_positions;
+   }
+
+   size_t Playlist::countOf(InternedString path) const
+   {
+      auto indexed = handles_by_path_.find(path);
+      return indexed != handles_by_path_.end() ? indexed->second.size() : 0;
+   }
+
+   size_t Playlist::erase(size_t position)
+   {
+      if (position >= entries_.size())
+         return npos;
+
+      changedFrom_(position);
+      positions_[entries_[position].handle] = npos;
+      unindex_(entries_[position]);
+      entries_.erase(entries_.begin() + position);
+
+      // only the entries after the removed one have moved
+      for (size_t moved = position; moved < entries_.size(); moved++)
+         positions_[entries_[moved].handle] = moved;
+
+      if (current_ != npos && current_ > position)
+         current_--;
+      else if (current_ == position && current_ >= entries_.size())
+         current_ = npos;
+
+      if (journal_ != nullptr)
+         journal_->recordRemove({ Range{ position, 1 } });
+
+      return position < entries_.size() ? position : npos;
+   }
+
+   size_t Playlist::removeRanges(std::vector<Range> ranges)
+   {
+      // sorted, clipped and merged, so that the entries kept between two ranges move as a block
+      std::sort(ranges.begin(), ranges.end(), [](const Range& left, const Range& right) { return left.first < right.first; });
+
+      std::vector<Range> removed_ranges;
+      for (Range range : ranges)
+      {
+         if (range.first >= entries_.size() || range.count == 0)
+            continue;
+
+         range.count = std::min(range.count, entries_.size() - range.first);
+
+         if (!removed_ranges.empty() && range.first <= removed_ranges.back().first + removed_ranges.back().count)
+         {
+            Range& merged = removed_ranges.back();
+            merged.count = std::max(merged.first + merged.count, range.first + range.count) - merged.first;
+         }
+         else
+         {
+            removed_ranges.push_back(range);
+         }
+      }
+
+      if (removed_ranges.empty())
+         return 0;
+
+      std::vector<InternedString> removed_paths;
+      size_t kept = removed_ranges.front().first;
+      size_t current = current_;
+
+      for (size_t idx = 0; idx < removed_ranges.size(); idx++)
+      {
+         size_t first_removed = removed_ranges[idx].first;
+         size_t first_kept = first_removed + removed_ranges[idx].count;
+         size_t end = idx + 1 < removed_ranges.size() ? removed_ranges[idx + 1].first : entries_.size();
+
+         for (size_t position = first_removed; position < first_kept; position++)
+         {
+            positions_[entries_[position].handle] = npos;
+            removed_paths.push_back(entries_[position].path);
+         }
+
+         // the selection follows its entry, or moves to the first entry kept after the removed one
+         if (current_ != npos && current_ >= first_removed && current_ < end)
+         {
+            if (current_ >= first_kept)
+               current = kept + (current_ - first_kept);
+            else
+               current = first_kept < end ? kept : npos;
+         }
+
+         std::move(entries_.begin() + first_kept, entries_.begin() + end, entries_.begin() + kept);
+
+         for (size_t moved = first_kept; moved < end; moved++, kept++)
+            positions_[entries_[kept].handle] = kept;
+      }
+
+      size_t removed = entries_.size() - kept;
+      entries_.erase(entries_.begin() + kept, entries_.end());
+      current_ = current;
+      changedFrom_(removed_ranges.front().first);
+
+      pruneIndex_(removed_paths);
+
+      if (journal_ != nullptr)
+         journal_->recordRemove(removed_ranges);
+
+      return removed;
+   }
+
+   size_t Playlist::keepRanges(std::vector<Range> ranges)
+   {
+      std::sort(ranges.begin(), ranges.end(), [](const Range& left, const Range& right) { return left.first < right.first; });
+
+      // the positions between the kept ranges
+      std::vector<Range> removed_ranges;
+      size_t position(0);
+
+      for (const Range& range : ranges)
+      {
+         if (range.first > position)
+            removed_ranges.push_back({ position, range.first - position });
+
+         if (range.first < entries_.size())
+            position = std::max(position, range.first + std::min(range.count, entries_.size() - range.first));
+      }
+
+      if (position < entries_.size())
+         removed_ranges.push_back({ position, entries_.size() - position });
+
+      return removeRanges(std::move(removed_ranges));
+   }
+
+   size_t Playlist::removeDuplicates()
+   {
+      // journaled as a single operation rather than as the removed positions
+      PlaylistJournal* journal = journal_;
+      journal_ = nullptr;
+
+      std::unordered_set<InternedString> paths;
+      size_t removed = removeIf([&paths](size_t, const Entry& entry)
+         {
+            // insertion fails for file names that were already seen
+            return !paths.insert(entry.path).second;
+         });
+
+      journal_ = journal;
+      if (journal_ != nullptr)
+         journal_->recordRemoveDuplicates();
+
+      return removed;
+   }
+
+   bool Playlist::move(Range range, size_t target)
+   {
+      if (range.first > entries_.size() || range.count > entries_.size() - range.first || target > entries_.size() - range.count)
+         return false;
+
+      Handle current_handle = current_ != npos ? entries_[current_].handle : kInvalidHandle;
+
+      // only the entries between the range and its target move
+      size_t first = std::min(range.first, target);
+      size_t last = std::max(range.first, target) + range.count;
+
+      if (target < range.first)
+         std::rotate(entries_.begin() + target, entries_.begin() + range.first, entries_.begin() + range.first + range.count);
+      else
+         std::rotate(entries_.begin() + range.first, entries_.begin() + range.first + range.count, entries_.begin() + target + range.count);
+
+      for (size_t moved = first; moved < last; moved++)
+         positions_[entries_[moved].handle] = moved;
+
+      changedFrom_(first);
+
+      if (current_handle != kInvalidHandle)
+         current_ = positions_[current_handle];
+
+      if (journal_ != nullptr)
+         journal_->recordMove(range, target);
+
+      return true;
+   }
+
+   void Playlist::clear()
+   {
+      for (const Entry& entry : entries_)
+         positions_[entry.handle] = npos;
+
+      entries_.clear();
+      handles_by_path_.clear();
+      current_ = npos;
+      changedFrom_(0);
+
+      if (journal_ != nullptr)
+         journal_->recordClear();
+   }
+
+   size_t Playlist::takeFirstChanged()
+   {
+      size_t first_changed = first_changed_;
+      first_changed_ = npos;
+      return first_changed;
+   }
+
+   bool Playlist::isJournaled_() const
+   {
+      return journal_ != nullptr && journal_->isRecording();
+   }
+
+   void Playlist::journalRemoved_(const std::vector<Range>& ranges)
+   {
+      journal_->recordRemove(ranges);
+   }
+
+   void Playlist::unindex_(const Entry& entry)
+   {
+      auto indexed = handles_by_path_.find(entry.path);
+      if (indexed == handles_by_path_.end())
+         return;
+
+      std::vector<Handle>& handles = indexed->second;
+
+      if (handles.size() == 1)
+      {
+         handles_by_path_.erase(indexed);
+         return;
+      }
+
+      // the order of the handles does not matter
+      auto found = std::find(handles.begin(), handles.end(), entry.handle);
+      if (found != handles.end())
+      {
+         *found = handles.back();
+         handles.pop_back();
+      }
+   }
+
+   void Playlist::pruneIndex_(const std::vector<InternedString>& paths)
+   {
+      // each file is pruned once, whatever the number of its entries that were removed
+      std::unordered_set<InternedString> pruned;
+
+      for (InternedString path : paths)
+      {
+         if (!pruned.insert(path).second)
+            continue;
+
+         auto indexed = handles_by_path_.find(path);
+         if (indexed == handles_by_path_.end())
+            continue;
+
+         std::vector<Handle>& handles = indexed->second;
+         handles.erase(std::remove_if(handles.begin(), handles.end(), [this](Handle handle) { return positions_[handle] == npos; }), handles.end());
+
+         if (handles.empty())
+            handles_by_path_.erase(indexed);
+      }
+   }
+
+}
@@ -0,0 +1,495 @@
+#include "PlaylistJournal.h"
+
+#include "BinaryPlaylist.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+   using MusicPlayer::Codec;
+   using MusicPlayer::Playlist;
+   using MusicPlayer::PlaylistJournal;
+   using MusicPlayer::ReplayGain;
+   using MusicPlayer::Track;
+
+   namespace fs = std::filesystem;
+
+   constexpr char kMagic[4] = { 'I', 'P', 'L', 'J' };
+
+   // payload size and checksum
+   constexpr size_t kRecordHeaderSize = 8;
+
+   enum Operation : unsigned char
+   {
+      kAppend = 1,
+      kRemove = 2,
+      kRemoveDuplicates = 3,
+      kMove = 4,
+      kClear = 5
+   };
+
+   // operation, duration, codec, ReplayGain flag, gain, peak, path and title lengths
+   constexpr size_t kAppendSize = 1 + 4 + 1 + 1 + 4 + 4 + 4 + 4;
+
+   void putUInt(std::string& out, std::uint64_t value, size_t byte_count)
+   {
+      for (size_t idx = 0; idx < byte_count; idx++)
+         out.push_back(static_cast<char>((value >> (8 * idx)) & 0xFF));
+   }
+
+   std::uint64_t getUInt(const char* in, size_t byte_count)
+   {
+      std::uint64_t value(0);
+      for (size_t idx = 0; idx < byte_count; idx++)
+         value |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[idx])) << (8 * idx);
+      return value;
+   }
+
+   std::uint32_t floatBits(float value)
+   {
+      std::uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      return bits;
+   }
+
+   float bitsFloat(std::uint64_t bits)
+   {
+      auto narrowed = static_cast<std::uint32_t>(bits);
+      float value;
+      std::memcpy(&value, &narrowed, sizeof(value));
+      return value;
+   }
+
+   std::uint32_t checksum(std::string_view payload)
+   {
+      std::uint32_t hash = 2166136261u;
+      for (char byte : payload)
+      {
+         hash ^= static_cast<unsigned char>(byte);
+         hash *= 16777619u;
+      }
+      return hash;
+   }
+
+   std::string absolutePath(const std::string& file_name)
+   {
+      std::error_code error;
+      fs::path absolute = fs::absolute(fs::path(file_name), error);
+      return error ? file_name : absolute.lexically_normal().string();
+   }
+
+   /**
+    * \brief Applies one journal record to a playlist.
+    *
+    * \return false if the record is malformed or does not apply to the playlist.
+    */
+   bool replay(std::string_view payload, Playlist& playlist)
+   {
+      const char* data = payload.data();
+
+      switch (static_cast<unsigned char>(payload[0]))
+      {
+      case kAppend:
+      {
+         if (payload.size() < kAppendSize)
+            return false;
+
+         size_t codec = getUInt(data + 5, 1);
+         bool has_replay_gain = data[6] != 0;
+         float gain_db = bitsFloat(getUInt(data + 7, 4));
+         size_t path_size = getUInt(data + 15, 4);
+         size_t title_size = getUInt(data + 19, 4);
+
+         if (codec >= Codec::kTypeCount || path_size == 0 || payload.size() != kAppendSize + path_size + title_size
+            || (has_replay_gain && !std::isfinite(gain_db)))
+            return false;
+
+         Track track(payload.substr(kAppendSize + path_size, title_size), static_cast<time_t>(getUInt(data + 1, 4)), static_cast<Codec::Type>(codec));
+         if (has_replay_gain)
+            track.setReplayGain(ReplayGain{ gain_db, bitsFloat(getUInt(data + 11, 4)) });
+
+         playlist.append(payload.substr(kAppendSize, path_size), std::move(track));
+         return true;
+      }
+      case kRemove:
+      {
+         if (payload.size() < 5)
+            return false;
+
+         size_t range_count = getUInt(data + 1, 4);
+         if (payload.size() != 5 + 8 * range_count)
+            return false;
+
+         // positions before the removal, in increasing order
+         std::vector<Playlist::Range> ranges(range_count);
+         size_t end(0);
+
+         for (size_t idx = 0; idx < range_count; idx++)
+         {
+            ranges[idx] = { getUInt(data + 5 + 8 * idx, 4), getUInt(data + 9 + 8 * idx, 4) };
+
+            if (ranges[idx].first < end || ranges[idx].count == 0 || ranges[idx].first + ranges[idx].count > playlist.size())
+               return false;
+
+            end = ranges[idx].first + ranges[idx].count;
+         }
+
+         playlist.removeRanges(std::move(ranges));
+         return true;
+      }
+      case kRemoveDuplicates:
+         if (payload.size() != 1)
+            return false;
+
+         playlist.removeDuplicates();
+         return true;
+      case kMove:
+         return payload.size() == 13
+            && playlist.move({ getUInt(data + 1, 4), getUInt(data + 5, 4) }, getUInt(data + 9, 4));
+      case kClear:
+         if (payload.size() != 1)
+            return false;
+
+         playlist.clear();
+         return true;
+      default:
+         return false;
+      }
+   }
+
+   /**
+    * \brief Writes the buffered data of a file to the disk.
+    */
+   bool syncFile(std::FILE* file)
+   {
+      if (std::fflush(file) != 0)
+         return false;
+
+#ifdef _WIN32
+      return _commit(_fileno(file)) == 0;
+#else
+      return ::fsync(fileno(file)) == 0;
+#endif
+   }
+}
+
+namespace MusicPlayer
+{
+
+   PlaylistJournal::PlaylistJournal() :
+      file_size_(0),
+      snapshot_size_(0),
+      journal_size_(0),
+      pending_count_(0),
+      overflowed_(false)
+   {
+   }
+
+   bool PlaylistJournal::isJournaledPlaylist(std::string_view file_name)
+   {
+      std::string_view extension(kExtension);
+      return file_name.size() >= extension.size()
+         && file_name.compare(file_name.size() - extension.size(), extension.size(), extension) == 0;
+   }
+
+   bool PlaylistJournal::save(const std::string& file_name, const Playlist& playlist, SaveReport& report, std::string& error)
+   {
+      std::string path = absolutePath(file_name);
+
+      // the file must still end where the last records were written
+      std::error_code status_error;
+      std::uintmax_t file_size = fs::file_size(path, status_error);
+
+      if (path != file_name_ || overflowed_ || status_error || file_size != file_size_
+         || journal_size_ + pending_.size() > std::max(kCompactionMinSize, snapshot_size_))
+         return rewrite_(path, playlist, report, error);
+
+      report.record_count = pending_count_;
+
+      if (pending_.empty())
+         return true;
+
+      std::FILE* file = std::fopen(path.c_str(), "ab");
+      if (file == nullptr)
+      {
+         error = "File \"" + file_name + "\" could not be opened.";
+         return false;
+      }
+
+      bool written = std::fwrite(pending_.data(), 1, pending_.size(), file) == pending_.size();
+      written = std::fclose(file) == 0 && written;
+
+      if (!written)
+      {
+         // the records that reached the file may end with a cut one: the next save rewrites the file
+         file_size_ = 0;
+         error = "File \"" + file_name + "\" could not be written.";
+         return false;
+      }
+
+      report.written_bytes = pending_.size();
+
+      file_size_ += pending_.size();
+      journal_size_ += pending_.size();
+      pending_.clear();
+      pending_count_ = 0;
+
+      return true;
+   }
+
+   bool PlaylistJournal::load(const std::string& file_name, Playlist& playlist, PlaylistLoader::Report& report, std::string& error)
+   {
+      auto start = std::chrono::steady_clock::now();
+
+      MappedFile file;
+      if (!file.open(file_name))
+      {
+         error = "File \"" + file_name + "\" could not be opened.";
+         return false;
+      }
+
+      std::string_view contents = file.view();
+
+      if (contents.size() < kHeaderSize || std::memcmp(contents.data(), kMagic, sizeof(kMagic)) != 0)
+      {
+         error = "File \"" + file_name + "\" is not a journaled playlist.";
+         return false;
+      }
+
+      if (getUInt(contents.data() + 4, 2) != kVersion)
+      {
+         error = "File \"" + file_name + "\" uses an unsupported journaled playlist version.";
+         return false;
+      }
+
+      std::uint64_t snapshot_size = getUInt(contents.data() + 8, 8);
+      if (snapshot_size > contents.size() - kHeaderSize)
+      {
+         error = "File \"" + file_name + "\" is truncated or corrupted.";
+         return false;
+      }
+
+      // the journal is replayed on a separate playlist, so that a corrupted file does not add anything
+      Playlist replayed;
+      PlaylistLoader::Report snapshot_report;
+
+      if (!BinaryPlaylist::decode(contents.substr(kHeaderSize, snapshot_size), file_name, replayed, snapshot_report, error))
+         return false;
+
+      size_t record_count(0);
+      size_t offset = kHeaderSize + snapshot_size;
+
+      while (contents.size() - offset >= kRecordHeaderSize)
+      {
+         size_t payload_size = getUInt(contents.data() + offset, 4);
+         if (payload_size == 0 || payload_size > contents.size() - offset - kRecordHeaderSize)
+            break;
+
+         std::string_view payload = contents.substr(offset + kRecordHeaderSize, payload_size);
+         if (checksum(payload) != getUInt(contents.data() + offset + 4, 4))
+            break;
+
+         record_count++;
+
+         if (!replay(payload, replayed))
+         {
+            error = "Journal record #" + std::to_string(record_count) + " of file \"" + file_name + "\" is corrupted.";
+            return false;
+         }
+
+         offset += kRecordHeaderSize + payload_size;
+      }
+
+      // appending the entries must not be recorded against the previous file
+      bool was_empty = playlist.empty();
+      detach_();
+
+      playlist.reserve(playlist.size() + replayed.size());
+      for (const Playlist::Entry& entry : replayed)
+         playlist.append(entry.path, entry.track);
+
+      if (was_empty)
+      {
+         // a cut record at the end makes the file size differ, so the next save rewrites the file
+         file_name_ = absolutePath(file_name);
+         file_size_ = offset;
+         snapshot_size_ = snapshot_size;
+         journal_size_ = offset - kHeaderSize - snapshot_size;
+      }
+
+      report.line_count = snapshot_report.line_count + record_count;
+      report.loaded_count = replayed.size();
+      report.chunk_count = 1;
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      report.seconds = elapsed.count();
+
+      return true;
+   }
+
+   void PlaylistJournal::recordAppend(const Playlist::Entry& entry)
+   {
+      if (!isRecording())
+         return;
+
+      const Track& track = entry.track;
+      std::string_view title = track.getTitle();
+      ReplayGain replay_gain = track.getReplayGain().value_or(ReplayGain());
+
+      std::string payload;
+      payload.reserve(kAppendSize + entry.path.size() + title.size());
+
+      putUInt(payload, kAppend, 1);
+      putUInt(payload, static_cast<std::uint64_t>(track.getDuration()), 4);
+      putUInt(payload, static_cast<std::uint64_t>(track.getCodec()), 1);
+      putUInt(payload, track.getReplayGain() ? 1 : 0, 1);
+      putUInt(payload, floatBits(replay_gain.gain_db), 4);
+      putUInt(payload, floatBits(replay_gain.peak), 4);
+      putUInt(payload, entry.path.size(), 4);
+      putUInt(payload, title.size(), 4);
+      payload.append(entry.path.view());
+      payload.append(title);
+
+      addRecord_(payload);
+   }
+
+   void PlaylistJournal::recordRemove(const std::vector<Playlist::Range>& ranges)
+   {
+      if (!isRecording())
+         return;
+
+      std::string payload;
+      payload.reserve(5 + 8 * ranges.size());
+
+      putUInt(payload, kRemove, 1);
+      putUInt(payload, ranges.size(), 4);
+
+      for (const Playlist::Range& range : ranges)
+      {
+         putUInt(payload, range.first, 4);
+         putUInt(payload, range.count, 4);
+      }
+
+      addRecord_(payload);
+   }
+
+   void PlaylistJournal::recordRemoveDuplicates()
+   {
+      if (isRecording())
+         addRecord_(std::string(1, static_cast<char>(kRemoveDuplicates)));
+   }
+
+   void PlaylistJournal::recordMove(Playlist::Range range, size_t target)
+   {
+      if (!isRecording())
+         return;
+
+      std::string payload;
+      putUInt(payload, kMove, 1);
+      putUInt(payload, range.first, 4);
+      putUInt(payload, range.count, 4);
+      putUInt(payload, target, 4);
+
+      addRecord_(payload);
+   }
+
+   void PlaylistJournal::recordClear()
+   {
+      if (isRecording())
+         addRecord_(std::string(1, static_cast<char>(kClear)));
+   }
+
+   void PlaylistJournal::addRecord_(const std::string& payload)
+   {
+      putUInt(pending_, payload.size(), 4);
+      putUInt(pending_, checksum(payload), 4);
+      pending_.append(payload);
+      pending_count_++;
+
+      // the next save rewrites the file anyway, so the records do not need to be kept
+      if (journal_size_ + pending_.size() > std::max(kCompactionMinSize, snapshot_size_))
+      {
+         overflowed_ = true;
+         pending_.clear();
+         pending_count_ = 0;
+      }
+   }
+
+   void PlaylistJournal::detach_()
+   {
+      file_name_.clear();
+      file_size_ = 0;
+      snapshot_size_ = 0;
+      journal_size_ = 0;
+      pending_.clear();
+      pending_count_ = 0;
+      overflowed_ = false;
+   }
+
+   bool PlaylistJournal::rewrite_(const std::string& file_name, const Playlist& playlist, SaveReport& report, std::string& error)
+   {
+      std::string snapshot;
+      if (!BinaryPlaylist::encode(playlist, snapshot, error))
+         return false;
+
+      std::string image(kMagic, sizeof(kMagic));
+      image.reserve(kHeaderSize + snapshot.size());
+      putUInt(image, kVersion, 2);
+      putUInt(image, 0, 2);
+      putUInt(image, snapshot.size(), 8);
+      image.append(snapshot);
+
+      // the new file replaces the previous one only once it is complete on the disk
+      std::string temporary_name = file_name + ".tmp";
+      std::FILE* temporary = std::fopen(temporary_name.c_str(), "wb");
+      if (temporary == nullptr)
+      {
+         error = "File \"" + temporary_name + "\" could not be created.";
+         return false;
+      }
+
+      bool written = std::fwrite(image.data(), 1, image.size(), temporary) == image.size() && syncFile(temporary);
+      written = std::fclose(temporary) == 0 && written;
+
+      std::error_code rename_error;
+      if (written)
+         fs::rename(temporary_name, file_name, rename_error);
+
+      if (!written || rename_error)
+      {
+         std::error_code remove_error;
+         fs::remove(temporary_name, remove_error);
+
+         error = "File \"" + file_name + "\" could not be written.";
+         return false;
+      }
+
+      file_name_ = file_name;
+      file_size_ = image.size();
+      snapshot_size_ = snapshot.size();
+      journal_size_ = 0;
+      pending_.clear();
+      pending_count_ = 0;
+      overflowed_ = false;
+
+      report.written_bytes = image.size();
+      report.compacted = true;
+      report.record_count = playlist.size();
+
+      return true;
+   }
+
+}
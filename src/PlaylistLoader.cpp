@@ -0,0 +1,225 @@
+#include "PlaylistLoader.h"
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <vector>
+
+namespace
+{
+   using MusicPlayer::InternedString;
+   using MusicPlayer::PlaylistLoader;
+   using MusicPlayer::StringPool;
+   using MusicPlayer::Track;
+
+   struct ParsedTrack
+   {
+      InternedString path;
+      Track track;
+   };
+
+   struct Chunk
+   {
+      std::vector<ParsedTrack> tracks;
+      PlaylistLoader::Report report;
+
+      // number of lines in the chunk, including the empty ones
+      size_t line_count = 0;
+   };
+
+   /**
+    * \brief Parses all lines of a playlist text, and hands each valid track over to a callback.
+    *
+    * \param contents The text to parse.
+    * \param report Receives the statistics of the parsing. Line numbers are relative to the start of the text.
+    * \param on_track Called with the file name and the track of each valid line.
+    * \return The number of lines in the text, including the empty ones.
+    */
+   template <typename Callback>
+   size_t parseLines(std::string_view contents, PlaylistLoader::Report& report, Callback on_track)
+   {
+      size_t line_number(0);
+
+      while (!contents.empty())
+      {
+         size_t line_end = contents.find('\n');
+         std::string_view line = contents.substr(0, line_end);
+         contents.remove_prefix(line_end == std::string_view::npos ? contents.size() : line_end + 1);
+
+         line_number++;
+
+         if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+         if (line.empty())
+            continue;
+
+         report.line_count++;
+
+         std::string_view track_file;
+         Track new_track;
+         std::string error;
+
+         if (!PlaylistLoader::parseLine(line, track_file, new_track, error))
+         {
+            if (report.malformed_count++ == 0)
+            {
+               report.first_malformed_line = line_number;
+               report.first_error = std::move(error);
+            }
+            continue;
+         }
+
+         on_track(track_file, std::move(new_track));
+         report.loaded_count++;
+      }
+
+      return line_number;
+   }
+
+   size_t countLines(std::string_view contents)
+   {
+      return std::count(contents.begin(), contents.end(), '\n') + 1;
+   }
+}
+
+namespace MusicPlayer
+{
+
+   bool PlaylistLoader::load(const std::string& file_name, Playlist& playlist, Report& report)
+   {
+      return load(file_name, playlist, report, ThreadPool::shared());
+   }
+
+   bool PlaylistLoader::load(const std::string& file_name, Playlist& playlist, Report& report, ThreadPool& pool)
+   {
+      auto start = std::chrono::steady_clock::now();
+
+      MappedFile file;
+      if (!file.open(file_name))
+         return false;
+
+      if (file.size() >= kParallelThreshold && pool.size() > 1)
+         parseParallel(file.view(), playlist, report, pool);
+      else
+         parse(file.view(), playlist, report);
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      report.seconds = elapsed.count();
+
+      return true;
+   }
+
+   void PlaylistLoader::parse(std::string_view contents, Playlist& playlist, Report& report)
+   {
+      playlist.reserve(playlist.size() + countLines(contents));
+
+      parseLines(contents, report, [&playlist](std::string_view track_file, Track&& track)
+         {
+            playlist.append(track_file, std::move(track));
+         });
+
+      report.chunk_count = 1;
+   }
+
+   void PlaylistLoader::parseParallel(std::string_view contents, Playlist& playlist, Report& report, ThreadPool& pool, size_t chunk_count)
+   {
+      if (chunk_count == 0)
+         chunk_count = pool.size() * 4;
+
+      // cut the text in chunks of similar size, ending on line breaks
+      std::vector<std::string_view> chunk_contents;
+      size_t target_size = contents.size() / chunk_count + 1;
+
+      while (!contents.empty())
+      {
+         size_t chunk_end = contents.size() <= target_size ? std::string_view::npos : contents.find('\n', target_size);
+         chunk_end = chunk_end == std::string_view::npos ? contents.size() : chunk_end + 1;
+
+         chunk_contents.push_back(contents.substr(0, chunk_end));
+         contents.remove_prefix(chunk_end);
+      }
+
+      std::vector<std::future<Chunk>> pending_chunks;
+      pending_chunks.reserve(chunk_contents.size());
+
+      for (std::string_view text : chunk_contents)
+      {
+         pending_chunks.push_back(pool.submit(ThreadPool::Priority::Background, [text]()
+            {
+               Chunk chunk;
+               chunk.tracks.reserve(countLines(text));
+               chunk.line_count = parseLines(text, chunk.report, [&chunk](std::string_view track_file, Track&& track)
+                  {
+                     chunk.tracks.push_back({ StringPool::shared().intern(track_file), std::move(track) });
+                  });
+
+               return chunk;
+            }));
+      }
+
+      // merge the chunks back in file order
+      std::vector<Chunk> chunks;
+      chunks.reserve(pending_chunks.size());
+
+      size_t track_count(0);
+      for (std::future<Chunk>& pending_chunk : pending_chunks)
+      {
+         chunks.push_back(pending_chunk.get());
+         track_count += chunks.back().tracks.size();
+      }
+
+      playlist.reserve(playlist.size() + track_count);
+
+      size_t first_line_of_chunk(0);
+      for (Chunk& chunk : chunks)
+      {
+         for (ParsedTrack& parsed : chunk.tracks)
+            playlist.append(parsed.path, std::move(parsed.track));
+
+         report.line_count += chunk.report.line_count;
+         report.loaded_count += chunk.report.loaded_count;
+
+         if (chunk.report.malformed_count > 0 && report.malformed_count == 0)
+         {
+            report.first_malformed_line = first_line_of_chunk + chunk.report.first_malformed_line;
+            report.first_error = std::move(chunk.report.first_error);
+         }
+
+         report.malformed_count += chunk.report.malformed_count;
+         first_line_of_chunk += chunk.line_count;
+
+         // release the chunk memory as soon as it is merged
+         chunk.tracks = std::vector<ParsedTrack>();
+      }
+
+      report.chunk_count = chunks.size();
+   }
+
+   bool PlaylistLoader::parseLine(std::string_view line, std::string_view& track_file, Track& track, std::string& error)
+   {
+      // expected: "<Track file>||<Track infos>"
+      // split on the first separator only: the tokenizer would skip an empty file name
+      size_t separator = line.find("||");
+
+      if (separator == std::string_view::npos || separator == 0)
+      {
+         error = "Expected a record of the form <file>||<title>;<mm:ss>;<codec>.";
+         return false;
+      }
+
+      track_file = line.substr(0, separator);
+
+      if (!track.deserialize(line.substr(separator + 2)))
+      {
+         error = track.getErrorMessage();
+         return false;
+      }
+
+      return true;
+   }
+
+}
@@ -0,0 +1,170 @@
+#include "PlaylistSnapshot.h"
+
+#include <algorithm>
+
+namespace MusicPlayer
+{
+
+   PlaylistSnapshot::PlaylistSnapshot() :
+      blocks_(std::make_shared<const BlockList>()),
+      size_(0),
+      current_(Playlist::npos),
+      is_playing_(false),
+      random_mode_(false),
+      repeat_mode_(false),
+      version_(0)
+   {
+   }
+
+   PlaylistSnapshots::Reader::Reader(PlaylistSnapshots& snapshots) :
+      snapshots_(snapshots),
+      slot_(std::make_unique<Slot>())
+   {
+      std::lock_guard<std::mutex> lock(snapshots_.readers_mutex_);
+      snapshots_.slots_.push_back(slot_.get());
+   }
+
+   PlaylistSnapshots::Reader::~Reader()
+   {
+      std::lock_guard<std::mutex> lock(snapshots_.readers_mutex_);
+      snapshots_.slots_.erase(std::find(snapshots_.slots_.begin(), snapshots_.slots_.end(), slot_.get()));
+   }
+
+   const PlaylistSnapshot& PlaylistSnapshots::Reader::acquire()
+   {
+      // announced before the snapshot is loaded: the writer either sees the announcement, and keeps the snapshots
+      // replaced since this epoch, or published its replacement before, so that it is not the one loaded
+      slot_->epoch.store(snapshots_.epoch_.load());
+      return *snapshots_.current_.load();
+   }
+
+   void PlaylistSnapshots::Reader::release()
+   {
+      slot_->epoch.store(kIdle, std::memory_order_release);
+   }
+
+   PlaylistSnapshots::PlaylistSnapshots() :
+      current_(new PlaylistSnapshot()),
+      epoch_(0),
+      published_(0),
+      reused_chunks_(0),
+      copied_chunks_(0),
+      retired_count_(0)
+   {
+   }
+
+   PlaylistSnapshots::~PlaylistSnapshots()
+   {
+      for (const auto& [snapshot, epoch] : retired_)
+         delete snapshot;
+
+      delete current_.load();
+   }
+
+   void PlaylistSnapshots::publish(Playlist& playlist, bool is_playing, bool random_mode, bool repeat_mode)
+   {
+      const PlaylistSnapshot* previous = current_.load(std::memory_order_relaxed);
+      size_t first_changed = playlist.takeFirstChanged();
+
+      if (first_changed == Playlist::npos && previous->current_ == playlist.currentPosition() && previous->is_playing_ == is_playing
+         && previous->random_mode_ == random_mode && previous->repeat_mode_ == repeat_mode)
+         return;
+
+      auto snapshot = new PlaylistSnapshot();
+      snapshot->size_ = playlist.size();
+      snapshot->current_ = playlist.currentPosition();
+      snapshot->is_playing_ = is_playing;
+      snapshot->random_mode_ = random_mode;
+      snapshot->repeat_mode_ = repeat_mode;
+      snapshot->version_ = previous->version_ + 1;
+
+      if (first_changed == Playlist::npos)
+      {
+         snapshot->blocks_ = previous->blocks_;
+      }
+      else
+      {
+         constexpr size_t kChunkSize = PlaylistSnapshot::kChunkSize;
+         constexpr size_t kBlockSize = PlaylistSnapshot::kBlockSize;
+
+         // the chunks that end before the first changed position are shared with the previous snapshot
+         size_t reused = std::min(first_changed, previous->size_) / kChunkSize;
+         size_t reused_blocks = reused / kBlockSize;
+
+         auto blocks = std::make_shared<PlaylistSnapshot::BlockList>(previous->blocks_->begin(), previous->blocks_->begin() + reused_blocks);
+         std::shared_ptr<PlaylistSnapshot::Block> block;
+
+         if (reused % kBlockSize != 0)
+         {
+            const PlaylistSnapshot::Block& partial = *(*previous->blocks_)[reused_blocks];
+            block = std::make_shared<PlaylistSnapshot::Block>(partial.begin(), partial.begin() + reused % kBlockSize);
+         }
+
+         for (size_t first = reused * kChunkSize; first < snapshot->size_; first += kChunkSize)
+         {
+            if (!block)
+            {
+               block = std::make_shared<PlaylistSnapshot::Block>();
+               block->reserve(kBlockSize);
+            }
+
+            size_t last = std::min(first + kChunkSize, snapshot->size_);
+            block->push_back(std::make_shared<const PlaylistSnapshot::Chunk>(playlist.begin() + first, playlist.begin() + last));
+
+            if (block->size() == kBlockSize)
+               blocks->push_back(std::move(block));
+         }
+
+         if (block)
+            blocks->push_back(std::move(block));
+
+         reused_chunks_.fetch_add(reused, std::memory_order_relaxed);
+         copied_chunks_.fetch_add((snapshot->size_ + kChunkSize - 1) / kChunkSize - reused, std::memory_order_relaxed);
+         snapshot->blocks_ = std::move(blocks);
+      }
+
+      published_.fetch_add(1, std::memory_order_relaxed);
+
+      std::uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+      current_.store(snapshot);
+      retired_.emplace_back(previous, epoch);
+      epoch_.store(epoch + 1);
+
+      reclaim_();
+   }
+
+   PlaylistSnapshots::Statistics PlaylistSnapshots::getStatistics() const
+   {
+      Statistics statistics;
+      statistics.published = published_.load(std::memory_order_relaxed);
+      statistics.reused_chunks = reused_chunks_.load(std::memory_order_relaxed);
+      statistics.copied_chunks = copied_chunks_.load(std::memory_order_relaxed);
+      statistics.retired = retired_count_.load(std::memory_order_relaxed);
+      return statistics;
+   }
+
+   void PlaylistSnapshots::reclaim_()
+   {
+      std::uint64_t oldest_pinned(Reader::kIdle);
+
+      {
+         std::lock_guard<std::mutex> lock(readers_mutex_);
+         for (const Reader::Slot* slot : slots_)
+            oldest_pinned = std::min(oldest_pinned, slot->epoch.load());
+      }
+
+      // a snapshot replaced in epoch E may be pinned by the readers that announced E or an earlier epoch
+      auto reclaimed = std::remove_if(retired_.begin(), retired_.end(), [oldest_pinned](const auto& retired)
+         {
+            if (retired.second >= oldest_pinned)
+               return false;
+
+            delete retired.first;
+            return true;
+         });
+
+      retired_.erase(reclaimed, retired_.end());
+      retired_count_.store(retired_.size(), std::memory_order_relaxed);
+   }
+
+}
@@ -0,0 +1,339 @@
+#include "PlaylistView.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <string_view>
+
+namespace
+{
+   using MusicPlayer::Playlist;
+   using MusicPlayer::PlaylistView;
+
+   // the sort is split across the pool in parts of at least this many entries
+   constexpr size_t kMinSortPartSize = 1 << 15;
+
+   /**
+    * \brief Whether an entry comes before another in the order of a view. Equal entries are in the order they were added.
+    */
+   bool precedes(PlaylistView::Order order, const Playlist::Entry& left, const Playlist::Entry& right)
+   {
+      switch (order)
+      {
+      case PlaylistView::Order::Title:
+      {
+         int comparison = left.track.getTitle().view().compare(right.track.getTitle().view());
+         if (comparison != 0)
+            return comparison < 0;
+         break;
+      }
+      case PlaylistView::Order::Duration:
+         if (left.track.getDuration() != right.track.getDuration())
+            return left.track.getDuration() < right.track.getDuration();
+         break;
+      case PlaylistView::Order::Codec:
+         if (left.track.getCodec() != right.track.getCodec())
+            return MusicPlayer::Codec::getCodecName(left.track.getCodec()) < MusicPlayer::Codec::getCodecName(right.track.getCodec());
+         break;
+      case PlaylistView::Order::Playlist:
+         break;
+      }
+
+      return left.handle < right.handle;
+   }
+
+   /**
+    * \brief An entry to sort, with a key that orders most pairs of entries without accessing them.
+    */
+   struct SortItem
+   {
+      std::uint64_t key;
+      Playlist::Handle handle;
+      std::uint32_t position;
+   };
+
+   // the first 8 bytes of a string, ordered as the string
+   std::uint64_t prefixKey(std::string_view text)
+   {
+      std::uint64_t key(0);
+      for (size_t idx = 0; idx < 8; idx++)
+         key = (key << 8) | (idx < text.size() ? static_cast<unsigned char>(text[idx]) : 0);
+
+      return key;
+   }
+
+   std::uint64_t sortKey(PlaylistView::Order order, const Playlist::Entry& entry)
+   {
+      switch (order)
+      {
+      case PlaylistView::Order::Title:
+         return prefixKey(entry.track.getTitle().view());
+      case PlaylistView::Order::Duration:
+         // the sign bit flipped, so that invalid durations come first
+         return static_cast<std::uint64_t>(static_cast<std::int64_t>(entry.track.getDuration())) ^ (std::uint64_t(1) << 63);
+      case PlaylistView::Order::Codec:
+         return prefixKey(MusicPlayer::Codec::getCodecName(entry.track.getCodec()));
+      default:
+         return 0;
+      }
+   }
+
+   /**
+    * \brief Sorts items whose titles are equal up to an offset, keyed by the 8 bytes of their titles from the offset.
+    *
+    * Runs of items with the same key are sorted again on the next 8 bytes, so that most comparisons are between keys
+    * rather than between titles. The keys are restored once sorted.
+    */
+   void sortByTitle(const Playlist& playlist, SortItem* first, SortItem* last, size_t offset)
+   {
+      std::sort(first, last, [](const SortItem& left, const SortItem& right)
+         {
+            return left.key != right.key ? left.key < right.key : left.handle < right.handle;
+         });
+
+      for (SortItem* run = first; run != last;)
+      {
+         SortItem* end = run + 1;
+         while (end != last && end->key == run->key)
+            end++;
+
+         // a key ending with a null byte ends the titles: the run is already in handle order
+         std::uint64_t key = run->key;
+         if (end - run > 1 && (key & 0xFF) != 0)
+         {
+            for (SortItem* item = run; item != end; item++)
+            {
+               std::string_view title = playlist[item->position].track.getTitle().view();
+               item->key = prefixKey(title.substr(std::min(title.size(), offset + 8)));
+            }
+
+            sortByTitle(playlist, run, end, offset + 8);
+
+            for (SortItem* item = run; item != end; item++)
+               item->key = key;
+         }
+
+         run = end;
+      }
+   }
+
+   /**
+    * \brief Sorts the parts of the entries on the pool, then merges them pairwise, each round of merges in parallel.
+    */
+   void parallelSort(const Playlist& playlist, std::vector<SortItem>& items, PlaylistView::Order order, MusicPlayer::ThreadPool& pool)
+   {
+      // only titles with the same prefix are compared entirely
+      auto compare = [&playlist, order](const SortItem& left, const SortItem& right)
+         {
+            if (left.key != right.key)
+               return left.key < right.key;
+
+            if (order == PlaylistView::Order::Title)
+            {
+               int comparison = playlist[left.position].track.getTitle().view().compare(playlist[right.position].track.getTitle().view());
+               if (comparison != 0)
+                  return comparison < 0;
+            }
+
+            return left.handle < right.handle;
+         };
+
+      size_t part_count(1);
+      while (part_count < pool.size() && items.size() / (part_count * 2) >= kMinSortPartSize)
+         part_count *= 2;
+
+      auto sortPart = [&playlist, &items, &compare, order](size_t first, size_t last)
+         {
+            if (order == PlaylistView::Order::Title)
+               sortByTitle(playlist, items.data() + first, items.data() + last, 0);
+            else
+               std::sort(items.begin() + first, items.begin() + last, compare);
+         };
+
+      if (part_count == 1)
+      {
+         sortPart(0, items.size());
+         return;
+      }
+
+      std::vector<size_t> bounds(part_count + 1);
+      for (size_t part = 0; part <= part_count; part++)
+         bounds[part] = items.size() * part / part_count;
+
+      std::vector<std::future<void>> jobs;
+      for (size_t part = 0; part < part_count; part++)
+      {
+         jobs.push_back(pool.submit(MusicPlayer::ThreadPool::Priority::Background, [&sortPart, first = bounds[part], last = bounds[part + 1]]()
+            {
+               sortPart(first, last);
+            }));
+      }
+
+      for (std::future<void>& job : jobs)
+         job.get();
+
+      for (size_t width = 1; width < part_count; width *= 2)
+      {
+         jobs.clear();
+
+         for (size_t part = 0; part + width < part_count; part += 2 * width)
+         {
+            size_t first = bounds[part], middle = bounds[part + width], last = bounds[std::min(part + 2 * width, part_count)];
+
+            jobs.push_back(pool.submit(MusicPlayer::ThreadPool::Priority::Background, [&items, &compare, first, middle, last]()
+               {
+                  std::inplace_merge(items.begin() + first, items.begin() + middle, items.begin() + last, compare);
+               }));
+         }
+
+         for (std::future<void>& job : jobs)
+            job.get();
+      }
+   }
+}
+
+namespace MusicPlayer
+{
+
+   bool PlaylistView::Filter::matches(const Track& track) const
+   {
+      return (!codec || track.getCodec() == *codec)
+         && (!longer_than || track.getDuration() > *longer_than)
+         && (!shorter_than || track.getDuration() < *shorter_than);
+   }
+
+   PlaylistView::PlaylistView() :
+      defined_(false),
+      order_(Order::Playlist),
+      known_handles_(0),
+      known_size_(0)
+   {
+   }
+
+   void PlaylistView::define(const Playlist& playlist, Order order, const Filter& filter)
+   {
+      define(playlist, order, filter, ThreadPool::shared());
+   }
+
+   void PlaylistView::define(const Playlist& playlist, Order order, const Filter& filter, ThreadPool& pool)
+   {
+      defined_ = true;
+      order_ = order;
+      filter_ = filter;
+
+      build_(playlist, pool);
+   }
+
+   void PlaylistView::refresh(const Playlist& playlist)
+   {
+      if (!defined_)
+         return;
+
+      // moved entries change the playlist order, which is cheaper to rebuild than to sort
+      if (order_ == Order::Playlist)
+      {
+         build_(playlist, ThreadPool::shared());
+         return;
+      }
+
+      // handles are never reused: without removal, the playlist grew by the number of new handles
+      if (playlist.size() < known_size_ + (playlist.handleCount() - known_handles_))
+      {
+         handles_.erase(std::remove_if(handles_.begin(), handles_.end(), [&playlist](Playlist::Handle handle)
+            {
+               return playlist.positionOf(handle) == Playlist::npos;
+            }), handles_.end());
+      }
+
+      std::vector<Playlist::Handle> added;
+      for (Playlist::Handle handle = known_handles_; handle < playlist.handleCount(); handle++)
+      {
+         size_t position = playlist.positionOf(handle);
+         if (position != Playlist::npos && filter_.matches(playlist[position].track))
+            added.push_back(handle);
+      }
+
+      if (!added.empty())
+      {
+         auto compare = [this, &playlist](Playlist::Handle left, Playlist::Handle right)
+            {
+               return precedes(order_, playlist[playlist.positionOf(left)], playlist[playlist.positionOf(right)]);
+            };
+
+         std::sort(added.begin(), added.end(), compare);
+
+         // each added entry is placed with a binary search, and the entries of the view between them are copied as blocks
+         std::vector<Playlist::Handle> merged;
+         merged.reserve(handles_.size() + added.size());
+
+         auto next = handles_.begin();
+         for (Playlist::Handle handle : added)
+         {
+            auto insertion = std::upper_bound(next, handles_.end(), handle, compare);
+            merged.insert(merged.end(), next, insertion);
+            merged.push_back(handle);
+            next = insertion;
+         }
+
+         merged.insert(merged.end(), next, handles_.end());
+         handles_.swap(merged);
+      }
+
+      known_handles_ = playlist.handleCount();
+      known_size_ = playlist.size();
+   }
+
+   void PlaylistView::clear()
+   {
+      defined_ = false;
+      order_ = Order::Playlist;
+      filter_ = Filter();
+      handles_.clear();
+      handles_.shrink_to_fit();
+   }
+
+   const char* PlaylistView::getOrderName(Order order)
+   {
+      switch (order)
+      {
+      case Order::Title:
+         return "title";
+      case Order::Duration:
+         return "duration";
+      case Order::Codec:
+         return "codec";
+      default:
+         return "playlist order";
+      }
+   }
+
+   /**
+    * Builds the view from all entries of the playlist.
+    */
+   void PlaylistView::build_(const Playlist& playlist, ThreadPool& pool)
+   {
+      // the entries are sorted through their positions: the tracks are compared in place, and never copied
+      std::vector<SortItem> items;
+      items.reserve(playlist.size());
+
+      for (size_t position = 0; position < playlist.size(); position++)
+      {
+         const Playlist::Entry& entry = playlist[position];
+         if (filter_.matches(entry.track))
+            items.push_back({ sortKey(order_, entry), entry.handle, static_cast<std::uint32_t>(position) });
+      }
+
+      if (order_ != Order::Playlist)
+         parallelSort(playlist, items, order_, pool);
+
+      handles_.resize(items.size());
+      for (size_t idx = 0; idx < items.size(); idx++)
+         handles_[idx] = items[idx].handle;
+
+      known_handles_ = playlist.handleCount();
+      known_size_ = playlist.size();
+   }
+
+}
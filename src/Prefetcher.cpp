@@ -0,0 +1,190 @@
+#include "Prefetcher.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+   /**
+    * \brief Serves the frames decoded ahead, then continues with the wrapped decoder.
+    */
+   class PrefetchedDecoder : public MusicPlayer::Decoder
+   {
+   public:
+      PrefetchedDecoder(std::unique_ptr<MusicPlayer::Decoder> decoder, size_t prefetch_frames) :
+         decoder_(std::move(decoder)),
+         head_frames_(0),
+         head_position_(0)
+      {
+         format_ = decoder_->getFormat();
+         total_frames_ = decoder_->getTotalFrames();
+
+         head_.resize(prefetch_frames * format_.channels);
+         head_frames_ = decoder_->read(head_.data(), prefetch_frames);
+      }
+
+      bool open(const std::string& file_name) override
+      {
+         head_frames_ = 0;
+         head_position_ = 0;
+
+         if (!decoder_->open(file_name))
+            return fail_(decoder_->getErrorMessage());
+
+         format_ = decoder_->getFormat();
+         total_frames_ = decoder_->getTotalFrames();
+         return true;
+      }
+
+      size_t read(float* samples, size_t frames) override
+      {
+         size_t decoded(0);
+
+         if (head_position_ < head_frames_)
+         {
+            decoded = std::min(frames, head_frames_ - head_position_);
+            std::copy_n(head_.begin() + head_position_ * format_.channels, decoded * format_.channels, samples);
+            head_position_ += decoded;
+         }
+
+         if (decoded < frames)
+         {
+            decoded += decoder_->read(samples + decoded * format_.channels, frames - decoded);
+
+            if (decoder_->hasFailed() && !hasFailed())
+               fail_(decoder_->getErrorMessage());
+         }
+
+         return decoded;
+      }
+
+   private:
+      std::unique_ptr<MusicPlayer::Decoder> decoder_;
+
+      std::vector<float> head_;
+      size_t head_frames_;
+      size_t head_position_;
+   };
+}
+
+namespace MusicPlayer
+{
+
+   Prefetcher::Prefetcher(size_t prefetch_frames) :
+      prefetch_frames_(prefetch_frames),
+      pending_handle_(Playlist::kInvalidHandle),
+      pending_gain_(1.0f),
+      warm_count_(0),
+      cold_count_(0)
+   {
+   }
+
+   void Prefetcher::prefetch(Playlist::Handle handle, Codec::Type codec, std::string audio_file, float gain)
+   {
+      size_t prefetch_frames = prefetch_frames_;
+      ThreadPool::CancellationToken token;
+
+      // the job does not refer to the prefetcher, it may complete after the result was discarded
+      std::future<std::unique_ptr<Decoder>> job = ThreadPool::shared().submit(ThreadPool::Priority::Prefetch, token,
+         [codec, file_name = std::move(audio_file), prefetch_frames, token]() -> std::unique_ptr<Decoder>
+         {
+            std::unique_ptr<Decoder> decoder = DecoderRegistry::create(codec);
+            if (!decoder || !decoder->open(file_name))
+               return nullptr;
+
+            // the track may have been replaced while its file was opened
+            if (token.isCancelled())
+               return nullptr;
+
+            return std::make_unique<PrefetchedDecoder>(std::move(decoder), prefetch_frames);
+         });
+
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      pending_token_.cancel();
+      pending_token_ = token;
+
+      pending_handle_ = handle;
+      pending_gain_ = gain;
+      pending_ = std::move(job);
+      ready_.reset();
+   }
+
+   void Prefetcher::cancel()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      pending_token_.cancel();
+
+      pending_handle_ = Playlist::kInvalidHandle;
+      pending_ = std::future<std::unique_ptr<Decoder>>();
+      ready_.reset();
+   }
+
+   Playlist::Handle Prefetcher::getPendingHandle() const
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return pending_handle_;
+   }
+
+   PlaybackEngine::Stream Prefetcher::take(Playlist::Handle handle)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (handle != pending_handle_ || handle == Playlist::kInvalidHandle)
+      {
+         countTransition_(false);
+         return {};
+      }
+
+      countTransition_(resolve_());
+      pending_handle_ = Playlist::kInvalidHandle;
+
+      return { std::move(ready_), pending_gain_ };
+   }
+
+   PlaybackEngine::Stream Prefetcher::takeCompatible(const AudioFormat& format, Playlist::Handle& handle)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (pending_handle_ == Playlist::kInvalidHandle)
+         return {};
+
+      bool warm = resolve_();
+
+      if (!ready_ || ready_->getFormat().channels != format.channels
+         || (format.sample_rate != 0 && ready_->getFormat().sample_rate != format.sample_rate))
+         return {};
+
+      countTransition_(warm);
+      handle = pending_handle_;
+      pending_handle_ = Playlist::kInvalidHandle;
+
+      return { std::move(ready_), pending_gain_ };
+   }
+
+   /**
+    * Moves the result of the prefetch job to ready_, waiting for its completion if needed.
+    *
+    * \return true if the job had already completed.
+    */
+   bool Prefetcher::resolve_()
+   {
+      if (!pending_.valid())
+         return true;
+
+      bool completed = pending_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+
+      // the producer waits here from a worker of the pool, which executes the queued prefetch jobs meanwhile
+      ThreadPool::shared().wait(pending_, ThreadPool::Priority::Prefetch);
+      ready_ = pending_.get();
+
+      return completed;
+   }
+
+   void Prefetcher::countTransition_(bool warm)
+   {
+      (warm ? warm_count_ : cold_count_).fetch_add(1, std::memory_order_relaxed);
+   }
+
+}
@@ -0,0 +1,262 @@
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+   // ratios with more phases, like 44056 Hz to 48000 Hz, use the nearest of this number of phases
+   constexpr std::uint64_t kMaxPhases = 1024;
+
+   constexpr double kPi = 3.14159265358979323846;
+
+   struct Preset
+   {
+      std::string_view name;
+      unsigned taps;
+      // fraction of the lowest Nyquist frequency kept
+      double cutoff;
+      // shape of the Kaiser window: higher values attenuate more, with a wider transition band
+      double kaiser_beta;
+   };
+
+   constexpr Preset kPresets[] = {
+      { "fast", 2, 1.0, 0.0 },
+      { "medium", 16, 0.90, 6.0 },
+      { "high", 64, 0.95, 9.0 },
+   };
+
+   const Preset& presetFor(MusicPlayer::Resampler::Quality quality)
+   {
+      return kPresets[static_cast<size_t>(quality)];
+   }
+
+   // modified Bessel function of the first kind, of order 0
+   double besselI0(double x)
+   {
+      double sum(1.0), term(1.0);
+
+      for (int k = 1; k < 50; k++)
+      {
+         term *= (x / (2.0 * k)) * (x / (2.0 * k));
+         sum += term;
+
+         if (term < sum * 1e-12)
+            break;
+      }
+
+      return sum;
+   }
+
+   double sinc(double x)
+   {
+      return x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+   }
+}
+
+namespace MusicPlayer
+{
+
+   std::string_view Resampler::getQualityName(Quality quality)
+   {
+      return presetFor(quality).name;
+   }
+
+   std::optional<Resampler::Quality> Resampler::findQuality(std::string_view name)
+   {
+      for (size_t index = 0; index < std::size(kPresets); index++)
+      {
+         if (kPresets[index].name == name)
+            return static_cast<Quality>(index);
+      }
+
+      return std::nullopt;
+   }
+
+   Resampler::Resampler() :
+      input_rate_(0), output_rate_(0), channels_(0), quality_(Quality::Medium),
+      upsampling_(1), downsampling_(1),
+      history_frames_(0), center_(0), phase_(0),
+      input_count_(0), output_count_(0)
+   {
+   }
+
+   void Resampler::configure(unsigned input_rate, unsigned output_rate, unsigned channels, Quality quality)
+   {
+      input_rate_ = input_rate;
+      output_rate_ = output_rate;
+      channels_ = channels;
+      quality_ = quality;
+
+      std::uint64_t divisor = std::gcd(input_rate, output_rate);
+      upsampling_ = output_rate / divisor;
+      downsampling_ = input_rate / divisor;
+
+      // a ratio of 1 only needs the first frame of the linear filter
+      filters_ = filterBankFor_(upsampling_, downsampling_, upsampling_ == downsampling_ ? Quality::Fast : quality);
+
+      // the filter is centered on the first input frame
+      size_t half = filters_->taps / 2;
+      history_frames_ = half - 1;
+      history_.assign(history_frames_ * channels_, 0.0f);
+      center_ = half - 1;
+      phase_ = 0;
+
+      input_count_ = 0;
+      output_count_ = 0;
+   }
+
+   size_t Resampler::getMaxOutputFrames(size_t input_frames) const
+   {
+      return static_cast<size_t>((input_frames + filters_->taps) * upsampling_ / downsampling_ + 2);
+   }
+
+   size_t Resampler::process(const float* input, size_t input_frames, float* output)
+   {
+      size_t needed = (history_frames_ + input_frames) * channels_;
+      if (history_.size() < needed)
+         history_.resize(needed);
+
+      std::copy_n(input, input_frames * channels_, history_.begin() + history_frames_ * channels_);
+      history_frames_ += input_frames;
+      input_count_ += input_frames;
+
+      return produce_(output, std::numeric_limits<size_t>::max());
+   }
+
+   size_t Resampler::flush(float* output)
+   {
+      // the last frames are filtered with silence after them
+      size_t half = filters_->taps / 2;
+      size_t needed = (history_frames_ + half) * channels_;
+      if (history_.size() < needed)
+         history_.resize(needed);
+
+      std::fill_n(history_.begin() + history_frames_ * channels_, half * channels_, 0.0f);
+      history_frames_ += half;
+
+      // the output lasts as long as the input
+      std::uint64_t total_frames = (input_count_ * upsampling_ + downsampling_ - 1) / downsampling_;
+      size_t produced = produce_(output, static_cast<size_t>(total_frames - std::min(total_frames, output_count_)));
+
+      configure(input_rate_, output_rate_, channels_, quality_);
+
+      return produced;
+   }
+
+   /**
+    * Computes the output frames whose filter window is entirely in the history, then drops the frames that
+    * are not needed anymore.
+    */
+   size_t Resampler::produce_(float* output, size_t max_frames)
+   {
+      const FilterBank& filters = *filters_;
+      const unsigned taps = filters.taps;
+      const size_t half = taps / 2;
+
+      size_t produced(0);
+
+      while (produced < max_frames && center_ + half < history_frames_)
+      {
+         std::uint64_t phase = filters.phases == upsampling_ ? phase_ : phase_ * filters.phases / upsampling_;
+
+         const float* coefficients = filters.coefficients.data() + phase * taps;
+         const float* frames = history_.data() + (center_ + 1 - half) * channels_;
+         float* frame = output + produced * channels_;
+
+         std::fill_n(frame, channels_, 0.0f);
+
+         for (unsigned tap = 0; tap < taps; tap++)
+         {
+            for (unsigned channel = 0; channel < channels_; channel++)
+               frame[channel] += coefficients[tap] * frames[tap * channels_ + channel];
+         }
+
+         produced++;
+
+         phase_ += downsampling_;
+         center_ += static_cast<size_t>(phase_ / upsampling_);
+         phase_ %= upsampling_;
+      }
+
+      output_count_ += produced;
+
+      // keep the frames before the center that the next outputs still need
+      size_t first_needed = std::min(center_ + 1 - half, history_frames_);
+      if (first_needed > 0)
+      {
+         std::memmove(history_.data(), history_.data() + first_needed * channels_, (history_frames_ - first_needed) * channels_ * sizeof(float));
+         history_frames_ -= first_needed;
+         center_ -= first_needed;
+      }
+
+      return produced;
+   }
+
+   std::shared_ptr<const Resampler::FilterBank> Resampler::filterBankFor_(std::uint64_t upsampling, std::uint64_t downsampling, Quality quality)
+   {
+      static std::mutex mutex;
+      static std::map<FilterKey, std::shared_ptr<const FilterBank>> cache;
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      std::shared_ptr<const FilterBank>& filters = cache[FilterKey(upsampling, downsampling, quality)];
+      if (!filters)
+         filters = computeFilterBank_(upsampling, downsampling, quality);
+
+      return filters;
+   }
+
+   std::shared_ptr<const Resampler::FilterBank> Resampler::computeFilterBank_(std::uint64_t upsampling, std::uint64_t downsampling, Quality quality)
+   {
+      const Preset& preset = presetFor(quality);
+
+      auto filters = std::make_shared<FilterBank>();
+      filters->phases = static_cast<unsigned>(std::min(upsampling, kMaxPhases));
+      filters->taps = preset.taps;
+      filters->coefficients.resize(size_t(filters->phases) * filters->taps);
+
+      const int half = static_cast<int>(preset.taps / 2);
+
+      // when downsampling, the cutoff follows the output Nyquist frequency to avoid aliasing
+      const double cutoff = preset.cutoff * std::min(1.0, static_cast<double>(upsampling) / downsampling);
+
+      for (unsigned phase = 0; phase < filters->phases; phase++)
+      {
+         float* coefficients = filters->coefficients.data() + size_t(phase) * filters->taps;
+         const double fraction = static_cast<double>(phase) / filters->phases;
+
+         if (quality == Quality::Fast)
+         {
+            coefficients[0] = static_cast<float>(1.0 - fraction);
+            coefficients[1] = static_cast<float>(fraction);
+            continue;
+         }
+
+         double sum(0.0);
+         std::vector<double> values(filters->taps);
+
+         for (int tap = 0; tap < static_cast<int>(filters->taps); tap++)
+         {
+            // distance between the input frame and the output position
+            double distance = (tap - (half - 1)) - fraction;
+            double window_position = distance / half;
+            double window = besselI0(preset.kaiser_beta * std::sqrt(std::max(0.0, 1.0 - window_position * window_position))) / besselI0(preset.kaiser_beta);
+
+            values[tap] = cutoff * sinc(cutoff * distance) * window;
+            sum += values[tap];
+         }
+
+         // each phase keeps constant signals unchanged
+         for (unsigned tap = 0; tap < filters->taps; tap++)
+            coefficients[tap] = static_cast<float>(values[tap] / sum);
+      }
+
+      return filters;
+   }
+
+}
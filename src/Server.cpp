@@ -0,0 +1,461 @@
+#include "Server.h"
+
+#include "Shell.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <sstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+   constexpr size_t kReceiveSize = 4096;
+
+#ifdef MSG_NOSIGNAL
+   constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+   constexpr int kSendFlags = 0;
+#endif
+
+   bool setNonBlocking(int fd)
+   {
+      int flags = fcntl(fd, F_GETFL, 0);
+      return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+   }
+
+   std::string systemError(const std::string& action)
+   {
+      return action + " (" + std::strerror(errno) + ")";
+   }
+}
+
+namespace MusicPlayer
+{
+
+   struct Server::Session
+   {
+      explicit Session(int socket_fd) :
+         fd(socket_fd),
+         executing(false),
+         exit_requested(false),
+         sent(0),
+         input_closed(false),
+         closed(false)
+      {
+         shell.setOutputStream(output);
+         shell.setInteractive(false);
+         shell.setDirectoryChangeAllowed(false);
+         shell.setWaitAllowed(false);
+      }
+
+      const int fd;
+
+      // used by the executor running the session's instructions only
+      std::ostringstream output;
+      Shell shell;
+
+      std::mutex mutex;
+      std::deque<std::string> instructions;
+      std::string answers;
+      bool executing;
+      bool exit_requested;
+
+      // used by the poll() loop only
+      std::string received;
+      std::string sending;
+      size_t sent;
+      bool input_closed;
+      bool closed;
+   };
+
+   Server::Server(std::string socket_path, size_t executor_count) :
+      socket_path_(std::move(socket_path)),
+      listen_fd_(-1),
+      wake_read_fd_(-1),
+      wake_write_fd_(-1),
+      stop_requested_(false),
+      session_count_(0),
+      instruction_count_(0),
+      executors_(std::make_unique<ThreadPool>(executor_count))
+   {
+   }
+
+   Server::~Server()
+   {
+      for (auto& [fd, session] : sessions_)
+      {
+         std::lock_guard<std::mutex> lock(session->mutex);
+         session->instructions.clear();
+      }
+
+      // waits for the instructions being executed
+      executors_.reset();
+
+      for (auto& [fd, session] : sessions_)
+         ::close(fd);
+      sessions_.clear();
+      answered_.clear();
+
+      for (int fd : { listen_fd_, wake_read_fd_, wake_write_fd_ })
+      {
+         if (fd >= 0)
+            ::close(fd);
+      }
+
+      if (listen_fd_ >= 0)
+         unlink(socket_path_.c_str());
+   }
+
+   bool Server::listen(std::string& error)
+   {
+      sockaddr_un address{};
+      address.sun_family = AF_UNIX;
+
+      if (socket_path_.empty() || socket_path_.size() >= sizeof(address.sun_path))
+      {
+         error = "The socket path must be between 1 and " + std::to_string(sizeof(address.sun_path) - 1) + " characters long.";
+         return false;
+      }
+
+      std::memcpy(address.sun_path, socket_path_.c_str(), socket_path_.size() + 1);
+
+      // a socket left by a server that did not exit cleanly is replaced, any other file is kept
+      struct stat existing;
+      if (lstat(socket_path_.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+         unlink(socket_path_.c_str());
+
+      int wake_fds[2];
+      if (pipe(wake_fds) != 0)
+      {
+         error = systemError("The wake-up pipe could not be created.");
+         return false;
+      }
+
+      wake_read_fd_ = wake_fds[0];
+      wake_write_fd_ = wake_fds[1];
+      setNonBlocking(wake_read_fd_);
+      setNonBlocking(wake_write_fd_);
+
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd < 0)
+      {
+         error = systemError("The socket could not be created.");
+         return false;
+      }
+
+      if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+      {
+         error = systemError("The socket could not be bound to \"" + socket_path_ + "\".");
+         ::close(fd);
+         return false;
+      }
+
+      if (::listen(fd, SOMAXCONN) != 0 || !setNonBlocking(fd))
+      {
+         error = systemError("The socket could not listen for connections.");
+         ::close(fd);
+         unlink(socket_path_.c_str());
+         return false;
+      }
+
+      listen_fd_ = fd;
+      return true;
+   }
+
+   void Server::run()
+   {
+      if (listen_fd_ < 0)
+         return;
+
+      // a client closing its connection must not kill the server
+      std::signal(SIGPIPE, SIG_IGN);
+
+      std::vector<pollfd> polled;
+      std::vector<std::shared_ptr<Session>> answered;
+
+      while (!stop_requested_.load(std::memory_order_relaxed))
+      {
+         polled.clear();
+         polled.push_back({ wake_read_fd_, POLLIN, 0 });
+         polled.push_back({ listen_fd_, POLLIN, 0 });
+
+         for (const auto& [fd, session] : sessions_)
+         {
+            short events = session->input_closed ? 0 : POLLIN;
+            if (session->sent < session->sending.size())
+               events |= POLLOUT;
+
+            // a closed input would report a hang-up at every poll() while the last instructions execute
+            if (events != 0)
+               polled.push_back({ fd, events, 0 });
+         }
+
+         if (poll(polled.data(), polled.size(), -1) < 0)
+         {
+            if (errno == EINTR)
+               continue;
+            break;
+         }
+
+         if (polled[0].revents & POLLIN)
+         {
+            char drained[64];
+            while (read(wake_read_fd_, drained, sizeof(drained)) > 0)
+               continue;
+         }
+
+         for (size_t idx = 2; idx < polled.size(); idx++)
+         {
+            if (polled[idx].revents == 0)
+               continue;
+
+            auto found = sessions_.find(polled[idx].fd);
+            if (found == sessions_.end())
+               continue;
+
+            std::shared_ptr<Session> session = found->second;
+
+            if ((polled[idx].revents & (POLLIN | POLLHUP | POLLERR)) && !session->input_closed && !receive_(session))
+            {
+               close_(session->fd);
+               continue;
+            }
+
+            if ((polled[idx].revents & POLLOUT) && !send_(*session))
+               close_(session->fd);
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(answered_mutex_);
+            answered.swap(answered_);
+         }
+
+         for (const std::shared_ptr<Session>& session : answered)
+         {
+            if (!session->closed && !send_(*session))
+               close_(session->fd);
+         }
+
+         answered.clear();
+
+         // the new sessions are polled from the next round
+         if (polled[1].revents & POLLIN)
+            accept_();
+      }
+   }
+
+   void Server::stop()
+   {
+      stop_requested_.store(true, std::memory_order_relaxed);
+
+      // write() is async-signal-safe
+      char wake = 0;
+      if (wake_write_fd_ >= 0)
+         (void)!write(wake_write_fd_, &wake, 1);
+   }
+
+   void Server::accept_()
+   {
+      while (true)
+      {
+         int fd = accept(listen_fd_, nullptr, nullptr);
+         if (fd < 0)
+            return;
+
+         if (!setNonBlocking(fd))
+         {
+            ::close(fd);
+            continue;
+         }
+
+         sessions_.emplace(fd, std::make_shared<Session>(fd));
+         session_count_.fetch_add(1, std::memory_order_relaxed);
+      }
+   }
+
+   /**
+    * Reads the available bytes of a session, and queues the complete instruction lines for execution.
+    *
+    * \return false if the session must be closed.
+    */
+   bool Server::receive_(const std::shared_ptr<Session>& session)
+   {
+      char buffer[kReceiveSize];
+
+      while (true)
+      {
+         ssize_t received = recv(session->fd, buffer, sizeof(buffer), 0);
+
+         if (received < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+         if (received == 0)
+         {
+            // the instructions already received are still answered
+            session->input_closed = true;
+            std::lock_guard<std::mutex> lock(session->mutex);
+            return session->executing || !session->answers.empty() || session->sent < session->sending.size();
+         }
+
+         session->received.append(buffer, static_cast<size_t>(received));
+
+         size_t line_start(0);
+         size_t line_end;
+         bool submit(false);
+
+         {
+            std::lock_guard<std::mutex> lock(session->mutex);
+
+            while ((line_end = session->received.find('\n', line_start)) != std::string::npos)
+            {
+               size_t length = line_end - line_start;
+               if (length > 0 && session->received[line_end - 1] == '\r')
+                  length--;
+
+               if (!session->exit_requested)
+                  session->instructions.emplace_back(session->received, line_start, length);
+
+               line_start = line_end + 1;
+            }
+
+            if (!session->executing && !session->instructions.empty())
+            {
+               session->executing = true;
+               submit = true;
+            }
+         }
+
+         session->received.erase(0, line_start);
+
+         if (submit)
+            executors_->submit([this, session]() { execute_(session); });
+
+         if (session->received.size() > kMaxLineLength)
+            return false;
+      }
+   }
+
+   /**
+    * Sends the answers of a session, as much as the socket accepts.
+    *
+    * \return false if the session must be closed.
+    */
+   bool Server::send_(Session& session)
+   {
+      while (true)
+      {
+         if (session.sent == session.sending.size())
+         {
+            session.sending.clear();
+            session.sent = 0;
+
+            std::lock_guard<std::mutex> lock(session.mutex);
+
+            if (session.answers.empty())
+               return !((session.exit_requested || session.input_closed) && !session.executing);
+
+            session.sending.swap(session.answers);
+         }
+
+         ssize_t sent = ::send(session.fd, session.sending.data() + session.sent, session.sending.size() - session.sent, kSendFlags);
+
+         if (sent < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+         session.sent += static_cast<size_t>(sent);
+      }
+   }
+
+   void Server::close_(int fd)
+   {
+      auto found = sessions_.find(fd);
+      if (found == sessions_.end())
+         return;
+
+      std::shared_ptr<Session> session = found->second;
+      sessions_.erase(found);
+
+      {
+         std::lock_guard<std::mutex> lock(session->mutex);
+         session->instructions.clear();
+      }
+
+      session->closed = true;
+      ::close(fd);
+      session_count_.fetch_sub(1, std::memory_order_relaxed);
+   }
+
+   /**
+    * Executes the queued instructions of a session, one after the other, on an executor thread.
+    */
+   void Server::execute_(const std::shared_ptr<Session>& session)
+   {
+      bool done(false);
+
+      while (!done)
+      {
+         std::string instruction;
+
+         {
+            std::lock_guard<std::mutex> lock(session->mutex);
+
+            if (session->instructions.empty())
+            {
+               session->executing = false;
+               break;
+            }
+
+            instruction = std::move(session->instructions.front());
+            session->instructions.pop_front();
+         }
+
+         bool succeeded = session->shell.execute(instruction);
+         std::string printed = session->output.str();
+         session->output.str(std::string());
+
+         instruction_count_.fetch_add(1, std::memory_order_relaxed);
+
+         {
+            std::lock_guard<std::mutex> lock(session->mutex);
+
+            session->answers.append(succeeded ? "ok " : "error ");
+            session->answers.append(std::to_string(printed.size()));
+            session->answers.push_back('\n');
+            session->answers.append(printed);
+
+            if (session->shell.isExitRequested())
+            {
+               session->exit_requested = true;
+               session->instructions.clear();
+            }
+
+            // decided with the answer, so that the poll() loop sees a consistent state when it is woken up
+            done = session->instructions.empty();
+            if (done)
+               session->executing = false;
+         }
+
+         notify_(session);
+      }
+   }
+
+   void Server::notify_(const std::shared_ptr<Session>& session)
+   {
+      {
+         std::lock_guard<std::mutex> lock(answered_mutex_);
+         answered_.push_back(session);
+      }
+
+      char wake = 0;
+      (void)!write(wake_write_fd_, &wake, 1);
+   }
+
+}
@@ -1,50 +1,155 @@
 ﻿#include "Shell.h"
 
+#include "BinaryPlaylist.h"
+#include "Decoder.h"
+#include "Dsp.h"
 #include "Help.h"
+#include "LibraryScanner.h"
+#include "MetadataCache.h"
+#include "PlaylistLoader.h"
+#include "PlaylistView.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 #include "Version.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <iomanip>
+#include <random>
 #include <sstream>
+#include <thread>
 #include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
-using std::endl;
 using std::string;
 using std::unordered_map;
 using std::vector;
 
+namespace
+{
+   /**
+    * \brief Ends a line without flushing the stream.
+    *
+    * The shell output is flushed before waiting for input, after a failed instruction and when the shell
+    * exits, so that scripted runs do not pay for a flush on every line.
+    */
+   std::ostream& endl(std::ostream& out)
+   {
+      return out.put('\n');
+   }
+}
+
 namespace MusicPlayer
 {
 
 #pragma region Constructors
 
+   // sorted by name, so that instructions are looked up with a binary search
+   constexpr Shell::InstructionEntry Shell::kInstructions[] = {
+      { "add_dir", &Shell::addDirectory_ },
+      { "add_track", &Shell::addTrack_ },
+      { "cache", &Shell::metadataCache_ },
+      { "crossfade", &Shell::crossfade_ },
+      { "current_directory", &Shell::cd_ },
+      { "dequeue", &Shell::dequeue_ },
+      { "exit", &Shell::exit_ },
+      { "help", &Shell::help_ },
+      { "keep", &Shell::keepTracks_ },
+      { "load", &Shell::loadPlaylist_ },
+      { "move", &Shell::moveTracks_ },
+      { "next", &Shell::next_ },
+      { "output", &Shell::setOutput_ },
+      { "pause", &Shell::pause_ },
+      { "play", &Shell::play_ },
+      { "playback_stats", &Shell::showPlaybackStatistics_ },
+      { "prev", &Shell::previous_ },
+      { "queue", &Shell::queue_ },
+      { "queue_next", &Shell::queueNext_ },
+      { "random", &Shell::random_ },
+      { "remove_dupes", &Shell::removeDuplicates_ },
+      { "remove_track", &Shell::removeTrack_ },
+      { "repeat", &Shell::repeat_ },
+      { "replaygain", &Shell::replayGain_ },
+      { "resample", &Shell::resample_ },
+      { "save", &Shell::savePlaylist_ },
+      { "show_list", &Shell::showPlaylist_ },
+      { "show_track", &Shell::showTrack_ },
+      { "view", &Shell::view_ },
+      { "volume", &Shell::volume_ },
+      { "wait", &Shell::wait_ },
+   };
+
+   namespace
+   {
+      template <typename Entry, size_t N>
+      constexpr bool isSortedByName(const Entry(&entries)[N])
+      {
+         for (size_t idx = 1; idx < N; idx++)
+         {
+            if (!(entries[idx - 1].name < entries[idx].name))
+               return false;
+         }
+
+         return true;
+      }
+
+      /**
+       * \brief Parses a duration given in seconds, or as minutes and seconds such as "5:30".
+       */
+      bool parseDuration(std::string_view text, time_t& seconds)
+      {
+         long long minutes(0), parsed_seconds;
+         size_t separator = text.find(':');
+
+         if (separator != std::string_view::npos)
+         {
+            if (!parseInteger(text.substr(0, separator), minutes) || minutes < 0)
+               return false;
+
+            text = text.substr(separator + 1);
+         }
+
+         if (!parseInteger(text, parsed_seconds) || parsed_seconds < 0 || (separator != std::string_view::npos && parsed_seconds >= 60))
+            return false;
+
+         seconds = static_cast<time_t>(minutes * 60 + parsed_seconds);
+         return true;
+      }
+
+      std::ostream& writeDuration(std::ostream& out, time_t seconds)
+      {
+         return out << seconds / 60 << ":" << std::setfill('0') << std::setw(2) << seconds % 60 << std::setfill(' ');
+      }
+   }
+
    Shell::Shell() :
       input_(nullptr), output_(nullptr), is_playing_(false),
-      random_mode_(false), repeat_mode_(false)
-   {
-      // construct instruction array
-      available_instructions_ = {
-         { "help", &Shell::help_ },
-         { "add_track", &Shell::addTrack_ },
-         { "remove_track", &Shell::removeTrack_ },
-         { "show_track", &Shell::showTrack_ },
-         { "show_list", &Shell::showPlaylist_ },
-         { "play", &Shell::play_ },
-         { "pause", &Shell::pause_ },
-         { "prev", &Shell::previous_ },
-         { "next", &Shell::next_ },
-         { "random", &Shell::random_ },
-         { "repeat", &Shell::repeat_ },
-         { "remove_dupes", &Shell::removeDuplicates_ },
-         { "current_directory", &Shell::cd_ },
-         { "load", &Shell::loadPlaylist_ },
-         { "save", &Shell::savePlaylist_ },
-      };
+      playing_handle_(Playlist::kInvalidHandle), decoding_(false), gapless_handle_(Playlist::kInvalidHandle),
+      seen_transitions_(0), replay_gain_(false), replay_gain_preamp_db_(0.0f),
+      random_mode_(false), repeat_mode_(false), queued_handle_(Playlist::kInvalidHandle), queue_return_(Playlist::kInvalidHandle),
+      interactive_(true), stop_on_error_(false), directory_change_allowed_(true), wait_allowed_(true), exit_requested_(false), instruction_failed_(false)
+   {
+      static_assert(isSortedByName(kInstructions), "The instruction table must be sorted by name.");
 
       std::random_device rd;
-      rng_.seed(rd());
+      shuffle_.seed(rd());
+
+      playlist_.setJournal(&journal_);
+
+      playback_.setNextStreamProvider([this](const AudioFormat& format)
+         {
+            Playlist::Handle handle(Playlist::kInvalidHandle);
+            PlaybackEngine::Stream next_track = prefetcher_.takeCompatible(format, handle);
+
+            if (next_track.decoder)
+               gapless_handle_.store(handle);
 
-      currently_playing_ = playlist_.end();
+            return next_track;
+         });
    }
 
    Shell::Shell(std::istream& in, std::ostream& out) :
@@ -68,9 +173,9 @@ namespace MusicPlayer
       if (args.empty())
       {
          *output_ << "Available instructions: " << endl;
-         for (const auto& instruction : available_instructions_)
+         for (const InstructionEntry& instruction : kInstructions)
          {
-            *output_ << instruction.first << endl;
+            *output_ << instruction.name << endl;
          }
 
          *output_ << "Type \"help <instruction>\" to get more info about a specific command." << endl;
@@ -97,34 +202,51 @@ namespace MusicPlayer
     */
    void Shell::unknownInstruction_(const Shell::ArgumentArray& args)
    {
-      *output_ << "Unknown instruction: " << args[0] << endl;
+      error_() << "Unknown instruction: " << args[0] << endl;
    }
 
    void Shell::addTrack_(const Shell::ArgumentArray& args)
    {
-      for (const string& file_name : args)
+      MetadataCache& cache = MetadataCache::shared();
+      bool cache_open = cache.isOpen();
+      bool stored(false);
+
+      for (std::string_view file_name : args)
       {
-         std::ifstream file(file_name, std::ifstream::in);
+         string file_path(file_name);
+         MetadataCache::FileStamp stamp;
+         bool stamped = cache_open && MetadataCache::getFileStamp(file_path, stamp);
+
+         Track new_track;
 
-         if (!file.is_open())
+         if (!stamped || !cache.lookup(file_name, stamp, new_track))
          {
-            *output_ << "File \"" << file_name << "\" could not be opened." << endl;
-            continue;
-         }
+            std::ifstream file(file_path, std::ifstream::in);
 
-         std::ostringstream strm;
-         strm << file.rdbuf();
-         file.close();
+            if (!file.is_open())
+            {
+               error_() << "File \"" << file_name << "\" could not be opened." << endl;
+               continue;
+            }
 
-         Track new_track;
+            std::ostringstream strm;
+            strm << file.rdbuf();
+            file.close();
 
-         if (!new_track.deserialize(strm.str()))
-         {
-            *output_ << "File \"" << file_name << "\" was not imported. (Reason: " << new_track.getErrorMessage() << ")" << endl;
-            continue;
+            if (!new_track.deserialize(strm.str()))
+            {
+               error_() << "File \"" << file_name << "\" was not imported. (Reason: " << new_track.getErrorMessage() << ")" << endl;
+               continue;
+            }
+
+            if (stamped)
+            {
+               cache.store(file_name, stamp, new_track);
+               stored = true;
+            }
          }
 
-         playlist_.push_back({ file_name, new_track });
+         playlist_.append(file_name, std::move(new_track));
 
          *output_ << "File \"" << file_name << "\" was successfully added in position " << playlist_.size() << "." << endl;
 
@@ -132,85 +254,222 @@ namespace MusicPlayer
 
          if (playlist_.size() == 1)
          {
-            currently_playing_ = playlist_.begin();
+            playlist_.setCurrentPosition(0);
          }
       }
+
+      string error;
+      if (stored && !cache.flush(error))
+         error_() << error << endl;
    }
 
-   void Shell::removeTrack_(const Shell::ArgumentArray& args)
+   void Shell::addDirectory_(const ArgumentArray& args)
    {
-      if (args.empty())
+      size_t argument_count = args.size();
+      bool recursive = argument_count > 0 && args.back() == "--recursive";
+      if (recursive)
+         argument_count--;
+
+      if (argument_count != 1)
       {
-         *output_ << "Please specify at least one track name or position in the playlist to remove." << endl;
+         error_() << "Please specify one directory, optionally followed by --recursive." << endl;
          return;
       }
 
-      std::set<int> indices_to_remove = parseIndicesFromArgs_(args);
+      LibraryScanner::Report report;
+      string error;
 
-      int idx(0);
-      Playlist::iterator it(playlist_.begin());
-      while (it != playlist_.end())
+      if (!LibraryScanner::scan(string(args[0]), recursive, playlist_, report, error))
       {
-         if (indices_to_remove.count(idx))
-         {
-            bool playing_track_is_being_removed(currently_playing_ == it);
+         error_() << error << endl;
+         return;
+      }
 
-            it = playlist_.erase(it);
-            
-            if (playing_track_is_being_removed)
-            {
-               currently_playing_ = it;
-               if (currently_playing_ == playlist_.end())
-                  is_playing_ = false;
-            }
-         }
-         else
-         {
-            it++;
-         }
+      if (!playlist_.hasCurrent() && !playlist_.empty())
+         playlist_.setCurrentPosition(0);
 
-         idx++;
+      *output_ << "Added " << report.added_count << " track(s) from " << report.file_count << " file(s) in "
+         << report.directory_count << " director" << (report.directory_count == 1 ? "y" : "ies") << " in "
+         << std::fixed << std::setprecision(3) << report.seconds * 1000.0 << " ms";
+
+      if (report.seconds > 0.0)
+         *output_ << " (" << std::setprecision(0) << report.file_count / report.seconds << " files/s)";
+
+      *output_ << std::defaultfloat << "." << endl;
+
+      if (MetadataCache::shared().isOpen())
+         *output_ << report.cached_count << " track(s) were found in the metadata cache." << endl;
+
+      const std::pair<const char*, const LibraryScanner::ErrorCategory*> categories[] = {
+         { "director(ies) could not be listed", &report.unlisted_directories },
+         { "file(s) could not be read", &report.unreadable_files },
+         { "file(s) were not valid tracks", &report.malformed_files },
+         { "metadata cache write(s) failed", &report.cache_writes },
+      };
+
+      for (const auto& [description, category] : categories)
+      {
+         if (category->count > 0)
+            *output_ << category->count << " " << description << ", first: " << category->first_error << endl;
       }
    }
 
-   void Shell::removeDuplicates_(const ArgumentArray& args)
+   void Shell::metadataCache_(const ArgumentArray& args)
    {
-      std::set<string> filenames;
+      MetadataCache& cache = MetadataCache::shared();
+      string error;
 
-      Playlist::iterator current = playlist_.begin();
-      while (current != playlist_.end())
+      if (args.empty())
       {
-         if (filenames.count(current->first))
+         if (!cache.isOpen())
          {
-            bool currentlyPlayingTrackIsRemoved(current == currently_playing_);
-            current = playlist_.erase(current);
-            if (currentlyPlayingTrackIsRemoved)
-               currently_playing_ = current;
+            *output_ << "The metadata cache is off." << endl;
+            return;
          }
-         else
+
+         MetadataCache::Statistics statistics = cache.getStatistics();
+         std::uint64_t lookups = statistics.hits + statistics.misses;
+
+         *output_ << "Metadata cache: \"" << cache.getFileName() << "\"" << endl;
+         *output_ << "Entries: " << statistics.entry_count << " in " << statistics.record_count << " log record(s), "
+            << statistics.compactions << " compaction(s)" << endl;
+         *output_ << "Hits: " << statistics.hits << ", misses: " << statistics.misses << " (" << statistics.stale << " stale)";
+
+         if (lookups > 0)
+            *output_ << ", hit rate: " << std::fixed << std::setprecision(1) << 100.0 * statistics.hits / lookups << std::defaultfloat << "%";
+
+         *output_ << endl;
+      }
+      else if (args[0] == "on" && args.size() <= 2)
+      {
+         string file_name = args.size() == 2 ? string(args[1]) : MetadataCache::getDefaultFileName();
+
+         if (!cache.open(file_name, error))
+         {
+            error_() << error << endl;
+            return;
+         }
+
+         MetadataCache::Statistics statistics = cache.getStatistics();
+         *output_ << "Metadata cache \"" << file_name << "\" opened with " << statistics.entry_count << " entries." << endl;
+
+         if (statistics.recovered_bytes > 0)
+            *output_ << "Discarded " << statistics.recovered_bytes << " byte(s) of an interrupted write." << endl;
+      }
+      else if (args[0] == "off" && args.size() == 1)
+      {
+         cache.close();
+         *output_ << "The metadata cache is off." << endl;
+      }
+      else if (args[0] == "compact" && args.size() == 1)
+      {
+         if (!cache.compact(error))
          {
-            filenames.insert(current->first);
-            current++;
+            error_() << error << endl;
+            return;
          }
+
+         *output_ << "Metadata cache compacted to " << cache.getStatistics().entry_count << " entries." << endl;
+      }
+      else
+      {
+         error_() << "Please specify \"on [<cache file>]\", \"off\" or \"compact\", or nothing to print the cache statistics." << endl;
+      }
+   }
+
+   void Shell::removeTrack_(const Shell::ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         error_() << "Please specify at least one track name or position in the playlist to remove." << endl;
+         return;
+      }
+
+      playlist_.removeRanges(parseRangesFromArgs_(args));
+
+      if (!playlist_.hasCurrent())
+         is_playing_ = false;
+
+      selectionChanged_();
+   }
+
+   void Shell::keepTracks_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         error_() << "Please specify at least one track name, position or range of positions to keep in the playlist." << endl;
+         return;
+      }
+
+      std::vector<Playlist::Range> ranges = parseRangesFromArgs_(args);
+
+      // a mistyped argument would remove tracks meant to be kept
+      if (instruction_failed_)
+         return;
+
+      size_t removed = playlist_.keepRanges(std::move(ranges));
+      *output_ << removed << " track(s) removed, " << playlist_.size() << " kept." << endl;
+
+      if (!playlist_.hasCurrent())
+         is_playing_ = false;
+
+      selectionChanged_();
+   }
+
+   void Shell::moveTracks_(const ArgumentArray& args)
+   {
+      long long target;
+
+      if (args.size() != 3 || args[1] != "to" || !parseInteger(args[2], target) || target < 1)
+      {
+         error_() << "Please specify the track position or range of positions to move, then \"to\" and the position to move them to." << endl;
+         return;
+      }
+
+      std::vector<Playlist::Range> ranges = parseRangesFromArgs_({ args[0] });
+
+      if (ranges.size() != 1)
+      {
+         if (ranges.size() > 1)
+            error_() << "Impossible to move \"" << args[0] << "\": its tracks are not consecutive in the playlist." << endl;
+         return;
+      }
+
+      Playlist::Range range = ranges.front();
+
+      if (!playlist_.move(range, static_cast<size_t>(target - 1)))
+      {
+         error_() << "Impossible to move " << range.count << " track(s) to position " << target << ": "
+            << "there are only " << playlist_.size() << " elements in the playlist." << endl;
+         return;
       }
+
+      *output_ << "Moved " << range.count << " track(s) to position " << target << "." << endl;
+   }
+
+   void Shell::removeDuplicates_(const ArgumentArray& args)
+   {
+      playlist_.removeDuplicates();
+
+      selectionChanged_();
    }
 
    void Shell::showTrack_(const ArgumentArray& args)
    {
       if (playlist_.empty())
       {
-         *output_ << "There is no track yet to show in the playlist." << endl;
+         error_() << "There is no track yet to show in the playlist." << endl;
          return;
       }
 
       if (args.empty())
       {
          // no argument: show currently playing (if existing)
-         if (currently_playing_ != playlist_.end())
+         if (playlist_.hasCurrent())
          {
             *output_ << "Now playing: " << (is_playing_ ? "" : " (paused)") << endl;
-            *output_ << "Track " << (std::distance(playlist_.begin(), currently_playing_) + 1) << "(" << playlist_.size() << ")" << endl;
-            *output_ << Track::longFormat << currently_playing_->second;
+            *output_ << "Track " << (playlist_.currentPosition() + 1) << "(" << playlist_.size() << ")" << endl;
+            *output_ << Track::longFormat << playlist_.current().track;
          }
       }
       else
@@ -218,32 +477,30 @@ namespace MusicPlayer
          // only show one track at a time
          std::set<int> indices_to_show = parseIndicesFromArgs_(args);
 
-         Playlist::iterator current_entry(playlist_.begin());
-         std::unordered_map<string, int> tracks_shown;
+         std::unordered_map<InternedString, int> tracks_shown;
 
-         for (int idx = 0; idx < playlist_.size(); idx++, current_entry++)
+         for (int idx : indices_to_show)
          {
-            if (indices_to_show.count(idx))
-            {
-               *output_ << "#" << idx + 1 << ": [" << current_entry->first << "]";
-               
-               if (current_entry == currently_playing_)
-                  *output_ << (is_playing_ ? " (now playing)" : " (paused)");
-                
-               *output_ << endl << endl;
-
-               if (!tracks_shown.count(current_entry->first))
-               {
-                  *output_ << Track::longFormat << current_entry->second;
-                  tracks_shown.emplace(current_entry->first, idx + 1);
-               }
-               else
-               {
-                  *output_ << "(duplicate from track #" << tracks_shown[current_entry->first] << ")" << endl;
-               }
+            const Playlist::Entry& current_entry = playlist_[idx];
+
+            *output_ << "#" << idx + 1 << ": [" << current_entry.path << "]";
 
-               *output_ << endl;
+            if (static_cast<size_t>(idx) == playlist_.currentPosition())
+               *output_ << (is_playing_ ? " (now playing)" : " (paused)");
+
+            *output_ << endl << endl;
+
+            if (!tracks_shown.count(current_entry.path))
+            {
+               *output_ << Track::longFormat << current_entry.track;
+               tracks_shown.emplace(current_entry.path, idx + 1);
+            }
+            else
+            {
+               *output_ << "(duplicate from track #" << tracks_shown[current_entry.path] << ")" << endl;
             }
+
+            *output_ << endl;
          }
       }
    }
@@ -253,199 +510,618 @@ namespace MusicPlayer
       *output_ << "Random mode: " << (random_mode_ ? "on" : "off") << endl;
       *output_ << "Repeat mode: " << (repeat_mode_ ? "on" : "off") << endl << endl;
 
-      int idx = 1;
-      for (const auto& entry : playlist_)
+      for (size_t idx = 0; idx < playlist_.size(); idx++)
       {
-         *output_ << idx++ << ") ";
+         const Playlist::Entry& entry = playlist_[idx];
 
-         if (currently_playing_ != playlist_.end() && &*currently_playing_ == &entry)
+         *output_ << idx + 1 << ") ";
+
+         if (idx == playlist_.currentPosition())
          {
             *output_ << (is_playing_ ? "[|>]" : "[||]") << " ";
          }
 
-         *output_ << Track::shortFormat << entry.second << " [" << entry.first << "]" << endl;
+         *output_ << Track::shortFormat << entry.track << " [" << entry.path << "]" << endl;
+      }
+   }
+
+   void Shell::view_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         if (!playlist_view_.isDefined())
+         {
+            error_() << "There is no view of the playlist yet: see \"help view\" to define one." << endl;
+            return;
+         }
+
+         // follows the tracks added and removed since the view was shown
+         playlist_view_.refresh(playlist_);
+
+         const PlaylistView::Filter& filter = playlist_view_.getFilter();
+
+         *output_ << "View by " << PlaylistView::getOrderName(playlist_view_.getOrder());
+         if (filter.codec)
+            *output_ << ", " << Codec::getCodecName(*filter.codec) << " only";
+         if (filter.longer_than)
+            writeDuration(*output_ << ", longer than ", *filter.longer_than);
+         if (filter.shorter_than)
+            writeDuration(*output_ << ", shorter than ", *filter.shorter_than);
+         *output_ << ": " << playlist_view_.size() << " of " << playlist_.size() << " track(s)" << endl << endl;
+
+         for (size_t idx = 0; idx < playlist_view_.size(); idx++)
+         {
+            size_t position = playlist_.positionOf(playlist_view_[idx]);
+            const Playlist::Entry& entry = playlist_[position];
+
+            *output_ << idx + 1 << ") #" << position + 1 << " ";
+
+            if (position == playlist_.currentPosition())
+               *output_ << (is_playing_ ? "[|>]" : "[||]") << " ";
+
+            *output_ << Track::shortFormat << entry.track << " [" << entry.path << "]" << endl;
+         }
+
+         return;
+      }
+
+      if (args.size() == 1 && args[0] == "off")
+      {
+         playlist_view_.clear();
+         *output_ << "View removed." << endl;
+         return;
+      }
+
+      PlaylistView::Order order(PlaylistView::Order::Playlist);
+      PlaylistView::Filter filter;
+
+      for (size_t idx = 0; idx < args.size(); idx += 2)
+      {
+         std::string_view option = args[idx];
+
+         if (idx + 1 == args.size())
+         {
+            error_() << "Please specify a value after \"" << option << "\"." << endl;
+            return;
+         }
+
+         std::string_view value = args[idx + 1];
+         time_t seconds;
+
+         if (option == "by" && value == "title")
+            order = PlaylistView::Order::Title;
+         else if (option == "by" && value == "duration")
+            order = PlaylistView::Order::Duration;
+         else if (option == "by" && value == "codec")
+            order = PlaylistView::Order::Codec;
+         else if (option == "only" && Codec::findCodecType(value))
+            filter.codec = Codec::findCodecType(value);
+         else if (option == "longer" && parseDuration(value, seconds))
+            filter.longer_than = seconds;
+         else if (option == "shorter" && parseDuration(value, seconds))
+            filter.shorter_than = seconds;
+         else
+         {
+            error_() << "Unknown view option \"" << option << " " << value << "\": please use \"by title|duration|codec\", "
+               << "\"only <codec>\", \"longer <duration>\" or \"shorter <duration>\"." << endl;
+            return;
+         }
       }
+
+      auto start = std::chrono::steady_clock::now();
+      playlist_view_.define(playlist_, order, filter);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      *output_ << "View of " << playlist_view_.size() << " track(s) out of " << playlist_.size() << " built in "
+         << std::fixed << std::setprecision(3) << elapsed.count() * 1000.0 << " ms." << std::defaultfloat << endl;
    }
 
    void Shell::play_(const ArgumentArray&)
    {
-      if (currently_playing_ != playlist_.end())
+      if (playlist_.hasCurrent())
       {
+         if (playback_.isActive() && playing_handle_ == playlist_.current().handle)
+            playback_.resume();
+         else if (!startPlayback_())
+            return;
+
          is_playing_ = true;
       }
       else
       {
-         *output_ << "No track in playlist yet!" << endl;
+         error_() << "No track in playlist yet!" << endl;
       }
    }
 
    void Shell::pause_(const ArgumentArray&)
    {
-      if (currently_playing_ != playlist_.end())
+      if (playlist_.hasCurrent())
       {
+         playback_.pause();
          is_playing_ = false;
       }
       else
       {
-         *output_ << "No track in playlist yet!" << endl;
+         error_() << "No track in playlist yet!" << endl;
       }
    }
 
    void Shell::previous_(const ArgumentArray& args)
    {
-      if (currently_playing_ == playlist_.end())
+      if (!playlist_.hasCurrent())
       {
-         *output_ << "No track in playlist yet!" << endl;
+         error_() << "No track in playlist yet!" << endl;
          return;
       }
 
-      if (random_mode_)
-      {
-         goToRandomTrack_();
-         return;
-      }
+      long long number_of_jumps(1);
 
-      size_t number_of_jumps;
-
-      if (args.empty())
-      {
-         number_of_jumps = 1;
-      }
-      else
+      if (!args.empty() && (!parseInteger(args[0], number_of_jumps) || number_of_jumps < 0))
       {
-         try
-         {
-            size_t pos;
-            number_of_jumps = std::stoi(args[0], &pos);
-            if (pos != args[0].size())
-               number_of_jumps = -1;
-         }
-         catch (std::exception)
-         {
-            number_of_jumps = -1;
-         }
+         // error
+         error_() << "Only positive integral numbers are allowed as arguments for this command." << endl;
+         return;
       }
 
-      if (number_of_jumps < 0)
+      if (random_mode_)
       {
-         // error
-         *output_ << "Only positive integral numbers are allowed as arguments for this command." << endl;
+         goToRandomTrack_(number_of_jumps, false);
+         selectionChanged_();
          return;
       }
 
-      if (std::distance(playlist_.begin(), currently_playing_) < number_of_jumps)
+      size_t current_position = playlist_.currentPosition();
+
+      if (current_position < static_cast<size_t>(number_of_jumps))
       {
          if (!repeat_mode_)
          {
-            currently_playing_ = playlist_.begin();
+            playlist_.setCurrentPosition(0);
          }
          else
          {
-            size_t excess_number = number_of_jumps - std::distance(playlist_.begin(), currently_playing_);
+            size_t excess_number = number_of_jumps - current_position;
 
             excess_number %= playlist_.size();
 
-            currently_playing_ = std::prev(playlist_.end(), excess_number);
+            playlist_.setCurrentPosition((playlist_.size() - excess_number) % playlist_.size());
          }
       }
       else
       {
-         currently_playing_ = std::prev(currently_playing_, number_of_jumps);
+         playlist_.setCurrentPosition(current_position - number_of_jumps);
       }
+
+      selectionChanged_();
    }
 
    void Shell::next_(const ArgumentArray& args)
    {
-      if (currently_playing_ == playlist_.end())
+      if (!playlist_.hasCurrent())
       {
-         *output_ << "No track in playlist yet!" << endl;
+         error_() << "No track in playlist yet!" << endl;
          return;
       }
 
-      if (random_mode_)
+      long long number_of_jumps(1);
+
+      if (!args.empty() && (!parseInteger(args[0], number_of_jumps) || number_of_jumps < 0))
       {
-         goToRandomTrack_();
+         // error
+         error_() << "Only positive integral numbers are allowed as arguments for this command." << endl;
          return;
       }
 
-      size_t number_of_jumps;
+      // the queued tracks are played first, then the playlist order continues where it was left
+      Playlist::Handle queued = number_of_jumps > 0 ? play_queue_.front(playlist_) : Playlist::kInvalidHandle;
 
-      if (args.empty())
-      {
-         number_of_jumps = 1;
-      }
-      else
+      if (queued != Playlist::kInvalidHandle)
       {
-         try
-         {
-            size_t pos;
-            number_of_jumps = std::stoi(args[0], &pos);
-            if (pos != args[0].size())
-               number_of_jumps = -1;
-         }
-         catch (std::exception)
+         for (; number_of_jumps > 0 && queued != Playlist::kInvalidHandle; number_of_jumps--, queued = play_queue_.front(playlist_))
+            moveToUpcoming_(playlist_.positionOf(queued));
+
+         if (number_of_jumps == 0)
          {
-            number_of_jumps = -1;
+            *output_ << "Moved to queued track #" << playlist_.currentPosition() + 1 << " (" << play_queue_.size() << " left in the queue)." << endl;
+            selectionChanged_();
+            return;
          }
       }
 
-      if (number_of_jumps < 0)
+      if (number_of_jumps > 0)
       {
-         // error
-         *output_ << "Only positive integral numbers are allowed as arguments for this command." << endl;
+         playlist_.setCurrentPosition(orderPosition_());
+         queued_handle_ = Playlist::kInvalidHandle;
+      }
+
+      if (random_mode_)
+      {
+         goToRandomTrack_(number_of_jumps, true);
+         selectionChanged_();
          return;
       }
 
-      if (std::distance(currently_playing_, std::prev(playlist_.end())) < number_of_jumps)
+      size_t current_position = playlist_.currentPosition();
+
+      if (playlist_.size() - 1 - current_position < static_cast<size_t>(number_of_jumps))
       {
          if (!repeat_mode_)
          {
-            currently_playing_ = std::prev(playlist_.end());
+            playlist_.setCurrentPosition(playlist_.size() - 1);
          }
          else
          {
-            size_t excess_number = number_of_jumps - std::distance(currently_playing_, playlist_.end());
+            size_t excess_number = number_of_jumps - (playlist_.size() - current_position);
 
             excess_number %= playlist_.size();
 
-            currently_playing_ = std::next(playlist_.begin(), excess_number);
+            playlist_.setCurrentPosition(excess_number);
          }
       }
       else
       {
-         currently_playing_ = std::next(currently_playing_, number_of_jumps);
+         playlist_.setCurrentPosition(current_position + number_of_jumps);
       }
-   }
-
-   void Shell::random_(const ArgumentArray&)
-   {
-      random_mode_ = true;
-      *output_ << "Random mode on." << endl;
-   }
 
-   void Shell::repeat_(const ArgumentArray&)
-   {
-      repeat_mode_ = true;
-      *output_ << "Repeat mode on." << endl;
+      selectionChanged_();
    }
 
-   void Shell::cd_(const ArgumentArray& args)
+   void Shell::queue_(const ArgumentArray& args)
    {
       if (args.empty())
       {
-         *output_ << std::filesystem::current_path() << endl;
-      }
-      else
-      {
-         auto target_path = std::filesystem::current_path() / args[0];
-         if (std::filesystem::exists(target_path))
+         play_queue_.prune(playlist_);
+
+         if (play_queue_.empty())
+            *output_ << "The queue is empty." << endl;
+
+         for (size_t idx = 0; idx < play_queue_.size(); idx++)
          {
-            std::filesystem::current_path(target_path);
-            *output_ << "Moved to " << target_path << endl;
+            size_t position = playlist_.positionOf(play_queue_[idx]);
+            const Playlist::Entry& entry = playlist_[position];
+
+            *output_ << idx + 1 << ") #" << position + 1 << " " << Track::shortFormat << entry.track << " [" << entry.path << "]" << endl;
          }
-         else
+
+         return;
+      }
+
+      size_t queued_count(0);
+
+      // one argument at a time, so that the tracks are queued in the order given
+      for (std::string_view arg : args)
+      {
+         for (int idx : parseIndicesFromArgs_({ arg }))
          {
-            *output_ << "The path " << target_path << " does not exist." << endl;
+            play_queue_.pushBack(playlist_[idx].handle);
+            queued_count++;
+         }
+      }
+
+      *output_ << queued_count << " track(s) queued, " << play_queue_.size() << " in the queue." << endl;
+   }
+
+   void Shell::queueNext_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         error_() << "Please specify at least one track name or position in the playlist to queue." << endl;
+         return;
+      }
+
+      std::vector<Playlist::Handle> handles;
+
+      for (std::string_view arg : args)
+      {
+         for (int idx : parseIndicesFromArgs_({ arg }))
+            handles.push_back(playlist_[idx].handle);
+      }
+
+      // queued in reverse at the front, so that the first track given plays first
+      for (auto handle = handles.rbegin(); handle != handles.rend(); ++handle)
+         play_queue_.pushFront(*handle);
+
+      *output_ << handles.size() << " track(s) queued to play next, " << play_queue_.size() << " in the queue." << endl;
+   }
+
+   void Shell::dequeue_(const ArgumentArray& args)
+   {
+      // the queue indices are those printed by "queue", which skips the removed tracks
+      play_queue_.prune(playlist_);
+
+      if (args.empty())
+      {
+         play_queue_.clear();
+         *output_ << "Queue cleared." << endl;
+         return;
+      }
+
+      std::set<size_t> indices;
+
+      for (std::string_view arg : args)
+      {
+         long long index;
+
+         if (!parseInteger(arg, index) || index < 1 || static_cast<size_t>(index) > play_queue_.size())
+         {
+            error_() << "Impossible to find queued track " << arg << ": there are only " << play_queue_.size() << " track(s) in the queue." << endl;
+            continue;
+         }
+
+         indices.insert(static_cast<size_t>(index - 1));
+      }
+
+      for (auto index = indices.rbegin(); index != indices.rend(); ++index)
+         play_queue_.erase(*index);
+
+      *output_ << indices.size() << " track(s) removed from the queue, " << play_queue_.size() << " left." << endl;
+   }
+
+   void Shell::wait_(const ArgumentArray&)
+   {
+      if (!wait_allowed_)
+      {
+         error_() << "Waiting for the end of the track would hold up the other sessions: poll with playback_stats instead." << endl;
+         return;
+      }
+
+      if (playback_.isActive() && playback_.isPaused())
+      {
+         error_() << "The playback is paused." << endl;
+         return;
+      }
+
+      // the track ends either with the stream, or with a gapless transition to the next one
+      size_t transitions = playback_.getTransitionCount();
+      while (decoding_ && playback_.isActive() && playback_.getTransitionCount() == transitions)
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+
+   void Shell::setOutput_(const ArgumentArray& args)
+   {
+      size_t argument_count = args.size();
+      bool downmix = argument_count > 0 && args.back() == "--mono";
+      if (downmix)
+         argument_count--;
+
+      if (argument_count == 1 && args[0] == "null")
+      {
+         playback_.setSink(std::make_unique<NullSink>());
+      }
+      else if (argument_count == 2 && args[0] == "file")
+      {
+         playback_.setSink(std::make_unique<FileSink>(string(args[1])));
+      }
+      else
+      {
+         error_() << "Please specify \"null\", or \"file\" followed by the path of the file to write." << endl;
+         return;
+      }
+
+      playback_.setDownmix(downmix);
+
+      // the track is played again from its start on the new output
+      is_playing_ = false;
+      playing_handle_ = Playlist::kInvalidHandle;
+      decoding_ = false;
+
+      *output_ << "Output changed." << endl;
+   }
+
+   void Shell::resample_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         if (playback_.getOutputRate() == 0)
+            *output_ << "Resampling: off" << endl;
+         else
+            *output_ << "Resampling: " << playback_.getOutputRate() << " Hz, "
+               << Resampler::getQualityName(playback_.getResamplerQuality()) << " quality" << endl;
+         return;
+      }
+
+      if (args.size() == 1 && args[0] == "off")
+      {
+         playback_.setOutputRate(0, playback_.getResamplerQuality());
+      }
+      else
+      {
+         long long output_rate(0);
+
+         if (!parseInteger(args[0], output_rate) || output_rate < 1000 || output_rate > 384000 || args.size() > 2)
+         {
+            error_() << "Please specify \"off\", or an output rate between 1000 and 384000 Hz optionally followed by a quality." << endl;
+            return;
+         }
+
+         std::optional<Resampler::Quality> quality = args.size() == 2 ? Resampler::findQuality(args[1]) : Resampler::Quality::Medium;
+
+         if (!quality)
+         {
+            error_() << "Unknown resampling quality: " << args[1] << " (expected fast, medium or high)" << endl;
+            return;
+         }
+
+         playback_.setOutputRate(static_cast<unsigned>(output_rate), *quality);
+      }
+
+      // the track is played again from its start at the new rate
+      is_playing_ = false;
+      playing_handle_ = Playlist::kInvalidHandle;
+      decoding_ = false;
+   }
+
+   void Shell::crossfade_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         std::chrono::milliseconds crossfade = playback_.getCrossfade();
+
+         if (crossfade.count() == 0)
+            *output_ << "Crossfade: off" << endl;
+         else
+            *output_ << "Crossfade: " << crossfade.count() / 1000.0 << " s" << endl;
+         return;
+      }
+
+      double seconds(0.0);
+
+      if (args.size() == 1 && args[0] == "off")
+      {
+         seconds = 0.0;
+      }
+      else if (args.size() > 1 || !parseDecimal(args[0], seconds) || seconds < 0.0 || seconds > 20.0)
+      {
+         error_() << "Please specify \"off\", or a crossfade length between 0 and 20 seconds." << endl;
+         return;
+      }
+
+      playback_.setCrossfade(std::chrono::milliseconds(std::lround(seconds * 1000.0)));
+
+      // the track is played again from its start with the new crossfade length
+      is_playing_ = false;
+      playing_handle_ = Playlist::kInvalidHandle;
+      decoding_ = false;
+   }
+
+   void Shell::replayGain_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         if (!replay_gain_)
+            *output_ << "ReplayGain: off" << endl;
+         else
+            *output_ << "ReplayGain: on, preamp " << std::showpos << replay_gain_preamp_db_ << std::noshowpos << " dB" << endl;
+         return;
+      }
+
+      double preamp_db(0.0);
+
+      if (args[0] == "off" && args.size() == 1)
+      {
+         replay_gain_ = false;
+      }
+      else if (args[0] == "on" && (args.size() == 1 || (args.size() == 2 && parseDecimal(args[1], preamp_db) && std::abs(preamp_db) <= 20.0)))
+      {
+         replay_gain_ = true;
+         replay_gain_preamp_db_ = static_cast<float>(preamp_db);
+      }
+      else
+      {
+         error_() << "Please specify \"off\", or \"on\" optionally followed by a preamp gain between -20 and 20 dB." << endl;
+         return;
+      }
+
+      // the gain of the playing track is kept, the upcoming one is prefetched again with the new gain
+      if (gapless_handle_.load() == Playlist::kInvalidHandle)
+         prefetcher_.cancel();
+   }
+
+   void Shell::volume_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         *output_ << "Volume: " << std::lround(playback_.getVolume() * 100.0f) << "%" << endl;
+         return;
+      }
+
+      long long percent(0);
+
+      if (!parseInteger(args[0], percent) || percent < 0 || percent > 100)
+      {
+         error_() << "The volume must be an integral percentage between 0 and 100." << endl;
+         return;
+      }
+
+      playback_.setVolume(percent / 100.0f);
+   }
+
+   void Shell::showPlaybackStatistics_(const ArgumentArray&)
+   {
+      PlaybackEngine::Statistics statistics = playback_.getStatistics();
+
+      *output_ << "Playback: " << (playback_.isActive() ? (playback_.isPaused() ? "paused" : "playing") : "stopped") << endl;
+      *output_ << "Frames played: " << statistics.frames_played << endl;
+      *output_ << "Underruns: " << statistics.underruns << endl;
+      *output_ << "Latency: " << std::fixed << std::setprecision(3) << statistics.average_latency_ms << " ms average, "
+         << statistics.max_latency_ms << " ms max" << std::defaultfloat << endl;
+
+      if (playback_.getOutputRate() != 0)
+      {
+         *output_ << "Resampler: " << std::fixed << std::setprecision(3) << statistics.resampler_cpu_percent << "% CPU ("
+            << Resampler::getQualityName(playback_.getResamplerQuality()) << " quality)" << std::defaultfloat << endl;
+      }
+
+      *output_ << "DSP kernels: " << Dsp::kernels().name << endl;
+
+      // time the jobs of the shared thread pool waited for a worker, for all the playbacks of the process
+      ThreadPool::Statistics scheduler = ThreadPool::shared().getStatistics();
+      *output_ << "Scheduling latency:" << std::fixed << std::setprecision(3);
+      for (size_t level = 0; level < ThreadPool::kPriorityCount; level++)
+      {
+         *output_ << (level > 0 ? ", " : " ") << ThreadPool::getPriorityName(static_cast<ThreadPool::Priority>(level)) << " "
+            << scheduler.levels[level].average_latency_us / 1000.0 << " ms average, " << scheduler.levels[level].max_latency_us / 1000.0 << " ms max";
+      }
+      *output_ << std::defaultfloat << endl;
+      *output_ << "Transitions: " << prefetcher_.getWarmCount() << " warm, " << prefetcher_.getColdCount() << " cold" << endl;
+
+      if (!playback_.isActive() && !playback_.getErrorMessage().empty())
+         *output_ << "Decoding stopped early. (Reason: " << playback_.getErrorMessage() << ")" << endl;
+   }
+
+   void Shell::random_(const ArgumentArray& args)
+   {
+      long long seed(0);
+
+      if (!args.empty() && (!parseInteger(args[0], seed) || seed < 0 || seed > UINT32_MAX))
+      {
+         error_() << "The seed must be an integral number between 0 and " << UINT32_MAX << "." << endl;
+         return;
+      }
+
+      // a new shuffle starts from the selected track
+      if (!args.empty())
+         shuffle_.seed(static_cast<std::uint32_t>(seed));
+
+      if (!random_mode_ || !args.empty())
+         shuffle_.reset();
+
+      random_mode_ = true;
+      *output_ << "Random mode on." << endl;
+   }
+
+   void Shell::repeat_(const ArgumentArray&)
+   {
+      repeat_mode_ = true;
+      *output_ << "Repeat mode on." << endl;
+   }
+
+   void Shell::exit_(const ArgumentArray&)
+   {
+      exit_requested_ = true;
+   }
+
+   void Shell::cd_(const ArgumentArray& args)
+   {
+      if (args.empty())
+      {
+         *output_ << std::filesystem::current_path() << endl;
+      }
+      else if (!directory_change_allowed_)
+      {
+         error_() << "The current directory is shared with other sessions and cannot be changed." << endl;
+      }
+      else
+      {
+         auto target_path = std::filesystem::current_path() / args[0];
+         if (std::filesystem::exists(target_path))
+         {
+            std::filesystem::current_path(target_path);
+            *output_ << "Moved to " << target_path << endl;
+         }
+         else
+         {
+            error_() << "The path " << target_path << " does not exist." << endl;
          }
       }
    }
@@ -454,56 +1130,106 @@ namespace MusicPlayer
    {
       if (arg.size() != 1)
       {
-         *output_ << "This command only accept one argument." << endl;
+         error_() << "This command only accept one argument." << endl;
          return;
       }
-      
-      std::ifstream file(arg[0], std::ifstream::in);
 
-      if (!file.is_open())
+      PlaylistLoader::Report report;
+
+      string file_name(arg[0]);
+
+      if (BinaryPlaylist::isBinaryPlaylist(file_name))
+      {
+         string error;
+         if (!BinaryPlaylist::load(file_name, playlist_, report, error))
+         {
+            error_() << error << endl;
+            return;
+         }
+      }
+      else if (PlaylistJournal::isJournaledPlaylist(file_name))
+      {
+         string error;
+         if (!journal_.load(file_name, playlist_, report, error))
+         {
+            error_() << error << endl;
+            return;
+         }
+      }
+      else if (!PlaylistLoader::load(file_name, playlist_, report))
       {
-         *output_ << "File \"" << arg[0] << "\" could not be opened." << endl;
+         error_() << "File \"" << arg[0] << "\" could not be opened." << endl;
          return;
       }
 
-     string track_record;
-     while (std::getline(file, track_record))
-     {
-         ArgumentArray splitted = split(track_record, "||");
-         string track_file = splitted[0];
-         string track_infos = splitted[1];
+      if (!playlist_.hasCurrent())
+         playlist_.setCurrentPosition(0);
 
-         Track new_track;
-         new_track.deserialize(track_infos);
+      *output_ << "Loaded " << report.loaded_count << " track(s) from " << report.line_count << " line(s) in "
+         << std::fixed << std::setprecision(3) << report.seconds * 1000.0 << " ms";
 
-         playlist_.push_back({track_file, new_track});
-     }
+      if (report.seconds > 0.0)
+         *output_ << " (" << std::setprecision(0) << report.line_count / report.seconds << " lines/s)";
 
-     if(currently_playing_ == playlist_.end())
-         currently_playing_ = playlist_.begin();
+      if (report.chunk_count > 1)
+         *output_ << " using " << report.chunk_count << " parallel chunks";
 
-     file.close();
+      *output_ << std::defaultfloat << ", peak memory " << getPeakResidentMemory() / (1024 * 1024) << " MB." << endl;
+
+      if (report.malformed_count > 0)
+      {
+         *output_ << report.malformed_count << " malformed line(s) skipped, first at line " << report.first_malformed_line
+            << " (Reason: " << report.first_error << ")" << endl;
+      }
    }
 
    void Shell::savePlaylist_(const ArgumentArray& args)
    {
       if (args.size() != 1)
       {
-         *output_ << "This command only accept one argument." << endl;
+         error_() << "This command only accept one argument." << endl;
+         return;
+      }
+
+      string file_name(args[0]);
+
+      if (BinaryPlaylist::isBinaryPlaylist(file_name))
+      {
+         string error;
+         if (!BinaryPlaylist::save(file_name, playlist_, error))
+            error_() << error << endl;
+         return;
+      }
+
+      if (PlaylistJournal::isJournaledPlaylist(file_name))
+      {
+         PlaylistJournal::SaveReport report;
+         string error;
+
+         if (!journal_.save(file_name, playlist_, report, error))
+         {
+            error_() << error << endl;
+            return;
+         }
+
+         if (report.compacted)
+            *output_ << "Saved " << report.record_count << " track(s) in a new snapshot (" << report.written_bytes << " bytes)." << endl;
+         else
+            *output_ << "Saved " << report.record_count << " change(s) (" << report.written_bytes << " bytes)." << endl;
          return;
       }
-      
-      std::ofstream file(args[0], std::ofstream::out | std::ofstream::trunc);
+
+      std::ofstream file(file_name, std::ofstream::out | std::ofstream::trunc);
 
       if (!file.is_open())
       {
-         *output_ << "File \"" << args[0] << "\" could not be opened." << endl;
+         error_() << "File \"" << args[0] << "\" could not be opened." << endl;
          return;
       }
 
-      for(auto& entry: playlist_) {
-         const Track& track_to_save = entry.second;
-         file << entry.first << "||" << track_to_save.serialize() << endl;
+      for(const auto& entry: playlist_) {
+         const Track& track_to_save = entry.track;
+         file << entry.path << "||" << track_to_save.serialize() << endl;
       }
 
       file.close();
@@ -513,30 +1239,60 @@ namespace MusicPlayer
 
 #pragma region General methods
 
-   void Shell::run()
+   int Shell::run()
    {
       if (!input_ || !output_)
-         return;
+         return 1;
 
-      printWelcomeMessage_();
+      if (interactive_)
+         printWelcomeMessage_();
 
-      bool exit_requested(false);
-      while (!exit_requested)
+      int exit_status(0);
+      exit_requested_ = false;
+
+      while (!exit_requested_)
       {
-         Instruction submitted;
-         ArgumentArray arguments;
+         if (interactive_)
+            *output_ << ">>>> " << std::flush;
 
-         std::tie(submitted, arguments) = getInstruction_();
+         if (!std::getline(*input_, full_input_))
+            break;
 
-         try
-         {
-            submitted(this, arguments);
-         }
-         catch (std::exception& ex)
+         if (!execute(full_input_) && stop_on_error_)
          {
-            *output_ << "ERROR: " << ex.what() << std::endl;
+            exit_status = 1;
+            break;
          }
       }
+
+      output_->flush();
+
+      return exit_status;
+   }
+
+   bool Shell::execute(std::string_view command_line)
+   {
+      Instruction submitted = getInstruction_(command_line);
+
+      instruction_failed_ = false;
+
+      try
+      {
+         syncPlayback_();
+         (this->*submitted)(arguments_);
+         syncPlayback_();
+      }
+      catch (std::exception& ex)
+      {
+         error_() << "ERROR: " << ex.what() << endl;
+      }
+
+      snapshots_.publish(playlist_, is_playing_, random_mode_, repeat_mode_);
+
+      if (instruction_failed_)
+         output_->flush();
+
+      return !instruction_failed_;
    }
 
    void Shell::printWelcomeMessage_()
@@ -548,35 +1304,111 @@ namespace MusicPlayer
       *output_ << "Print help with command: " << "help" << endl;
    }
 
-   std::tuple<Shell::Instruction, Shell::ArgumentArray> Shell::getInstruction_()
+   /**
+    * Finds the instruction called in a command line, and stores its arguments in arguments_.
+    *
+    * The arguments are views on the command line, which must outlive their use.
+    *
+    * \param full_input The command line.
+    * \return The instruction to call with the arguments.
+    */
+   Shell::Instruction Shell::getInstruction_(std::string_view full_input)
    {
-      *output_ << ">>>> ";
+      arguments_.clear();
 
-      std::string full_input;
-      std::getline(*input_, full_input);
+      std::string_view instruction_name;
 
-      vector<string> parsed = split(full_input, " ");
+      for (std::string_view word : Tokenizer(full_input, ' '))
+      {
+         if (instruction_name.empty())
+            instruction_name = word;
+         else
+            arguments_.push_back(word);
+      }
 
-      if (parsed.empty())
+      if (instruction_name.empty())
          // noop
-         return std::make_tuple(&Shell::noop_, ArgumentArray());
+         return &Shell::noop_;
 
-      if (available_instructions_.count(parsed[0]))
-      {
-         return std::make_tuple(
-            available_instructions_.at(parsed[0]),
-            ArgumentArray(parsed.begin() + 1, parsed.end())
-         );
-      }
-      else
+      const InstructionEntry* match = std::lower_bound(std::begin(kInstructions), std::end(kInstructions), instruction_name,
+         [](const InstructionEntry& entry, std::string_view name) { return entry.name < name; });
+
+      if (match != std::end(kInstructions) && match->name == instruction_name)
+         return match->instruction;
+
+      // instruction not found among the available ones
+      // call unknown instruction handler with submitted command as argument
+      arguments_.assign(1, instruction_name);
+      return &Shell::unknownInstruction_;
+   }
+
+   /**
+    * Reports that the running instruction failed.
+    *
+    * \return The output stream, to print the error message to.
+    */
+   std::ostream& Shell::error_()
+   {
+      instruction_failed_ = true;
+      return *output_;
+   }
+
+   /**
+    * Parses a list of arguments into ranges of positions in the playlist: positions, ranges of positions such as
+    * "100-2000", or file names, whose entries are each a range.
+    *
+    * \param The argument list.
+    * \return The ranges, in the order of the arguments.
+    */
+   std::vector<Playlist::Range> Shell::parseRangesFromArgs_(const ArgumentArray& args)
+   {
+      std::vector<Playlist::Range> ranges;
+
+      for (std::string_view arg : args)
       {
-         // instruction not found among the available ones
-         // call unknown instruction handler with submitted command as argument
-         return std::make_tuple(
-            &Shell::unknownInstruction_,
-            ArgumentArray(1, parsed[0])
-         );
+         long long first, last;
+         size_t separator = arg.find('-');
+
+         // file names may contain dashes: only two numbers form a range
+         if (separator == std::string_view::npos || !parseInteger(arg.substr(0, separator), first) || !parseInteger(arg.substr(separator + 1), last))
+         {
+            if (!parseInteger(arg, first))
+            {
+               // file names are interned, so unknown names cannot be in the playlist
+               InternedString file_name;
+
+               if (!StringPool::shared().find(arg, file_name) || playlist_.countOf(file_name) == 0)
+               {
+                  error_() << "Impossible to find track \"" << arg << "\": the track doesn't exist in the playlist." << endl;
+                  continue;
+               }
+
+               // in no particular order: the ranges are sorted and merged when removed
+               for (size_t position : playlist_.positionsOf(file_name))
+                  ranges.push_back({ position, 1 });
+               continue;
+            }
+
+            last = first;
+         }
+
+         if (first < 1 || last < first)
+         {
+            error_() << "Impossible to find tracks \"" << arg << "\": positions start at 1, and ranges go from the first position to the last one." << endl;
+            continue;
+         }
+
+         if (static_cast<size_t>(last) > playlist_.size())
+         {
+            error_() << "Impossible to find track at position " << last << " : "
+               << "there are only " << playlist_.size() << " elements in the playlist." << endl;
+            continue;
+         }
+
+         ranges.push_back({ static_cast<size_t>(first - 1), static_cast<size_t>(last - first + 1) });
       }
+
+      return ranges;
    }
 
    /**
@@ -589,66 +1421,317 @@ namespace MusicPlayer
    {
       std::set<int> found_indices{};
 
-      for (const string& arg : args)
+      for (std::string_view arg : args)
       {
          // find out if argument is number-like
-         int index;
+         long long index;
 
-         try
-         {
-            size_t pos;
-            index = std::stoi(arg, &pos);
-            if (pos != arg.size())
-               index = -1;
-         }
-         catch (std::exception)
-         {
+         if (!parseInteger(arg, index))
             index = -1;
-         }
 
          if (index > 0)
          {
             // argument is number-like
 
-            if (index > playlist_.size())
+            if (static_cast<size_t>(index) > playlist_.size())
             {
-               *output_ << "Impossible to find track at position " << index << " : "
+               error_() << "Impossible to find track at position " << index << " : "
                   << "there are only " << playlist_.size() << " elements in the playlist." << endl;
                continue;
             }
 
-            found_indices.insert(index - 1);
+            found_indices.insert(static_cast<int>(index - 1));
          }
          else
          {
-            auto match_on_filename = [&arg](const std::pair<string, Track>& entry) -> bool { return entry.first == arg; };
+            // argument is file name: file names are interned, so unknown names cannot be in the playlist
+            InternedString file_name;
 
-            // argument is file name
-            Playlist::iterator match = std::find_if(playlist_.begin(), playlist_.end(), match_on_filename);
-            if (match == playlist_.end())
+            if (!StringPool::shared().find(arg, file_name) || playlist_.countOf(file_name) == 0)
             {
-               *output_ << "Impossible to find track \"" << arg << "\": the track doesn't exist in the playlist." << endl;
+               error_() << "Impossible to find track \"" << arg << "\": the track doesn't exist in the playlist." << endl;
                continue;
             }
 
-            while (match != playlist_.end())
-            {
-               found_indices.insert(std::distance(playlist_.begin(), match));
-               match = std::find_if(std::next(match), playlist_.end(), match_on_filename);
-            }
+            for (size_t position : playlist_.positionsOf(file_name))
+               found_indices.insert(static_cast<int>(position));
          }
       }
 
       return found_indices;
    }
 
-   void Shell::goToRandomTrack_()
+   /**
+    * Moves the selection along the shuffled order: forward to the tracks drawn next, or back to the tracks played
+    * before.
+    */
+   void Shell::goToRandomTrack_(long long number_of_jumps, bool forward)
+   {
+      Playlist::Handle handle = playlist_.current().handle;
+
+      // the shuffle is walked one step at a time, so the count is first bounded by the steps that can make a difference
+      long long track_count = static_cast<long long>(playlist_.size());
+      if (forward && repeat_mode_)
+      {
+         // the current cycle has fewer than track_count entries left, and each later cycle is a new random order:
+         // reducing the count modulo the playlist size, while still going past the current cycle, lands on an
+         // equally random track
+         if (number_of_jumps > 2 * track_count)
+            number_of_jumps = track_count + number_of_jumps % track_count;
+      }
+      else
+      {
+         // a cycle, or the history, holds every entry at most once: the step after them reaches its end
+         number_of_jumps = std::min(number_of_jumps, track_count + 1);
+      }
+
+      for (long long jump = 0; jump < number_of_jumps; jump++)
+      {
+         Playlist::Handle moved = forward ? shuffle_.next(playlist_, handle, repeat_mode_) : shuffle_.previous(playlist_, handle);
+
+         if (moved == Playlist::kInvalidHandle)
+         {
+            *output_ << (forward ? "Every track of the playlist was played in this shuffle." : "No track was played before in this shuffle.") << endl;
+            break;
+         }
+
+         handle = moved;
+      }
+
+      size_t position = playlist_.positionOf(handle);
+      playlist_.setCurrentPosition(position);
+      *output_ << "Moved to track #" << position + 1 << endl;
+   }
+
+   /**
+    * Returns the position the playlist order continues from: while a queued track is selected, the entry that was
+    * selected before the queued tracks started, if it is still in the playlist.
+    */
+   size_t Shell::orderPosition_() const
+   {
+      if (playlist_.hasCurrent() && playlist_.current().handle == queued_handle_)
+      {
+         size_t position = playlist_.positionOf(queue_return_);
+         if (position != Playlist::npos)
+            return position;
+      }
+
+      return playlist_.currentPosition();
+   }
+
+   /**
+    * Returns the position of the track that follows the selected one, according to the random and repeat modes.
+    *
+    * \return The position, or npos at the end of the playlist.
+    */
+   size_t Shell::upcomingPosition_()
+   {
+      if (!playlist_.hasCurrent())
+         return Playlist::npos;
+
+      Playlist::Handle queued = play_queue_.front(playlist_);
+      if (queued != Playlist::kInvalidHandle)
+         return playlist_.positionOf(queued);
+
+      size_t order_position = orderPosition_();
+
+      // drawn once, so that the track prefetched is the one played next
+      if (random_mode_)
+         return playlist_.positionOf(shuffle_.peekNext(playlist_, playlist_[order_position].handle, repeat_mode_));
+
+      size_t next_position = order_position + 1;
+
+      if (next_position < playlist_.size())
+         return next_position;
+
+      return repeat_mode_ ? 0 : Playlist::npos;
+   }
+
+   /**
+    * Selects the track that follows the selected one, and takes it from the queue if it is the next queued track.
+    */
+   void Shell::moveToUpcoming_(size_t position)
+   {
+      Playlist::Handle handle = playlist_[position].handle;
+
+      if (handle == play_queue_.front(playlist_))
+      {
+         play_queue_.popFront();
+
+         if (!playlist_.hasCurrent() || playlist_.current().handle != queued_handle_)
+            queue_return_ = playlist_.hasCurrent() ? playlist_.current().handle : Playlist::kInvalidHandle;
+
+         queued_handle_ = handle;
+      }
+      else
+      {
+         queued_handle_ = Playlist::kInvalidHandle;
+      }
+
+      playlist_.setCurrentPosition(position);
+   }
+
+   /**
+    * Starts decoding the selected track from its start, from the prefetched buffers if available.
+    *
+    * Tracks without a decoder or without an audio file are played silently.
+    *
+    * \return false if the output could not play the track.
+    */
+   bool Shell::startPlayback_()
+   {
+      const Playlist::Entry& entry = playlist_.current();
+      Codec::Type codec = entry.track.getCodec();
+
+      playback_.stop();
+      playing_handle_ = entry.handle;
+      decoding_ = false;
+      gapless_handle_.store(Playlist::kInvalidHandle);
+      seen_transitions_ = 0;
+
+      PlaybackEngine::Stream stream = prefetcher_.take(entry.handle);
+
+      if (!stream.decoder)
+      {
+         std::unique_ptr<Decoder> decoder = DecoderRegistry::create(codec);
+
+         if (!decoder)
+         {
+            *output_ << Codec::getCodecName(codec) << " audio cannot be decoded, playing silently." << endl;
+            return true;
+         }
+
+         if (!decoder->open(DecoderRegistry::audioFileFor(entry.path, codec)))
+         {
+            *output_ << decoder->getErrorMessage() << " Playing silently." << endl;
+            return true;
+         }
+
+         stream = { std::move(decoder), streamGain_(entry.track) };
+      }
+
+      // the following track is prepared before the end of this one can be reached
+      decoding_ = true;
+      prefetchUpcoming_();
+
+      string error;
+      if (!playback_.start(std::move(stream), error))
+      {
+         playing_handle_ = Playlist::kInvalidHandle;
+         decoding_ = false;
+         prefetcher_.cancel();
+         error_() << error << endl;
+         return false;
+      }
+
+      return true;
+   }
+
+   /**
+    * Restarts the playback on the selected track if it changed.
+    */
+   void Shell::selectionChanged_()
+   {
+      if (playlist_.hasCurrent() && playlist_.current().handle == playing_handle_)
+         return;
+
+      playback_.stop();
+      playing_handle_ = Playlist::kInvalidHandle;
+      decoding_ = false;
+
+      if (is_playing_ && playlist_.hasCurrent() && !startPlayback_())
+         is_playing_ = false;
+   }
+
+   /**
+    * Follows the progress of the playback: moves the selection to the track that is heard, starts the next
+    * track when the previous one ended, and prefetches the track after.
+    */
+   void Shell::syncPlayback_()
+   {
+      if (!decoding_)
+         return;
+
+      size_t transitions = playback_.getTransitionCount();
+
+      if (transitions != seen_transitions_)
+      {
+         // the playback continued without gap with the prefetched track
+         seen_transitions_ = transitions;
+         playing_handle_ = gapless_handle_.exchange(Playlist::kInvalidHandle);
+
+         size_t position = playlist_.positionOf(playing_handle_);
+         if (position != Playlist::npos)
+            moveToUpcoming_(position);
+         else
+            playlist_.setCurrentPosition(Playlist::npos);
+      }
+      else if (is_playing_ && !playback_.isActive())
+      {
+         // the next track has another format, or could not be prefetched in time
+         size_t upcoming = upcomingPosition_();
+         playing_handle_ = Playlist::kInvalidHandle;
+
+         if (upcoming == Playlist::npos)
+         {
+            // end of the playlist
+            is_playing_ = false;
+            decoding_ = false;
+         }
+         else
+         {
+            moveToUpcoming_(upcoming);
+            selectionChanged_();
+         }
+      }
+
+      if (!playlist_.hasCurrent())
+      {
+         playback_.stop();
+         is_playing_ = false;
+         decoding_ = false;
+         playing_handle_ = Playlist::kInvalidHandle;
+      }
+
+      prefetchUpcoming_();
+   }
+
+   void Shell::prefetchUpcoming_()
+   {
+      // a single track is handed to the playback engine ahead of time
+      if (!decoding_ || gapless_handle_.load() != Playlist::kInvalidHandle)
+         return;
+
+      size_t upcoming = upcomingPosition_();
+
+      if (upcoming == Playlist::npos)
+      {
+         prefetcher_.cancel();
+         return;
+      }
+
+      const Playlist::Entry& entry = playlist_[upcoming];
+      if (entry.handle == prefetcher_.getPendingHandle())
+         return;
+
+      Codec::Type codec = entry.track.getCodec();
+      string audio_file = DecoderRegistry::audioFileFor(entry.path, codec);
+
+      if (audio_file.empty())
+         prefetcher_.cancel();
+      else
+         prefetcher_.prefetch(entry.handle, codec, std::move(audio_file), streamGain_(entry.track));
+   }
+
+   /**
+    * Returns the linear gain normalizing the loudness of a track, if ReplayGain is enabled and the track has its metadata.
+    */
+   float Shell::streamGain_(const Track& track) const
    {
-      std::uniform_int_distribution<> distrib(1, playlist_.size());
-      int next_track_index = distrib(rng_) - 1;
+      if (!replay_gain_ || !track.getReplayGain())
+         return 1.0f;
 
-      currently_playing_ = std::next(playlist_.begin(), next_track_index);
-      *output_ << "Moved to track #" << next_track_index + 1 << endl;
+      return track.getReplayGain()->getFactor(replay_gain_preamp_db_);
    }
 
 #pragma endregion
@@ -0,0 +1,191 @@
+#include "Shuffle.h"
+
+#include <utility>
+
+namespace MusicPlayer
+{
+
+   Shuffle::Shuffle() :
+      drawn_(0),
+      cursor_(Playlist::npos)
+   {
+   }
+
+   void Shuffle::seed(std::uint32_t seed)
+   {
+      rng_.seed(seed);
+   }
+
+   void Shuffle::reset()
+   {
+      order_.clear();
+      index_.clear();
+      drawn_ = 0;
+      cursor_ = Playlist::npos;
+   }
+
+   Playlist::Handle Shuffle::peekNext(const Playlist& playlist, Playlist::Handle current, bool repeat)
+   {
+      sync_(playlist);
+      anchor_(current);
+
+      size_t upcoming = upcomingIndex_(playlist, repeat);
+      return upcoming != Playlist::npos ? order_[upcoming] : Playlist::kInvalidHandle;
+   }
+
+   Playlist::Handle Shuffle::next(const Playlist& playlist, Playlist::Handle current, bool repeat)
+   {
+      sync_(playlist);
+      anchor_(current);
+
+      size_t upcoming = upcomingIndex_(playlist, repeat);
+      if (upcoming == Playlist::npos)
+         return Playlist::kInvalidHandle;
+
+      cursor_ = upcoming;
+      return order_[cursor_];
+   }
+
+   Playlist::Handle Shuffle::previous(const Playlist& playlist, Playlist::Handle current)
+   {
+      sync_(playlist);
+      anchor_(current);
+
+      // removed entries stay in the history until the next cycle, and are skipped
+      for (size_t index = cursor_; index != Playlist::npos && index > 0;)
+      {
+         index--;
+
+         if (playlist.positionOf(order_[index]) != Playlist::npos)
+         {
+            cursor_ = index;
+            return order_[cursor_];
+         }
+      }
+
+      return Playlist::kInvalidHandle;
+   }
+
+   void Shuffle::sync_(const Playlist& playlist)
+   {
+      // handles are given in increasing order: the handles not known yet are those of the entries added since
+      for (size_t handle = index_.size(); handle < playlist.handleCount(); handle++)
+      {
+         bool present = playlist.positionOf(static_cast<Playlist::Handle>(handle)) != Playlist::npos;
+
+         index_.push_back(present ? static_cast<std::uint32_t>(order_.size()) : kNotShuffled);
+         if (present)
+            order_.push_back(static_cast<Playlist::Handle>(handle));
+      }
+   }
+
+   void Shuffle::anchor_(Playlist::Handle current)
+   {
+      if (cursor_ != Playlist::npos && order_[cursor_] == current)
+         return;
+
+      if (current >= index_.size() || index_[current] == kNotShuffled)
+      {
+         cursor_ = Playlist::npos;
+         return;
+      }
+
+      // an entry selected outside of the shuffle is played now: it joins the history
+      size_t index = index_[current];
+      if (index >= drawn_)
+      {
+         swap_(index, drawn_);
+         index = drawn_++;
+      }
+
+      cursor_ = index;
+   }
+
+   void Shuffle::swap_(size_t first, size_t second)
+   {
+      std::swap(order_[first], order_[second]);
+      index_[order_[first]] = static_cast<std::uint32_t>(first);
+      index_[order_[second]] = static_cast<std::uint32_t>(second);
+   }
+
+   void Shuffle::forget_(size_t index)
+   {
+      Playlist::Handle handle = order_[index];
+
+      swap_(index, order_.size() - 1);
+      order_.pop_back();
+      index_[handle] = kNotShuffled;
+   }
+
+   /**
+    * Returns the index in order_ of the entry after the current one: the next entry of the history, or a
+    * handle drawn among the remaining ones.
+    *
+    * \return The index, or npos if the cycle is over.
+    */
+   size_t Shuffle::upcomingIndex_(const Playlist& playlist, bool repeat)
+   {
+      size_t index = cursor_ != Playlist::npos ? cursor_ + 1 : drawn_;
+
+      while (index < drawn_ && playlist.positionOf(order_[index]) == Playlist::npos)
+         index++;
+
+      if (index < drawn_)
+         return index;
+
+      for (unsigned cycle = 0; cycle < 2; cycle++)
+      {
+         while (drawn_ < order_.size())
+         {
+            std::uniform_int_distribution<size_t> distrib(drawn_, order_.size() - 1);
+            swap_(distrib(rng_), drawn_);
+
+            if (playlist.positionOf(order_[drawn_]) != Playlist::npos)
+               return drawn_++;
+
+            forget_(drawn_);
+         }
+
+         if (!repeat || cycle > 0)
+            break;
+
+         startCycle_(playlist);
+      }
+
+      // a single entry repeats itself
+      return repeat && cursor_ != Playlist::npos && order_.size() == 1 ? cursor_ : Playlist::npos;
+   }
+
+   /**
+    * Starts a new cycle from the current entry: every other entry is left to draw again.
+    */
+   void Shuffle::startCycle_(const Playlist& playlist)
+   {
+      Playlist::Handle current = cursor_ != Playlist::npos ? order_[cursor_] : Playlist::kInvalidHandle;
+
+      size_t kept(0);
+      for (Playlist::Handle handle : order_)
+      {
+         if (playlist.positionOf(handle) != Playlist::npos)
+            order_[kept++] = handle;
+         else
+            index_[handle] = kNotShuffled;
+      }
+
+      order_.resize(kept);
+      for (size_t index = 0; index < order_.size(); index++)
+         index_[order_[index]] = static_cast<std::uint32_t>(index);
+
+      drawn_ = 0;
+      cursor_ = Playlist::npos;
+
+      // the current entry opens the cycle, so that it is not drawn again right away
+      if (current != Playlist::kInvalidHandle && index_[current] != kNotShuffled)
+      {
+         swap_(index_[current], 0);
+         drawn_ = 1;
+         cursor_ = 0;
+      }
+   }
+
+}
@@ -0,0 +1,123 @@
+#include "StringPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+   // all empty strings share this storage
+   constexpr char kEmpty[] = "";
+}
+
+namespace MusicPlayer
+{
+
+   InternedString::InternedString() :
+      view_(kEmpty, 0)
+   {
+   }
+
+   StringPool::StringPool()
+   {
+   }
+
+   InternedString StringPool::intern(std::string_view value)
+   {
+      if (value.empty())
+         return InternedString();
+
+      size_t hash = std::hash<std::string_view>()(value);
+      Shard& shard = shards_[shardOf_(hash)];
+
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      auto known = shard.index.find(value);
+      if (known != shard.index.end())
+         return known->second;
+
+      InternedString interned(store_(shard, value));
+      shard.index.emplace(interned.view(), interned);
+
+      return interned;
+   }
+
+   bool StringPool::find(std::string_view value, InternedString& found) const
+   {
+      if (value.empty())
+      {
+         found = InternedString();
+         return true;
+      }
+
+      const Shard& shard = shards_[shardOf_(std::hash<std::string_view>()(value))];
+
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      auto known = shard.index.find(value);
+      if (known == shard.index.end())
+         return false;
+
+      found = known->second;
+      return true;
+   }
+
+   size_t StringPool::size() const
+   {
+      size_t count(0);
+      for (const Shard& shard : shards_)
+      {
+         std::lock_guard<std::mutex> lock(shard.mutex);
+         count += shard.index.size();
+      }
+
+      return count;
+   }
+
+   size_t StringPool::allocatedBytes() const
+   {
+      size_t bytes(0);
+      for (const Shard& shard : shards_)
+      {
+         std::lock_guard<std::mutex> lock(shard.mutex);
+         bytes += shard.allocated_bytes;
+      }
+
+      return bytes;
+   }
+
+   StringPool& StringPool::shared()
+   {
+      static StringPool pool;
+      return pool;
+   }
+
+   std::string_view StringPool::store_(Shard& shard, std::string_view value)
+   {
+      char* destination;
+
+      if (value.size() > kBlockSize / 4)
+      {
+         // large strings get a block of their own, so that the current block keeps its free space
+         shard.blocks.insert(shard.blocks.begin(), std::make_unique<char[]>(value.size()));
+         shard.allocated_bytes += value.size();
+         destination = shard.blocks.front().get();
+      }
+      else
+      {
+         if (kBlockSize - shard.block_used < value.size())
+         {
+            shard.blocks.push_back(std::make_unique<char[]>(kBlockSize));
+            shard.allocated_bytes += kBlockSize;
+            shard.block_used = 0;
+         }
+
+         destination = shard.blocks.back().get() + shard.block_used;
+         shard.block_used += value.size();
+      }
+
+      std::memcpy(destination, value.data(), value.size());
+
+      return std::string_view(destination, value.size());
+   }
+
+}
@@ -0,0 +1,248 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+   // the pool and the index of the worker running on this thread, if any
+   thread_local const MusicPlayer::ThreadPool* current_pool = nullptr;
+   thread_local size_t current_worker = 0;
+}
+
+namespace MusicPlayer
+{
+
+   ThreadPool::ThreadPool(size_t thread_count) :
+      queued_total_(0),
+      stopping_(false),
+      steals_(0)
+   {
+      if (thread_count == 0)
+         thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+      for (std::atomic<size_t>& queued : queued_)
+         queued.store(0, std::memory_order_relaxed);
+
+      // one queue per worker, and the shared one
+      for (size_t idx = 0; idx <= thread_count; idx++)
+         queues_.push_back(std::make_unique<Queue>());
+
+      threads_.reserve(thread_count);
+      for (size_t idx = 0; idx < thread_count; idx++)
+         threads_.emplace_back(&ThreadPool::work_, this, idx);
+   }
+
+   ThreadPool::~ThreadPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(sleep_mutex_);
+         stopping_ = true;
+      }
+
+      job_available_.notify_all();
+
+      for (std::thread& thread : threads_)
+         thread.join();
+   }
+
+   ThreadPool::Statistics ThreadPool::getStatistics() const
+   {
+      Statistics statistics;
+
+      for (size_t level = 0; level < kPriorityCount; level++)
+      {
+         const LevelCounters& counters = counters_[level];
+         Statistics::Level& statistics_level = statistics.levels[level];
+
+         statistics_level.executed = counters.executed.load(std::memory_order_relaxed);
+         statistics_level.cancelled = counters.cancelled.load(std::memory_order_relaxed);
+
+         if (statistics_level.executed > 0)
+            statistics_level.average_latency_us = counters.latency_total_ns.load(std::memory_order_relaxed) / 1000.0 / statistics_level.executed;
+         statistics_level.max_latency_us = counters.latency_max_ns.load(std::memory_order_relaxed) / 1000.0;
+      }
+
+      statistics.steals = steals_.load(std::memory_order_relaxed);
+
+      return statistics;
+   }
+
+   const char* ThreadPool::getPriorityName(Priority priority)
+   {
+      switch (priority)
+      {
+      case Priority::Realtime:
+         return "realtime";
+      case Priority::Prefetch:
+         return "prefetch";
+      case Priority::Background:
+         return "background";
+      }
+
+      return "";
+   }
+
+   ThreadPool& ThreadPool::shared()
+   {
+      static ThreadPool pool;
+      return pool;
+   }
+
+   void ThreadPool::enqueue_(Priority priority, Job job)
+   {
+      size_t level = static_cast<size_t>(priority);
+
+      // the jobs of a worker stay on its own deques, until another worker steals them
+      Queue& queue = current_pool == this ? *queues_[current_worker] : *queues_.back();
+
+      // counted first, so that the counters never miss a queued job
+      queued_[level].fetch_add(1, std::memory_order_relaxed);
+      queued_total_.fetch_add(1, std::memory_order_release);
+
+      {
+         std::lock_guard<std::mutex> lock(queue.mutex);
+         queue.jobs[level].push_back(std::move(job));
+      }
+
+      // taking the mutex orders the notification after the check of a worker going to sleep
+      {
+         std::lock_guard<std::mutex> lock(sleep_mutex_);
+      }
+
+      job_available_.notify_one();
+   }
+
+   /**
+    * Takes the job of highest priority between two levels: the newest of the worker's own deque, else the oldest of
+    * the shared deque, else the oldest of another worker.
+    *
+    * \param worker The index of the worker looking for a job.
+    * \return false if no job was found.
+    */
+   bool ThreadPool::take_(size_t worker, size_t first_level, size_t last_level, Job& job, size_t& level)
+   {
+      const size_t queue_count = queues_.size();
+      const size_t shared_queue = queue_count - 1;
+
+      for (level = first_level; level <= last_level; level++)
+      {
+         if (queued_[level].load(std::memory_order_acquire) == 0)
+            continue;
+
+         {
+            Queue& own = *queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+
+            if (!own.jobs[level].empty())
+            {
+               job = std::move(own.jobs[level].back());
+               own.jobs[level].pop_back();
+               break;
+            }
+         }
+
+         auto takeOldest = [&](Queue& queue)
+         {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs[level].empty())
+               return false;
+
+            job = std::move(queue.jobs[level].front());
+            queue.jobs[level].pop_front();
+            return true;
+         };
+
+         bool found = takeOldest(*queues_[shared_queue]);
+
+         // the victims are visited starting after the worker, so that they are spread
+         const size_t worker_count = queue_count - 1;
+         for (size_t offset = 1; offset <= worker_count && !found; offset++)
+         {
+            size_t victim = (worker + offset) % worker_count;
+            if (victim != worker && takeOldest(*queues_[victim]))
+            {
+               found = true;
+               steals_.fetch_add(1, std::memory_order_relaxed);
+            }
+         }
+
+         if (found)
+            break;
+      }
+
+      if (level > last_level)
+         return false;
+
+      queued_[level].fetch_sub(1, std::memory_order_relaxed);
+      queued_total_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+   }
+
+   void ThreadPool::run_(Job& job, size_t level)
+   {
+      LevelCounters& counters = counters_[level];
+
+      if (job.cancelled && job.cancelled->load(std::memory_order_relaxed))
+      {
+         counters.cancelled.fetch_add(1, std::memory_order_relaxed);
+         return;
+      }
+
+      std::int64_t latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - job.submitted_at).count();
+      counters.executed.fetch_add(1, std::memory_order_relaxed);
+      counters.latency_total_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+
+      std::int64_t max_latency_ns = counters.latency_max_ns.load(std::memory_order_relaxed);
+      while (latency_ns > max_latency_ns && !counters.latency_max_ns.compare_exchange_weak(max_latency_ns, latency_ns, std::memory_order_relaxed))
+         continue;
+
+      job.run();
+   }
+
+   /**
+    * Executes one queued job of a priority on the calling worker.
+    *
+    * \return false if no such job was queued, or if the calling thread is not a worker of the pool.
+    */
+   bool ThreadPool::help_(Priority priority)
+   {
+      // the jobs submitted by other threads go to the shared queue in order: running them nested in a wait could
+      // stack up without bound
+      if (current_pool != this)
+         return false;
+
+      size_t level = static_cast<size_t>(priority);
+
+      Job job;
+      if (!take_(current_worker, level, level, job, level))
+         return false;
+
+      run_(job, level);
+      return true;
+   }
+
+   void ThreadPool::work_(size_t worker)
+   {
+      current_pool = this;
+      current_worker = worker;
+
+      while (true)
+      {
+         Job job;
+         size_t level(0);
+
+         if (take_(worker, 0, kPriorityCount - 1, job, level))
+         {
+            run_(job, level);
+            continue;
+         }
+
+         std::unique_lock<std::mutex> lock(sleep_mutex_);
+         job_available_.wait(lock, [this]() { return stopping_ || queued_total_.load(std::memory_order_acquire) > 0; });
+
+         if (stopping_ && queued_total_.load(std::memory_order_acquire) == 0)
+            return;
+      }
+   }
+
+}
@@ -2,95 +2,148 @@
 
 #include "Utils.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <sstream>
 
 using std::ostream;
 
+namespace {
+   std::string unsupportedCodecMessage(std::string_view codec)
+   {
+      return "The codec type " + std::string(codec) + " is not supported";
+   }
+
+   // minutes or seconds of a duration: digits only, so that a negative or trailing field is rejected
+   bool parseDurationField(std::string_view text, long long& value)
+   {
+      return !text.empty() && text[0] != '-' && MusicPlayer::parseInteger(text, value);
+   }
+}
+
 namespace MusicPlayer {
    const int Track::kFormatFlagHandle = std::ios_base::xalloc();
 
+   float ReplayGain::getFactor(float preamp_db) const
+   {
+      float factor = std::pow(10.0f, (gain_db + preamp_db) / 20.0f);
+
+      if (peak > 0.0f)
+         factor = std::min(factor, 1.0f / peak);
+
+      return factor;
+   }
+
    Track::Track() :
-      codec_(Codec::Type::MP3)
+      duration_(-1), codec_(Codec::Type::MP3)
    {
-      setInvalid_("This track's metadata are empty.");
+      // tracks are default-constructed for every parsed line: the message is only built when it is asked for
    }
 
-   Track::Track(std::string title, time_t duration, std::string codec) :
-      title_(title), duration_(duration)
+   Track::Track(std::string_view title, time_t duration, std::string_view codec) :
+      duration_(duration), codec_(Codec::Type::MP3)
    {
-      try
+      std::optional<Codec::Type> codec_type = Codec::findCodecType(codec);
+
+      if (codec_type)
       {
-         codec_ = Codec::getCodecTypeFromString(codec);
+         title_ = StringPool::shared().intern(title);
+         codec_ = *codec_type;
       }
-      catch (std::invalid_argument& ex)
+      else
       {
-         setInvalid_(ex.what());
+         setInvalid_(unsupportedCodecMessage(codec));
       }
    }
 
+   Track::Track(std::string_view title, time_t duration, Codec::Type codec) :
+      title_(StringPool::shared().intern(title)), duration_(duration), codec_(codec)
+   {
+   }
+
    std::string Track::serialize() const {
       std::stringstream strm;
-      strm << this->title_ << ';' << duration_ / 60 << ':' << duration_ % 60 << ';' << Codec::getCodecAsString(codec_);
+      strm << this->title_ << ';' << duration_ / 60 << ':' << duration_ % 60 << ';' << Codec::getCodecName(codec_);
+
+      if (replay_gain_)
+         strm << ';' << std::fixed << std::setprecision(2) << replay_gain_->gain_db << ';' << std::setprecision(6) << replay_gain_->peak;
+
       return strm.str();
    }
 
-   bool Track::deserialize(const std::string& source)
+   bool Track::deserialize(std::string_view source)
    {
-      // expected: "<Title>;<Duration>;<Codec>"
+      // expected: "<Title>;<Duration>;<Codec>[;<Gain>[;<Peak>]]"
 
-      auto splitted_source = split(source, ";");
+      Tokenizer fields(source, ';');
+      std::string_view title, duration, codec;
 
-      if (splitted_source.size() < 3)
+      if (!fields.next(title) || !fields.next(duration) || !fields.next(codec))
       {
          setInvalid_("Missing parameters in source file.");
          return false;
       }
 
-      // Get title
-      title_ = splitted_source[0];
-
       // Get codec
-      try
-      {
-         codec_ = Codec::getCodecTypeFromString(splitted_source[2]);
-      }
-      catch (std::invalid_argument& ex)
+      std::optional<Codec::Type> codec_type = Codec::findCodecType(codec);
+
+      if (!codec_type)
       {
-         setInvalid_(ex.what());
+         setInvalid_(unsupportedCodecMessage(codec));
          return false;
       }
-      
+
+      codec_ = *codec_type;
+
       // Get duration (expected in the format mm:ss)
-      auto parsed_duration = split(splitted_source[1], ":");
-      
-      if (parsed_duration.size() < 2)
+      Tokenizer duration_fields(duration, ':');
+      std::string_view minutes, seconds, extra;
+      long long parsed_minutes, parsed_seconds;
+
+      if (!duration_fields.next(minutes) || !duration_fields.next(seconds) || duration_fields.next(extra)
+         || !parseDurationField(minutes, parsed_minutes) || !parseDurationField(seconds, parsed_seconds))
       {
          setInvalid_("Duration of track is ill-formed in source file. (should be mm:ss)");
          return false;
       }
 
-      try
+      // Get ReplayGain (optional, gain in dB then linear peak)
+      std::string_view gain, peak;
+      double parsed_gain(0.0), parsed_peak(0.0);
+
+      if (fields.next(gain))
       {
-         duration_ = std::stoll(parsed_duration[0]) * 60 + std::stoll(parsed_duration[1]);
+         if (!parseDecimal(gain, parsed_gain) || (fields.next(peak) && (!parseDecimal(peak, parsed_peak) || parsed_peak < 0.0)))
+         {
+            setInvalid_("ReplayGain of track is ill-formed in source file. (should be <gain in dB>;<peak>)");
+            return false;
+         }
+
+         replay_gain_ = ReplayGain{ static_cast<float>(parsed_gain), static_cast<float>(parsed_peak) };
       }
-      catch (std::exception)
+      else
       {
-         setInvalid_("Duration of track is ill-formed in source file. (should be mm:ss)");
-         return false;
+         replay_gain_.reset();
       }
 
+      // Get title
+      title_ = StringPool::shared().intern(title);
+      duration_ = parsed_minutes * 60 + parsed_seconds;
+      error_message_.reset();
+
       return true;
    }
 
-   bool Track::operator=(const Track& other) const
+   bool Track::operator==(const Track& other) const
    {
       if (isInvalid() || other.isInvalid())
          return false;
 
       return title_    == other.title_
           && duration_ == other.duration_
-          && codec_    == other.codec_;
+          && codec_    == other.codec_
+          && replay_gain_ == other.replay_gain_;
    }
 
    ostream& Track::setFormat(ostream& os, long format) {
@@ -115,13 +168,26 @@ namespace MusicPlayer {
          }
          else // long format
          {
-            out << "Title: " << track.title_ << std::endl;
+            out << "Title: " << track.title_ << '\n';
 
             out << "Duration: " << std::setfill('0') << std::setw(2) << track.duration_ / 60
                << ":" << std::setfill('0') << std::setw(2) << track.duration_ % 60
-               << std::endl;
-
-            out << "Codec: " << Codec::getCodecAsString(track.codec_) << std::endl;
+               << '\n';
+
+            out << "Codec: " << Codec::getCodecName(track.codec_) << '\n';
+
+            if (track.replay_gain_)
+            {
+               std::ios_base::fmtflags flags = out.flags();
+               std::streamsize precision = out.precision();
+               out << "ReplayGain: " << std::showpos << std::fixed << std::setprecision(2) << track.replay_gain_->gain_db << " dB"
+                  << std::noshowpos;
+               if (track.replay_gain_->peak > 0.0f)
+                  out << ", peak " << std::setprecision(6) << track.replay_gain_->peak;
+               out << '\n';
+               out.flags(flags);
+               out.precision(precision);
+            }
          }
       }
 
@@ -130,7 +196,10 @@ namespace MusicPlayer {
 
    std::string Track::getErrorMessage() const
    {
-      return isInvalid() ? title_ : "";
+      if (!isInvalid())
+         return "";
+
+      return error_message_ ? *error_message_ : "This track's metadata are empty.";
    }
 
    bool Track::isInvalid() const
@@ -138,10 +207,11 @@ namespace MusicPlayer {
       return duration_ < 0;
    }
 
-   void Track::setInvalid_(const std::string& message)
+   void Track::setInvalid_(std::string message)
    {
       duration_ = -1;
-      title_ = message;
+      title_ = InternedString();
+      error_message_ = std::make_shared<const std::string>(std::move(message));
    }
 
 
@@ -1,6 +1,16 @@
 #include "Utils.h"
 
-#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 using std::string;
 using std::vector;
@@ -17,28 +27,50 @@ namespace MusicPlayer {
     */
    vector<string> split(const string& original, const string& delimiter)
    {
-      size_t pos(0);
       vector<string> parsed;
 
-      while (pos < original.size()) {
-         size_t next_pos = original.find(delimiter, pos);
+      for (std::string_view part : Tokenizer(original, delimiter))
+         parsed.emplace_back(part);
 
-         if (next_pos == string::npos) {
-            // no more matches in string, just add last part to array
+      return parsed;
+   }
 
-            parsed.push_back(std::move(original.substr(pos)));
-            pos = original.size();
-         }
-         else {
-            parsed.push_back(std::move(original.substr(pos, next_pos - pos)));
-            pos = next_pos + delimiter.size();
-         }
-      }
+   bool parseInteger(std::string_view text, long long& value)
+   {
+      const char* end = text.data() + text.size();
+      auto result = std::from_chars(text.data(), end, value);
 
-      // remove empty strings
-      parsed.erase(std::remove_if(parsed.begin(), parsed.end(), [](const string& word) {return word.empty(); }), parsed.end());
+      return result.ec == std::errc() && result.ptr == end;
+   }
 
-      return parsed;
+   bool parseDecimal(std::string_view text, double& value)
+   {
+      const char* end = text.data() + text.size();
+      auto result = std::from_chars(text.data(), end, value, std::chars_format::fixed);
+
+      return result.ec == std::errc() && result.ptr == end && std::isfinite(value);
+   }
+
+   size_t getPeakResidentMemory()
+   {
+#ifdef _WIN32
+      PROCESS_MEMORY_COUNTERS counters;
+      if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+         return 0;
+
+      return counters.PeakWorkingSetSize;
+#else
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) != 0)
+         return 0;
+
+#ifdef __APPLE__
+      return static_cast<size_t>(usage.ru_maxrss);
+#else
+      // reported in kilobytes
+      return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
    }
 
 }
@@ -0,0 +1,135 @@
+#include "WavDecoder.h"
+
+#include "Dsp.h"
+
+#include <cstring>
+
+namespace
+{
+   std::uint32_t readLittleEndian(const unsigned char* bytes, size_t byte_count)
+   {
+      std::uint32_t value(0);
+      for (size_t idx = 0; idx < byte_count; idx++)
+         value |= static_cast<std::uint32_t>(bytes[idx]) << (8 * idx);
+      return value;
+   }
+
+   constexpr std::uint16_t kFormatPcm = 1;
+   constexpr std::uint16_t kFormatFloat = 3;
+   constexpr std::uint16_t kFormatExtensible = 0xFFFE;
+}
+
+namespace MusicPlayer
+{
+
+   bool WavDecoder::open(const std::string& file_name)
+   {
+      if (!file_.open(file_name))
+         return fail_("File \"" + file_name + "\" could not be opened.");
+
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file_.data());
+      const size_t size = file_.size();
+
+      if (size < 12 || std::memcmp(bytes, "RIFF", 4) != 0 || std::memcmp(bytes + 8, "WAVE", 4) != 0)
+         return fail_("File \"" + file_name + "\" is not a WAVE file.");
+
+      bool has_format(false);
+      std::uint16_t format_tag(0);
+
+      // walk the chunks until the audio data
+      size_t pos(12);
+      while (pos + 8 <= size)
+      {
+         const unsigned char* chunk = bytes + pos;
+         size_t chunk_size = readLittleEndian(chunk + 4, 4);
+         size_t chunk_data = pos + 8;
+
+         if (std::memcmp(chunk, "fmt ", 4) == 0)
+         {
+            if (chunk_size < 16 || chunk_data + chunk_size > size)
+               return fail_("File \"" + file_name + "\" has an invalid format chunk.");
+
+            format_tag = static_cast<std::uint16_t>(readLittleEndian(chunk + 8, 2));
+            format_.channels = readLittleEndian(chunk + 10, 2);
+            format_.sample_rate = readLittleEndian(chunk + 12, 4);
+            format_.bits_per_sample = readLittleEndian(chunk + 22, 2);
+
+            // the actual format of extensible files is in the first bytes of their sub-format GUID
+            if (format_tag == kFormatExtensible && chunk_size >= 40)
+               format_tag = static_cast<std::uint16_t>(readLittleEndian(chunk + 32, 2));
+
+            has_format = true;
+         }
+         else if (std::memcmp(chunk, "data", 4) == 0)
+         {
+            if (!has_format)
+               return fail_("File \"" + file_name + "\" has no format chunk before its data.");
+
+            // some encoders leave the size of a streamed data chunk unset
+            if (chunk_data + chunk_size > size || chunk_size == 0)
+               chunk_size = size - chunk_data;
+
+            data_ = chunk + 8;
+
+            is_float_ = format_tag == kFormatFloat;
+            bytes_per_sample_ = format_.bits_per_sample / 8;
+
+            bool supported = format_.channels > 0 && format_.sample_rate > 0
+               && ((format_tag == kFormatPcm && bytes_per_sample_ >= 1 && bytes_per_sample_ <= 4 && format_.bits_per_sample % 8 == 0)
+                  || (format_tag == kFormatFloat && format_.bits_per_sample == 32));
+
+            if (!supported)
+               return fail_("File \"" + file_name + "\" uses an unsupported WAVE sample format.");
+
+            total_frames_ = chunk_size / (bytes_per_sample_ * format_.channels);
+            next_frame_ = 0;
+
+            return true;
+         }
+
+         // chunks are padded to an even size
+         pos = chunk_data + chunk_size + (chunk_size & 1);
+      }
+
+      return fail_("File \"" + file_name + "\" has no audio data.");
+   }
+
+   size_t WavDecoder::read(float* samples, size_t frames)
+   {
+      if (!data_ || next_frame_ >= total_frames_)
+         return 0;
+
+      if (frames > total_frames_ - next_frame_)
+         frames = static_cast<size_t>(total_frames_ - next_frame_);
+
+      const size_t sample_count = frames * format_.channels;
+      const unsigned char* source = data_ + next_frame_ * format_.channels * bytes_per_sample_;
+
+      if (is_float_)
+      {
+         std::memcpy(samples, source, sample_count * sizeof(float));
+      }
+      else if (bytes_per_sample_ == 1)
+      {
+         // 8-bit samples are unsigned
+         for (size_t idx = 0; idx < sample_count; idx++)
+            samples[idx] = (static_cast<int>(source[idx]) - 128) * (1.0f / 128.0f);
+      }
+      else
+      {
+         const Dsp::Kernels& dsp = Dsp::kernels();
+
+         if (bytes_per_sample_ == 2)
+            dsp.int16ToFloat(source, samples, sample_count);
+         else if (bytes_per_sample_ == 3)
+            dsp.int24ToFloat(source, samples, sample_count);
+         else
+            dsp.int32ToFloat(source, samples, sample_count);
+      }
+
+      next_frame_ += frames;
+
+      return frames;
+   }
+
+}